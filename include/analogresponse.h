@@ -0,0 +1,53 @@
+#ifndef ANALOGRESPONSE_H
+#define ANALOGRESPONSE_H
+
+#include <QtGlobal>
+
+#include <cmath>
+
+/* The AnalogResponse class shapes the raw values of a stick or a trigger into what the core sees.
+ *
+ * Past a deadzone, the travel is rescaled to the full range, bent by an exponent and multiplied by a sensitivity.
+ * The deadzone is radial for sticks: it's the distance from the center that counts, not each axis on its own,
+ * so diagonals don't snap to the axes.
+ *
+ * All of that is precomputed into a table of gains indexed by the input's magnitude, applying it is a square root,
+ * a lookup and a couple of multiplications. Axis events can come by the thousands per second.
+ *
+ * The AnalogResponse class is instantiated inside of the InputDeviceMapping class, which lives in the
+ * inputdevicemapping.cpp file.
+ */
+
+class AnalogResponse {
+    public:
+        AnalogResponse();
+
+        // deadzone and sensitivity are fractions of the full range, curve is the exponent, 1.0 is linear
+        void setResponse( double deadzone, double curve, double sensitivity );
+
+        // Both axes of a stick at once, the deadzone applies to their combined distance from the center
+        void applyStick( int x, int y, int16_t *out_x, int16_t *out_y ) const {
+            float gain = gains[int( std::sqrt( float( x ) * x + float( y ) * y ) ) >> lut_shift];
+            *out_x = clamp( x * gain );
+            *out_y = clamp( y * gain );
+        }
+
+        // Triggers only go one way, 0 to 32767
+        int16_t applyTrigger( int value ) const {
+            value = qBound( 0, value, 32767 );
+            return clamp( value * gains[value >> lut_shift] );
+        }
+
+    private:
+        // Magnitudes go up to 32768 * sqrt( 2 ) in the corners of a square gate
+        static const int lut_shift = 6;
+        static const int lut_size = 1024;
+
+        float gains[lut_size];
+
+        static int16_t clamp( float value ) {
+            return int16_t( qBound( -32767.0f, value, 32767.0f ) );
+        }
+};
+
+#endif // ANALOGRESPONSE_H
@@ -1,4 +1,3 @@
-
 #ifndef AUDIO_H
 #define AUDIO_H
 
@@ -6,15 +5,17 @@
 #include <QThread>
 #include <QTimer>
 #include <QAudioOutput>
+#include <QAudioDeviceInfo>
 #include <QDebug>
 
+#include <atomic>
 #include <memory>
 
 #include "audiobuffer.h"
+#include "audiooutputdevice.h"
+#include "audionullsink.h"
 #include "logging.h"
 
-#include "samplerate.h"
-
 /* The Audio class writes audio data to connected audio device.
  * All of the audio functionality lives in side of this class.
  * Any errors starting with "[phoenix.audio]" correspond to this class.
@@ -22,6 +23,17 @@
  * The audio class is instantiated inside of the videoitem.cpp class.
  * The Audio class uses the AudioBuffer class, which lives in the audiobuffer.cpp class, as a temporary audio buffer
  * that can be written has a whole chunk to the audio output.
+ *
+ * The audio output pulls its data through an AudioOutputDevice, which lives in the audiooutputdevice.cpp file,
+ * whenever the sound card needs more. Resampling and dynamic rate control happen there.
+ *
+ * The output can be switched to another sound card while the core runs: only the QAudioOutput is replaced,
+ * the AudioBuffer and the resampler keep their state so nothing the core produced is lost.
+ * If the device goes away, the output falls back to the system's default one, and goes back to the chosen
+ * one when it shows up again.
+ *
+ * For benchmarks and regression tests the sound card can be replaced by an AudioNullSink, which lives in the
+ * audionullsink.cpp file. It renders to a WAV file or a hash, as fast as the core produces audio.
  */
 
 class Audio : public QObject {
@@ -34,10 +46,23 @@ class Audio : public QObject {
 
         AudioBuffer *getAudioBuf() const;
 
+        // Thread-safe, bytes of input the output aims to keep buffered
+        size_t inputTarget() const {
+            return audioOutIODev->inputTarget();
+        }
+
+        // Thread-safe, whether anything is draining the AudioBuffer, a sound card or the null output
+        bool isOutputRunning() const {
+            return outputRunning.load( std::memory_order_relaxed );
+        }
+
+        // Thread-safe, milliseconds of CPU time per second of audio since the last call
+        qreal takeResamplerCost() {
+            return audioOutIODev->takeResamplerCost();
+        }
+
     signals:
         void signalFormatChanged();
-        void signalStopTimer();
-        void signalStartTimer();
 
     public slots:
         void slotStateChanged( QAudio::State state );
@@ -45,31 +70,70 @@ class Audio : public QObject {
         void slotSetVolume( qreal level );
         void slotThreadStarted();
         void slotHandleFormatChanged();
-        void slotHandlePeriodTimer();
+        void slotSetResamplerQuality( QString quality );
+
+        // With the audio clock as master the core gets paced by the sound card, there's no rate control.
+        // The AudioBuffer's overflow policy is left to the rendering thread, see VideoItem::audioFramesNeeded()
+        void slotSetAudioMaster( bool audioMaster );
+
+        void slotLatencyChanged( qint64 usecs, quint64 underruns );
+
+        // An empty name, or one that isn't connected, means the system's default device
+        void slotSetDevice( QString deviceName );
+
+        // A WAV file path, or "hash". Replaces the sound card for good, has to be set before the core starts
+        void slotSetNullOutput( QString target );
+
+    private slots:
+        void slotSwitchDevice();
+        void slotPollDevices();
 
     private:
-        // Opaque pointer for libsamplerate
-        SRC_STATE *resamplerState;
+        // How much audio the output buffers, the sound card asks for data about once per period
+        static const int outputBufferDuration = 30000; // microseconds
 
-        double sampleRateRatio;
-        int audioInBytesNeeded;
-        float inputDataFloat[4096 * 2];
-        char inputDataChar[4096 * 4];
-        float *outputDataFloat;
-        short *outputDataShort;
+        // Not the core's rate, so the resampler gets exercised too
+        static const int nullOutputRate = 48000;
 
         bool isCoreRunning;
+        qreal volume;
+
+        // Chosen by the user, audioDeviceName is the one actually in use
+        QString requestedDeviceName;
+        QTimer *devicePollTimer; // only runs while the requested device isn't in use
+        QAudioDeviceInfo findDevice() const;
+        QAudioFormat chooseOutFormat( const QAudioDeviceInfo &info ) const;
+
+        // Replaces the QAudioOutput, the output device's state is reset only when resetState is set
+        void startOutput( const QAudioDeviceInfo &info, bool resetState );
+
+        // A new input format came while there was no device, the next startOutput() resets whatever it's told
+        bool resetPending;
+
+        QString nullOutputTarget;
+        void startNullOutput();
+
+        // The output's latency and underrun count are remembered per device, it's the device that sets the pace
+        QString audioDeviceName;
+        quint64 savedUnderruns; // before the current session
+        void loadDeviceSettings();
+        void saveDeviceSettings();
+
         QAudioFormat audioFormatOut;
         QAudioFormat audioFormatIn;
 
         // We delete aout; Use a normal pointer.
         QAudioOutput *audioOut;
-
-        // aio doesn't own the pointer; Use a normal pointer.
-        QIODevice *audioOutIODev;
+        std::atomic<bool> outputRunning;
 
         std::unique_ptr<AudioBuffer>audioBuf;
 
+        // A child of this object, so it follows it to the audio thread; Use a normal pointer.
+        AudioOutputDevice *audioOutIODev;
+
+        // Only used with a null output; Use a normal pointer.
+        AudioNullSink *nullSink;
+
 };
 
 #endif
@@ -5,6 +5,8 @@
 #include <atomic>
 #include <cstddef>
 
+#include <QtGlobal>
+
 #include "logging.h"
 
 
@@ -15,33 +17,89 @@
  * Before each write, the Audio class must fill up this temporary buffer so that we are writing an entire frame worth of audio data
  * to the audio output.
  *
+ * The capacity is rounded up to a power of two, head and tail are free running byte counters that get masked
+ * into the buffer, so a read or a write is at most two memcpy() calls, one on each side of the wrap.
+ * Head and tail live on separate cache lines, the producer and the consumer never write to the same line.
+ *
+ * What happens to a write that doesn't fit depends on the OverflowPolicy. Overflows are counted either way.
+ *
  * This class uses atomic types in order to be thread safe.
  */
 class AudioBuffer {
 
-        char *m_buffer;
-        std::atomic<size_t> m_head; // newest item in queue
-        std::atomic<size_t> m_tail; // oldest item in queue
-        const size_t m_size;
+    public:
+        enum OverflowPolicy {
+            // Make room by throwing away the oldest bytes, keeps latency down when the consumer falls behind
+            DropOldest,
 
-        inline size_t next( size_t current ) {
-            return ( current + 1 ) % m_size;
-        }
+            // Only write what fits
+            DropNewest,
 
-        size_t size_impl( size_t head, size_t tail ) const;
+            // Wait for the consumer to make room, used to pace the producer on the consumer's clock.
+            // Gives up after block_timeout and drops what's left, so a stalled consumer can't hang the producer.
+            Block,
+        };
 
-    public:
-        AudioBuffer( size_t size = 4096 * 4 );
+        AudioBuffer( size_t size = 4096 * 4, OverflowPolicy policy = DropOldest );
 
         virtual ~AudioBuffer();
 
+        // Producer side
         size_t write( const char *data, size_t size );
 
+        // Consumer side
         size_t read( char *object, size_t size );
 
         size_t size() const;
 
+        // Maximum number of bytes the buffer can hold
+        size_t capacity() const {
+            return m_size;
+        }
+
+        // Consumer side, drops everything that wasn't read yet
         void clear();
+
+        void setOverflowPolicy( OverflowPolicy policy ) {
+            m_policy.store( policy, std::memory_order_relaxed );
+        }
+
+        OverflowPolicy overflowPolicy() const {
+            return m_policy.load( std::memory_order_relaxed );
+        }
+
+        // How many writes did not fit, and how many bytes were lost to them
+        quint64 overflows() const {
+            return m_overflows.load( std::memory_order_relaxed );
+        }
+
+        quint64 droppedBytes() const {
+            return m_dropped_bytes.load( std::memory_order_relaxed );
+        }
+
+    private:
+        static const size_t cache_line = 64;
+        static const int block_timeout = 100; // milliseconds
+
+        // Written by the producer
+        std::atomic<size_t> m_head;
+        char m_head_padding[cache_line - sizeof( std::atomic<size_t> )];
+
+        // Written by the consumer, and by the producer when it drops the oldest bytes
+        std::atomic<size_t> m_tail;
+        char m_tail_padding[cache_line - sizeof( std::atomic<size_t> )];
+
+        // Read only after construction
+        char *m_buffer;
+        size_t m_size;
+        size_t m_mask;
+
+        std::atomic<OverflowPolicy> m_policy;
+        std::atomic<quint64> m_overflows;
+        std::atomic<quint64> m_dropped_bytes;
+
+        void copyIn( size_t position, const char *data, size_t size );
+        void copyOut( size_t position, char *data, size_t size ) const;
 };
 
 #endif
@@ -0,0 +1,69 @@
+#ifndef AUDIONULLSINK_H
+#define AUDIONULLSINK_H
+
+#include <QObject>
+#include <QTimer>
+#include <QThread>
+#include <QFile>
+#include <QAudioFormat>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+
+#include <vector>
+
+#include "audiobuffer.h"
+#include "audiooutputdevice.h"
+#include "logging.h"
+
+/* The AudioNullSink stands in for a sound card, for benchmarks and regression tests on machines without one.
+ *
+ * It pulls from the AudioOutputDevice just like QAudioOutput would, so the audio goes through the same
+ * resampling and conversion code, but on a virtual clock: a period is only pulled once the core produced
+ * enough input for it, never because some time went by. With DRC off the output only depends on what the core
+ * produced, the same input always renders to the same bytes.
+ *
+ * The output goes to a WAV file, or only into a SHA-1 hash. Either way the hash, the amount of audio rendered
+ * and the time it took are logged when the sink stops.
+ *
+ * The AudioNullSink class is instantiated inside of the Audio class, which lives in the audio.cpp file.
+ */
+
+class AudioNullSink : public QObject {
+        Q_OBJECT
+
+    public:
+        AudioNullSink( AudioOutputDevice *source, AudioBuffer *input, QObject *parent = 0 );
+        ~AudioNullSink();
+
+        // target is the path of a WAV file, or "hash" to only hash the output. out has to be 16 bit.
+        bool start( QString target, QAudioFormat in, QAudioFormat out );
+        void stop();
+
+        bool isActive() const {
+            return active;
+        }
+
+    private slots:
+        void slotPull();
+
+    private:
+        static const int period_duration = 10000; // microseconds
+
+        AudioOutputDevice *source;
+        AudioBuffer *input;
+        QAudioFormat format_in;
+        QAudioFormat format_out;
+
+        QTimer pull_timer;
+        bool active;
+        QFile file;
+        QCryptographicHash hash;
+        std::vector<char> period;
+
+        qint64 frames_rendered;
+        qint64 busy_nsecs; // spent pulling, the rest of the time is waiting on the core
+
+        void writeWavHeader();
+};
+
+#endif // AUDIONULLSINK_H
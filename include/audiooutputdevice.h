@@ -0,0 +1,161 @@
+#ifndef AUDIOOUTPUTDEVICE_H
+#define AUDIOOUTPUTDEVICE_H
+
+#include <QIODevice>
+#include <QAudioFormat>
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <vector>
+
+#include "audiobuffer.h"
+#include "audioresampler.h"
+#include "logging.h"
+
+/* The AudioOutputDevice is the QIODevice that QAudioOutput pulls its data from.
+ *
+ * Instead of a timer pushing data at fixed intervals, the audio backend calls readData() whenever it needs
+ * another period, so output is driven by the sound card's own clock. Each call reads what the core produced
+ * from the AudioBuffer, resamples it to the output rate and hands it over.
+ *
+ * Dynamic rate control keeps the AudioBuffer around a target fill level: when the core runs a little fast
+ * the input is consumed slightly faster (at most 0.5%), and the other way around.
+ * If the core can't keep up, the rest of the period is filled with silence, so the backend never goes
+ * idle and never needs to be restarted.
+ *
+ * The resampler works in floats. When the sound card takes floats they're written straight to it, otherwise they're
+ * converted back to 16 bit. When both rates are the same and DRC is off, the input is passed through untouched,
+ * without going through the resampler at all. With DRC on it always goes through the resampler, switching
+ * back and forth mid-stream would click every time.
+ * Every buffer is sized once, when the format is set, and only grows if the backend asks for a larger period.
+ *
+ * The target fill level adapts. It starts low, every underrun raises it and a long enough stretch without any
+ * lowers it again, bit by bit. After an underrun the output plays silence until the buffer is back at its target,
+ * rather than stuttering on whatever trickles in, the device itself keeps running.
+ *
+ * The AudioOutputDevice class is instantiated inside of the Audio class, which lives in the audio.cpp file.
+ */
+
+class AudioOutputDevice : public QIODevice {
+        Q_OBJECT
+
+    public:
+        AudioOutputDevice( AudioBuffer *input, QObject *parent = 0 );
+        ~AudioOutputDevice();
+
+        // Resets the resampler, call it before the device gets (re)started.
+        // out has to be 16 bit or float, buffer_size is the backend's buffer in bytes.
+        void setFormats( QAudioFormat in, QAudioFormat out, qint64 buffer_size );
+
+        // For a new sound card, keeps the buffered input and the resampler's state
+        void setOutputFormat( QAudioFormat out, qint64 buffer_size );
+
+        // Same thread as readData()
+        void setResamplerQuality( AudioResampler::Quality quality );
+
+        // Same thread as readData(), clamped to [min_latency, maxLatency()], applied on the next setFormats()
+        void setLatency( qint64 usecs );
+
+        qint64 latency() const {
+            return target_latency;
+        }
+
+        // Same thread as readData(), plays silence until the buffer reaches its target again
+        void refill() {
+            refilling = true;
+        }
+
+        // Thread-safe. With DRC off the input is consumed at exactly the nominal rate, whoever produces it
+        // has to follow the sound card's clock.
+        void setDrcEnabled( bool enabled ) {
+            drc_enabled.store( enabled, std::memory_order_relaxed );
+        }
+
+        // Thread-safe, the input fill level DRC aims for, in bytes
+        size_t inputTarget() const {
+            return input_target.load( std::memory_order_relaxed );
+        }
+
+        // Thread-safe, see AudioResampler::takeCost()
+        qreal takeResamplerCost() {
+            return resampler.takeCost( output_rate.load( std::memory_order_relaxed ) );
+        }
+
+        bool isSequential() const override {
+            return true;
+        }
+
+        qint64 bytesAvailable() const override;
+
+        // Since the output format was last set, so they all belong to the current device
+        quint64 underruns() const {
+            return underrun_count;
+        }
+
+    signals:
+        // The target changed because of underruns or stability, also reports the total underrun count
+        void latencyChanged( qint64 usecs, quint64 underruns );
+
+    protected:
+        qint64 readData( char *data, qint64 max_size ) override;
+        qint64 writeData( const char *data, qint64 max_size ) override;
+
+    private:
+        static const int channels = 2;
+
+        // Most the output rate may deviate from the nominal one, to keep the input buffer at its target
+        static constexpr double max_deviation = 0.005;
+
+        // Bounds of the adaptive target, in microseconds
+        static const qint64 min_latency = 10000;
+        static const qint64 max_latency = 150000;
+
+        // The input buffer has to hold the target plus whatever the core writes in one go, a frame at 50Hz
+        static const qint64 frame_headroom = 20000; // microseconds
+
+        // The target goes down after this long without underruns, it can't go up twice within raise_cooldown
+        static const qint64 stable_period = 10000; // milliseconds
+        static const qint64 raise_cooldown = 1000; // milliseconds
+
+        AudioBuffer *input;
+        QAudioFormat format_in;
+        QAudioFormat format_out;
+        double sample_rate_ratio;
+        std::atomic<size_t> input_target; // bytes
+        std::atomic<bool> drc_enabled;
+
+        AudioResampler resampler;
+        AudioResampler::Quality resampler_quality;
+        std::atomic<int> output_rate;
+
+        // Input converted to floats, frames the resampler didn't consume stay at the front
+        std::vector<short> input_short;
+        std::vector<float> input_float;
+        size_t input_pending; // frames
+        std::vector<float> output_float;
+
+        bool float_output;
+
+        // Bypasses the resampler while the rates match and nothing needs correcting
+        bool passthrough;
+
+        quint64 underrun_count;
+
+        qint64 target_latency; // microseconds
+        bool refilling;
+        QElapsedTimer stable_timer;
+        QElapsedTimer raise_timer;
+        void underrun();
+        void adaptLatency();
+
+        // max_latency, or less if the input buffer can't hold that much of the input format
+        qint64 maxLatency() const;
+
+        double fillDirection() const;
+        void reserve( size_t frames );
+        size_t fillInput( size_t frames );
+        size_t resample( float *out, size_t frames, double ratio );
+        size_t readPassthrough( char *data, size_t frames );
+};
+
+#endif // AUDIOOUTPUTDEVICE_H
@@ -0,0 +1,80 @@
+#ifndef AUDIORESAMPLER_H
+#define AUDIORESAMPLER_H
+
+#include <QStringList>
+
+#include <atomic>
+#include <vector>
+
+#include "logging.h"
+
+#include "samplerate.h"
+
+/* The AudioResampler converts the core's audio to the sound card's rate.
+ *
+ * The quality can be picked at runtime:
+ *  - "sinc-best", "sinc-medium", "sinc-fast" and "linear" use the matching libsamplerate converters,
+ *  - "cubic" is a built-in 4 point Catmull-Rom interpolator, vectorized with SSE2 for stereo.
+ *    Most of the time the two rates are the same, or close, and only DRC moves the ratio by a fraction of
+ *    a percent, which doesn't need a windowed sinc. It costs a small fraction of libsamplerate's best converter.
+ *
+ * The time spent resampling is accumulated, takeCost() reports it per second of audio produced.
+ *
+ * The AudioResampler class is instantiated inside of the AudioOutputDevice class, which lives in the audiooutputdevice.cpp file.
+ */
+
+class AudioResampler {
+    public:
+        enum Quality {
+            SincBest,
+            SincMedium,
+            SincFastest,
+            Linear,
+            Cubic,
+        };
+
+        AudioResampler();
+        ~AudioResampler();
+
+        static QStringList qualityNames();
+
+        // Returns false if name isn't one of qualityNames()
+        static bool qualityFromName( QString name, Quality *quality );
+
+        // Changes the converter and resets the state, false if it could not be created
+        bool setQuality( Quality quality, int channels );
+
+        Quality getQuality() const {
+            return quality;
+        }
+
+        // Forgets any buffered input
+        void reset();
+
+        // Same contract as src_process(): input frames that weren't used must be given again on the next call
+        bool process( const float *in, size_t in_frames, float *out, size_t out_frames, double ratio,
+                      size_t *in_used, size_t *out_generated );
+
+        // Milliseconds of CPU time per second of audio since the last call, at sample_rate output frames per second
+        qreal takeCost( int sample_rate );
+
+    private:
+        // Frames of input the cubic interpolator keeps from one call to the next
+        static const size_t cubic_history = 3;
+
+        Quality quality;
+        int channels;
+
+        SRC_STATE *state;
+
+        // Cubic, history followed by the new input
+        std::vector<float> work;
+        double position; // in work frames
+
+        std::atomic<qint64> cost_nsecs;
+        std::atomic<qint64> cost_frames;
+
+        size_t processCubic( size_t total_frames, float *out, size_t out_frames, double step );
+};
+
+#endif // AUDIORESAMPLER_H
@@ -10,12 +10,19 @@
 #include <QLibrary>
 #include <QObject>
 
+#include <vector>
+
 #include "libretro.h"
 #include "audiobuffer.h"
 #include "logging.h"
+#include "corelogger.h"
+#include "corevariables.h"
 #include "inputmanager.h"
 #include "keyboard.h"
 
+class Recorder;
+class LatencyMonitor;
+
 /* The Core class is a wrapper around any given libretro core.
  * The general functionality for this class is to load the core into memory,
  * connect to all of the core's callbacks, such as video and audio rendering,
@@ -75,6 +82,8 @@ struct LibretroSymbols {
 class Core: public QObject {
         Q_OBJECT
 
+        friend struct CoreEnvironment;
+
     public:
 
         Core();
@@ -173,6 +182,10 @@ class Core: public QObject {
         retro_pixel_format getPixelFormat() const {
             return pixel_format;
         }
+        // Options declared by the core, editable while it runs
+        CoreVariables &getVariables() {
+            return variables;
+        }
         const retro_system_info *getSystemInfo() const {
             return system_info;
         }
@@ -189,6 +202,12 @@ class Core: public QObject {
         //
 
         AudioBuffer *audio_buf;
+
+        // Optional, receives a copy of every video frame and audio batch while recording
+        Recorder *recorder;
+
+        // Optional, told whenever input gets latched, only set while measuring input latency
+        LatencyMonitor *latency_monitor;
         //const int16_t *getAudioData() const { return audio_data; };
         //size_t getAudioFrames() const { return audio_frames; };
         //int16_t getLeftChannel() const { return left_channel; };
@@ -211,75 +230,13 @@ class Core: public QObject {
         double getSampleRate() const {
             return ( system_av_info->timing.sample_rate ) * ( 60.0 / ( system_av_info->timing.fps ) );
         }
+        double getNativeSampleRate() const {
+            return system_av_info->timing.sample_rate;
+        }
         bool isDupeFrame() const {
             return is_dupe_frame;
         }
 
-        // Container class for a libretro core variable
-        class Variable {
-            public:
-                Variable() {} // default constructor
-
-                Variable( const retro_variable *var ) {
-                    m_key = var->key;
-
-                    // "Text before first ';' is description. This ';' must be followed by a space,
-                    // and followed by a list of possible values split up with '|'."
-                    QString valdesc( var->value );
-                    int splitidx = valdesc.indexOf( "; " );
-
-                    if( splitidx != -1 ) {
-                        m_description = valdesc.mid( 0, splitidx ).toStdString();
-                        auto _choices = valdesc.mid( splitidx + 2 ).split( '|' );
-
-                        foreach( auto &choice, _choices ) {
-                            m_choices.append( choice.toStdString() );
-                        }
-                    } else {
-                        // unknown value
-                    }
-                };
-                virtual ~Variable() {}
-
-                const std::string &key() const {
-                    return m_key;
-                };
-
-                const std::string &value( const std::string &default_ ) const {
-                    if( m_value.empty() ) {
-                        return default_;
-                    }
-
-                    return m_value;
-                };
-
-                const std::string &value() const {
-                    static std::string default_( "" );
-                    return value( default_ );
-                }
-
-                const std::string &description() const {
-                    return m_description;
-                };
-
-                const QVector<std::string> &choices() const {
-                    return m_choices;
-                };
-
-                bool isValid() const {
-                    return !m_key.empty();
-                };
-
-            private:
-                // use std::strings instead of QStrings, since the later store data as 16bit chars
-                // while cores probably use ASCII/utf-8 internally..
-                std::string m_key;
-                std::string m_value; // XXX: value should not be modified from the UI while a retro_run() call happens
-                std::string m_description;
-                QVector<std::string> m_choices;
-
-        };
-
     private:
         // Handle to the libretro core
         QLibrary *libretro_core;
@@ -291,7 +248,7 @@ class Core: public QObject {
         // Information about the core
         retro_system_av_info *system_av_info;
         retro_system_info *system_info;
-        QMap<std::string, Core::Variable> variables;
+        CoreVariables variables;
 
         // Do something with retro_variable
         retro_input_descriptor input_descriptor;
@@ -316,11 +273,20 @@ class Core: public QObject {
         int16_t left_channel;
         int16_t right_channel;
 
+        // Frames given one at a time by audioSampleCallback(), written out once per retro_run()
+        std::vector<int16_t> audio_frame_samples;
+        void flushAudioSamples();
+
         // Timing
         bool is_dupe_frame;
 
+        // Input
+        bool input_polled; // whether the core called inputPollCallback() during this frame
+
         // Misc
         void *m_sram;
+        CoreLogger logger; // used by the callbacks, which run inside of retro_run()
+        std::atomic<quint64> unsupported_commands; // one bit per environment command already reported
         void saveSRAM();
         void loadSRAM();
 
@@ -331,10 +297,8 @@ class Core: public QObject {
         static void inputPollCallback( void );
         static void logCallback( enum retro_log_level level, const char *fmt, ... );
         static int16_t inputStateCallback( unsigned port, unsigned device, unsigned index, unsigned id );
+        static bool rumbleCallback( unsigned port, retro_rumble_effect effect, uint16_t strength );
         static void videoRefreshCallback( const void *data, unsigned width, unsigned height, size_t pitch );
 };
 
-// Do not scope this globally anymore, it is not thread-safe
-// QDebug operator<<( QDebug, const Core::Variable & );
-
 #endif
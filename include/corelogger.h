@@ -0,0 +1,108 @@
+#ifndef CORELOGGER_H
+#define CORELOGGER_H
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QMutex>
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <cstdarg>
+#include <memory>
+#include <vector>
+
+#include "libretro.h"
+#include "logging.h"
+
+/* The CoreLogger takes log messages coming from the core (retro_log_callback) and from the frontend's
+ * own callbacks (environmentCallback...) off of the emulation thread.
+ *
+ * Every thread that logs gets its own single producer / single consumer ring of fixed size entries,
+ * so formatting a message only costs a vsnprintf() into a preallocated slot, with no locks and no allocation.
+ * A drainer thread empties the rings every few milliseconds and hands the messages over to the
+ * phxCore logging category.
+ *
+ * Producers never block:
+ *  - identical consecutive messages are folded into a single "repeated N times" line,
+ *  - each thread gets a budget of messages per second, anything above it is dropped,
+ *  - when a ring is full the message is dropped.
+ * Dropped messages are counted and reported by the drainer.
+ *
+ * The CoreLogger class is instantiated inside of the Core class, which lives in the core.cpp file.
+ */
+
+class CoreLogger : public QObject {
+        Q_OBJECT
+
+    public:
+        CoreLogger( QObject *parent = 0 );
+        ~CoreLogger();
+
+        // Never blocks, safe to call from any thread
+        void log( retro_log_level level, const char *fmt, ... )
+#ifdef __GNUC__
+        __attribute__( ( format( printf, 3, 4 ) ) )
+#endif
+        ;
+        void vlog( retro_log_level level, const char *fmt, va_list args );
+
+        quint64 droppedMessages() const {
+            return total_dropped.load( std::memory_order_relaxed );
+        }
+
+    private slots:
+        void slotDrain();
+
+    private:
+        static const size_t message_size = 500;
+        static const unsigned entry_count = 256; // per thread, must be a power of two
+
+        // Sustained messages per second and burst size, per thread
+        static const unsigned rate_limit = 200;
+        static const unsigned rate_burst = 400;
+
+        struct Entry {
+            qint64 timestamp; // nanoseconds since the logger was created
+            quint32 repeats; // how many times the message before this one was repeated
+            retro_log_level level;
+            char message[message_size];
+        };
+
+        struct Ring {
+            Entry entries[entry_count];
+            std::atomic<unsigned> head; // Written by the producer
+            std::atomic<unsigned> tail; // Written by the drainer
+
+            // Producer only
+            quint32 last_hash;
+            qint64 tokens_updated;
+            qint64 tokens; // scaled by 1e9, so refills don't need a division
+
+            // Shared with the drainer, which reports repeats that nothing followed
+            std::atomic<quint32> pending_repeats;
+            std::atomic<quint64> dropped_full;
+            std::atomic<quint64> dropped_rate;
+
+            Ring();
+        };
+
+        QElapsedTimer clock;
+        const quint64 logger_id;
+
+        // Rings are never freed before the logger is, threads keep a pointer to theirs
+        QMutex rings_mutex;
+        std::vector<std::unique_ptr<Ring>> rings;
+        std::atomic<quint64> total_dropped;
+
+        QThread drain_thread;
+        QTimer drain_timer;
+        unsigned drain_ticks;
+
+        Ring *threadRing();
+        void drain( bool report );
+        bool takeToken( Ring *ring, qint64 now );
+        void print( retro_log_level level, qint64 timestamp, const char *message );
+};
+
+#endif // CORELOGGER_H
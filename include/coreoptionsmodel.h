@@ -0,0 +1,64 @@
+#ifndef COREOPTIONSMODEL_H
+#define COREOPTIONSMODEL_H
+
+#include <QAbstractListModel>
+#include <QStringList>
+#include <QHash>
+#include <QByteArray>
+
+#include "corevariables.h"
+
+/* The CoreOptionsModel exposes the options declared by the running core to Qml, and saves
+ * the user's choices.
+ *
+ * Values are saved per game under "core_options/<core>/<game>", and can be promoted to
+ * defaults for every game of that core under "core_options/<core>". Saved values are handed to
+ * CoreVariables before the game is loaded, so the core starts with them.
+ *
+ * Edits go through CoreVariables::setValue(), the core picks them up on its next frame.
+ *
+ * The CoreOptionsModel class is instantiated inside of the VideoItem class, which lives in the videoitem.cpp file.
+ */
+
+class CoreOptionsModel : public QAbstractListModel {
+        Q_OBJECT
+        Q_PROPERTY( int count READ rowCount NOTIFY countChanged )
+
+    public:
+        enum Roles {
+            KeyRole = Qt::UserRole + 1,
+            DescriptionRole,
+            ChoicesRole,
+            ValueRole,
+            ValueIndexRole,
+        };
+
+        CoreOptionsModel( QObject *parent = 0 );
+
+        // Called once the core declared its options, variables must outlive the model or the next reload()
+        void reload( CoreVariables *variables, QString core_name, QString game_name );
+
+        int rowCount( const QModelIndex &parent = QModelIndex() ) const override;
+        QVariant data( const QModelIndex &index, int role = Qt::DisplayRole ) const override;
+        QHash<int, QByteArray> roleNames() const override;
+
+        Q_INVOKABLE bool setValue( int row, QString value );
+
+        // Saves the current values as the defaults of every game that uses this core
+        Q_INVOKABLE void saveAsCoreDefaults();
+
+        // Core defaults, overridden by the game's own values
+        static QHash<QByteArray, QByteArray> savedValues( QString core_name, QString game_name );
+
+    signals:
+        void countChanged();
+
+    private:
+        CoreVariables *variables;
+        QString m_core_name;
+        QString m_game_name;
+
+        static QString settingsGroup( QString core_name, QString game_name = "" );
+};
+
+#endif // COREOPTIONSMODEL_H
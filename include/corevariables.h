@@ -0,0 +1,109 @@
+#ifndef COREVARIABLES_H
+#define COREVARIABLES_H
+
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QMutex>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "libretro.h"
+
+/* CoreVariables holds the options a core declares through RETRO_ENVIRONMENT_SET_VARIABLES.
+ *
+ * Cores query them with GET_VARIABLE and GET_VARIABLE_UPDATE on every frame, from inside of retro_run(),
+ * so that path must cost next to nothing:
+ *  - every key, description and choice is interned once, when the variables are declared. Cores get
+ *    back pointers into that storage, which stay valid until the variables are declared again,
+ *  - keys are found through a flat, open addressing hash table, without any allocation or string copy,
+ *  - values are pointers to one of the variable's interned choices.
+ *
+ * Values are double buffered, so they can be edited while the core runs:
+ *  - the UI edits the staged buffer, under a mutex, and raises an atomic flag,
+ *  - right before retro_run(), latch() swaps the staged buffer in if the flag is up. It only try-locks,
+ *    if the UI happens to hold the mutex the swap waits for the next frame,
+ *  - the core only ever reads the active buffer, so values can't change in the middle of a frame,
+ *    and GET_VARIABLE_UPDATE reports true on the frame the swap happened.
+ *
+ * The CoreVariables class is instantiated inside of the Core class, which lives in the core.cpp file.
+ */
+
+class CoreVariables {
+    public:
+        struct Variable {
+            const char *key;
+            const char *description;
+            std::vector<const char *> choices; // the first one is the default
+        };
+
+        CoreVariables();
+
+        // Replaces every variable with the null-terminated array given by the core.
+        // Values found in the overrides are used instead of the defaults.
+        void define( const retro_variable *variables );
+
+        // Values to use instead of the defaults, usually the saved ones. Also applied to the variables
+        // already defined, so it must only be called while the core isn't running.
+        void setOverrides( const QHash<QByteArray, QByteArray> &overrides );
+
+        //
+        // Core side, called from the emulation thread
+        //
+
+        // Current value of key, or nullptr if the core never declared it
+        const char *value( const char *key ) const;
+
+        // Publishes staged edits, called once per frame before retro_run()
+        void latch();
+
+        // True once after any value changed, for GET_VARIABLE_UPDATE
+        bool takeUpdate() {
+            return updated.load( std::memory_order_relaxed ) && updated.exchange( false, std::memory_order_acq_rel );
+        }
+
+        //
+        // UI side, thread-safe
+        //
+
+        // value has to be one of the variable's choices, the core sees it on the next frame
+        bool setValue( const char *key, const char *value );
+        const char *stagedValue( int index ) const;
+
+        // The list only changes when the core declares its variables again
+        int count() const {
+            return int( variables.size() );
+        }
+
+        const Variable &at( int index ) const {
+            return *variables[index];
+        }
+
+    private:
+        struct Slot {
+            quint32 hash;
+            int index; // into variables, -1 when the slot is empty
+        };
+
+        QList<QByteArray> strings; // interned storage, never modified once appended
+        QHash<QByteArray, const char *> interned; // only used while defining
+        std::vector<std::unique_ptr<Variable>> variables;
+        std::vector<Slot> table; // size is a power of two
+
+        std::vector<const char *> active; // read by the core
+        std::vector<const char *> staged; // edited by the UI, under staged_mutex
+        mutable QMutex staged_mutex;
+        std::atomic<bool> staged_changed;
+        std::atomic<bool> updated;
+
+        QHash<QByteArray, QByteArray> m_overrides;
+
+        const char *intern( const QByteArray &string );
+        int find( const char *key ) const;
+        const char *choice( int index, const char *value ) const;
+        static quint32 hash( const char *key );
+};
+
+#endif // COREVARIABLES_H
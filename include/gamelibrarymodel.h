@@ -60,6 +60,9 @@ class GameLibraryModel: public QSqlTableModel {
         }
         QVariantMap get( int index );
 
+        // Only replaces missing artwork, scraped artwork is always better than a screenshot
+        bool setFallbackArtwork( QString filename, QString artwork );
+
 
     private:
         LibraryDbManager *dbm;
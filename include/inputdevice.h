@@ -1,12 +1,12 @@
 #ifndef INPUTDEVICE_H
 #define INPUTDEVICE_H
 
-#include <QMap>
-#include <QMutex>
-#include <QMutexLocker>
 #include <QString>
 #include "libretro.h"
 
+#include <atomic>
+#include <chrono>
+
 #include "libretro_types.h"
 #include "inputdeviceevent.h"
 #include "logging.h"
@@ -15,6 +15,10 @@
  * The InputDevice holds the controller mapping for button presses, and represents one and only one controller,
  * or keyboard connected to the computer.
  *
+ * The device's state is written by whichever thread delivers its events (SDL's, or the GUI thread) and read by
+ * the emulation thread, so it's kept in atomics: a bitset of pressed buttons and an array of analog axes.
+ * Neither side ever locks or allocates. snapshot() gathers it all into a State, which is what the core reads.
+ *
  * This class is instantiated from the InputManager, that lives in the inputdevicemanager.cpp class.
  */
 
@@ -28,9 +32,56 @@ class InputDevice : public QObject {
 
         virtual ~InputDevice();
 
-        int16_t state( retro_device_id id ) const {
-            QMutexLocker lock( &ids_state_mutex );
-            return ids_state.value( id, 0 );
+        // Buttons are retro_device_ids below this, one bit each
+        static const unsigned button_count = 32;
+
+        // RETRO_DEVICE_ANALOG, both axes of the left and right sticks (index * 2 + axis), then the triggers
+        enum AnalogAxis {
+            LeftX,
+            LeftY,
+            RightX,
+            RightY,
+            TriggerL2,
+            TriggerR2,
+        };
+
+        static const unsigned stick_axis_count = 4;
+        static const unsigned analog_count = 6;
+
+        struct State {
+            quint32 buttons;
+            int16_t analog[analog_count]; // indexed by AnalogAxis
+        };
+
+        // Monotonic nanoseconds, comparable across threads
+        static qint64 timestamp() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch() ).count();
+        }
+
+        // When the last event for this device was taken off of its queue, for latency accounting
+        qint64 lastEventTime() const {
+            return last_event_time.load( std::memory_order_relaxed );
+        }
+
+        // Consistent enough for input, each field is read atomically
+        State snapshot() const {
+            State state;
+            state.buttons = buttons.load( std::memory_order_relaxed );
+
+            for( unsigned i = 0; i < analog_count; i++ ) {
+                state.analog[i] = analog[i].load( std::memory_order_relaxed );
+            }
+
+            return state;
+        }
+
+        // Rumble asked for by the core, called from the emulation thread, strength goes up to 0xffff.
+        // Devices only post it and apply it from their own thread. False if the device can't rumble.
+        virtual bool setRumble( retro_rumble_effect effect, uint16_t strength ) {
+            Q_UNUSED( effect )
+            Q_UNUSED( strength )
+            return false;
         }
 
     signals:
@@ -49,19 +100,37 @@ class InputDevice : public QObject {
 
     protected:
         void setDeviceName( const char *new_name );
+
+        // Whether anything listens to inputEventReceived, which only happens while a mapping is captured.
+        // Events are only allocated and emitted then, the core's input never needs them.
+        bool isCapturing() const;
         void setState( retro_device_id id, int16_t state ) {
-            QMutexLocker lock( &ids_state_mutex );
-            ids_state[id] = state;
+            if( id >= button_count ) {
+                return;
+            }
+
+            if( state ) {
+                buttons.fetch_or( 1u << id, std::memory_order_relaxed );
+            } else {
+                buttons.fetch_and( ~( 1u << id ), std::memory_order_relaxed );
+            }
+        }
+
+        void markEvent( qint64 timestamp ) {
+            last_event_time.store( timestamp, std::memory_order_relaxed );
+        }
+
+        void setAnalogState( AnalogAxis axis, int16_t value ) {
+            analog[axis].store( value, std::memory_order_relaxed );
         }
 
         // mapping
         InputDeviceMapping *m_mapping;
 
-        // maps ids to state
-        // ids can refer to a button, an axis, etc...
-        // depending to the retro_device_type
-        QMap<retro_device_id, int16_t> ids_state;
-        mutable QMutex ids_state_mutex;
+        // bit n is set while the button with retro_device_id n is pressed
+        std::atomic<quint32> buttons;
+        std::atomic<int16_t> analog[analog_count];
+        std::atomic<qint64> last_event_time;
 
     private:
         // input device name, e.g "Xbox 360 Controller"
@@ -3,6 +3,7 @@
 #define INPUTDEVICEMAPPING_H
 
 #include <unordered_map>
+#include <QMap>
 
 #include <QSettings>
 #include <QJSValue>
@@ -10,6 +11,7 @@
 #include "libretro_types.h"
 #include "inputdevice.h"
 #include "inputdeviceevent.h"
+#include "analogresponse.h"
 
 
 /* The InputDeviceMapping class is used to map input from some device (eg keyboard, mouse, joystick)
@@ -62,8 +64,10 @@ static const QMap<retro_device_id, QString> id_to_qstring {
     { RETRO_DEVICE_ID_JOYPAD_R3, "joypad_r3" },
 };
 
+// Analog devices are joypads with sticks, their buttons are mapped the same way
 static const QMap<QString, const device_settings_mapping *> settings_mappings {
     { "joypad", &joypad_settings_mapping },
+    { "analog", &joypad_settings_mapping },
 };
 
 class InputDeviceMapping : public QObject {
@@ -92,6 +96,15 @@ class InputDeviceMapping : public QObject {
             device_type = type;
         }
 
+        // 0 is the left stick, 1 the right one
+        const AnalogResponse &stickResponse( unsigned stick ) const {
+            return stick_responses[stick];
+        }
+
+        const AnalogResponse &triggerResponse() const {
+            return trigger_response;
+        }
+
         retro_device_id getMapping( InputDeviceEvent *ev, retro_device_id defaultV = ~0 ) const {
             auto res = mapping.find( ev );
 
@@ -105,6 +118,9 @@ class InputDeviceMapping : public QObject {
         void setMapping( const InputDeviceEvent *ev, const retro_device_id id, const unsigned port );
         void setMapping( const InputDeviceEvent *ev, retro_device_id id );
 
+        // What lookup tables store for inputs that aren't mapped
+        static const retro_device_id unmapped = ~0u;
+
         DeviceMap *mappings();
 
     public slots:
@@ -121,6 +137,14 @@ class InputDeviceMapping : public QObject {
         // see libretro.h
         retro_device_type device_type;
 
+        // Built from the port's settings, see populateFromSettings()
+        AnalogResponse stick_responses[2];
+        AnalogResponse trigger_response;
+
+        // Called whenever the map changes. getMapping() hashes heap allocated events, which is too slow
+        // to do for every input, so subclasses compile the map into flat tables indexed by button or key code.
+        virtual void compileMapping() { }
+
     signals:
 
     private:
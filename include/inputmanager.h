@@ -9,6 +9,7 @@
 
 #include "inputdevice.h"
 #include "inputdevicemapping.h"
+#include "keyboardqueue.h"
 
 /* The InputManager class is a wrapper around a QList< InputDevice *ptr>.
  *
@@ -30,6 +31,9 @@ class InputManager : public QObject {
         Q_PROPERTY( bool findingDevices READ findingDevices WRITE setFindingDevices NOTIFY findingDevicesChanged )
 
     public:
+        // Most ports the core gets input from, devices past them are ignored
+        static const unsigned max_ports = 8;
+
         InputManager();
         virtual ~InputManager();
 
@@ -37,6 +41,74 @@ class InputManager : public QObject {
 
         QList<InputDevice *> getDevices() const;
 
+        // Takes a snapshot of every device's state, called from the emulation thread
+        // whenever the core polls input
+        void pollDevices();
+
+        unsigned portCount() const {
+            return port_count;
+        }
+
+        // When the last event the snapshot includes was delivered, see InputDevice::timestamp()
+        qint64 portEventTime( unsigned port ) const {
+            return ports[port].event_time;
+        }
+
+        // The device the snapshot was taken from, same thread as pollDevices()
+        InputDevice *portDevice( unsigned port ) const {
+            return ports[port].device;
+        }
+
+        // What the core sees for a port until the next poll, only called from the emulation thread.
+        // No locks, no allocations, no virtual calls, this runs many times per frame.
+        int16_t portState( unsigned port, unsigned device, unsigned index, unsigned id ) const {
+            device &= RETRO_DEVICE_MASK;
+
+            // There's only one keyboard, whatever the port
+            if( device == RETRO_DEVICE_KEYBOARD ) {
+                return keyboard_queue.isPressed( id );
+            }
+
+            if( port >= port_count ) {
+                return 0;
+            }
+
+            const PortSnapshot &snapshot = ports[port];
+
+            // The analog sticks belong to the same port as the buttons
+            if( device == RETRO_DEVICE_ANALOG ) {
+                if( index == RETRO_DEVICE_INDEX_ANALOG_BUTTON ) {
+                    return analogButton( snapshot.state, id );
+                }
+
+                unsigned axis = index * 2 + id;
+                return axis < InputDevice::stick_axis_count ? snapshot.state.analog[axis] : 0;
+            }
+
+            if( device != snapshot.device_type || id >= InputDevice::button_count ) {
+                return 0;
+            }
+
+            return ( snapshot.state.buttons >> id ) & 1;
+        }
+
+        // Forwards the core's rumble to the device on port, from the emulation thread. Never blocks.
+        bool setRumble( unsigned port, retro_rumble_effect effect, uint16_t strength ) {
+            if( port >= port_count ) {
+                return false;
+            }
+
+            return ports[port].device->setRumble( effect, strength );
+        }
+
+        // Stops every device's motors
+        void stopRumble();
+
+        // Key events for cores that emulate a keyboard, whichever port the keyboard is on
+        KeyboardQueue &keyboardQueue() {
+            return keyboard_queue;
+        }
+
         bool attachDevices() const;
         bool findingDevices() const;
         void setFindingDevices( bool findDevices );
@@ -73,6 +145,33 @@ class InputManager : public QObject {
         void findingDevicesChanged();
 
     private:
+        struct PortSnapshot {
+            retro_device_type device_type; // for the buttons, analog ports are joypads with sticks
+            InputDevice::State state;
+            qint64 event_time;
+            InputDevice *device; // for rumble, which goes the other way
+        };
+
+        // Only the triggers are really analog, other buttons are either fully pressed or not
+        static int16_t analogButton( const InputDevice::State &state, unsigned id ) {
+            switch( id ) {
+                case RETRO_DEVICE_ID_JOYPAD_L2:
+                    return state.analog[InputDevice::TriggerL2];
+
+                case RETRO_DEVICE_ID_JOYPAD_R2:
+                    return state.analog[InputDevice::TriggerR2];
+
+                default:
+                    return id < InputDevice::button_count && ( ( state.buttons >> id ) & 1 ) ? 32767 : 0;
+            }
+        }
+
+        // Written by pollDevices(), on the emulation thread
+        PortSnapshot ports[max_ports];
+        unsigned port_count;
+
+        KeyboardQueue keyboard_queue;
+
         QList<InputDevice *> devices;
         QWindow *top_window;
         QWindow *settings_window;
@@ -2,6 +2,7 @@
 #ifndef JOYSTICK_H
 #define JOYSTICK_H
 
+#include <atomic>
 #include <memory>
 #include <SDL.h>
 
@@ -26,9 +27,11 @@ class Joystick : public InputDevice {
         // enumerate plugged-in devices
         static QVariantList enumerateDevices();
 
+        virtual bool setRumble( retro_rumble_effect effect, uint16_t strength ) override;
+
         class Mapping : public InputDeviceMapping {
             public:
-                Mapping() : joystick_guid() {};
+                Mapping();
 
                 virtual InputDeviceEvent *eventFromString( QString ) override;
 
@@ -39,12 +42,24 @@ class Joystick : public InputDevice {
                 // is handled by this mapping
                 bool matchJoystick( const SDL_JoystickGUID &guid ) const;
 
+                // Called from the SDL thread for every button event
+                retro_device_id buttonMapping( Uint8 button ) const {
+                    return button_table[button].load( std::memory_order_relaxed );
+                }
+
             public slots:
                 virtual QVariant setMappingOnInput( retro_device_id id, QJSValue cb ) override;
                 virtual void cancelMappingOnInput( QVariant cancelInfo ) override;
 
+            protected:
+                virtual void compileMapping() override;
+
             private:
+                // Indexed by game controller button, or by button number for plain joysticks
+                static const unsigned button_table_size = 256;
+
                 SDL_JoystickGUID joystick_guid;
+                std::atomic<retro_device_id> button_table[button_table_size];
 
                 // only used by setMappingOnInput helper function
                 std::unique_ptr<Joystick> joystick;
@@ -56,22 +71,62 @@ class Joystick : public InputDevice {
         Mapping *m_mapping;
         int m_deadzone;
 
-        bool handleSDLEvent( const SDL_Event *event );
+        bool handleSDLEvent( const SDL_Event *event, qint64 timestamp );
         SDLEvents::EventCallback callback;
 
         SDL_Joystick *joystick;
         SDL_GameController *controller;
         bool device_attached;
 
+        // Instance ID of the opened device, -1 while there's none. Read by the emulation thread.
+        std::atomic<SDL_JoystickID> instance_id;
+
+        // Strengths asked for by setRumble(), the strong motor in the high 16 bits, the weak one in the low 16.
+        // rumble_posted stays set until the SDL thread picks them up, so updates in between share one event.
+        std::atomic<quint32> rumble_requested;
+        std::atomic<bool> rumble_posted;
+
+        // libretro's rumble lasts until the core changes it, SDL's stops after this long
+        static const Uint32 rumble_duration = 0xffff; // milliseconds, the longest SDL allows
+
+        // While a motor runs, a timer posts the rumble event this often and it's applied again if it's
+        // been at least half of that, so it never goes longer than twice this without being renewed
+        static const Uint32 rumble_refresh = 30000; // milliseconds
+
+        // SDL thread only. Devices without SDL_JoystickRumble() support go through the haptic API.
+        quint32 rumble_applied;
+        Uint32 rumble_applied_at; // SDL_GetTicks()
+        SDL_TimerID rumble_timer;
+        SDL_Haptic *haptic;
+        bool haptic_unsupported;
+
+        void applyRumble();
+        void stopRumbleTimer();
+        void closeDevice();
+
         bool deviceAdded( const SDL_Event *event );
         bool deviceRemoved( const SDL_Event *event );
 
         bool attachJoystick( int which );
         bool attachGameController( int which );
 
+        // Routes the opened device's events straight to this joystick
+        void registerInstance( SDL_Joystick *opened );
+
+        SDL_Joystick *openedJoystick() const {
+            return controller ? SDL_GameControllerGetJoystick( controller ) : joystick;
+        }
+
         bool controllerButtonChanged( const SDL_Event *event );
         bool controllerAxisChanged( const SDL_Event *event );
 
+        // Raw values from SDL, indexed by InputDevice::AnalogAxis. Sticks need both of their axes at once.
+        int16_t raw_axes[analog_count];
+        void updateAnalog( AnalogAxis axis, int16_t value );
+
+        // Which AnalogAxis an SDL axis is, false if it isn't one
+        bool analogAxis( const SDL_Event *event, AnalogAxis *axis ) const;
+
         // convenience functions to check that an event matches the current joystick/controller
         template <typename SDLEventType> bool ControllerMatchEvent( const SDLEventType &event );
         template <typename SDLEventType> bool JoystickMatchEvent( const SDLEventType &event );
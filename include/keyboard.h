@@ -25,20 +25,35 @@ class Keyboard : public InputDevice {
 
         class Mapping : public InputDeviceMapping {
             public:
-                Mapping() {}
+                Mapping();
 
                 virtual InputDeviceEvent *eventFromString( QString ) override;
 
+                // Called for every key event
+                retro_device_id keyMapping( Qt::Key key, Qt::KeyboardModifiers modifiers );
+
             public slots:
                 virtual QVariant setMappingOnInput( retro_device_id id, QJSValue cb ) override;
                 virtual void cancelMappingOnInput( QVariant cancelInfo ) override;
 
+            protected:
+                virtual void compileMapping() override;
+
             private:
+                // Latin-1 keys, then Qt's special keys (Qt::Key_Escape and up). Only keys mapped without
+                // any modifier are in the table, the others are looked up in the map.
+                static const unsigned key_table_size = 512;
+                static int keyIndex( Qt::Key key );
+
+                retro_device_id key_table[key_table_size];
+
                 // only used by setMappingOnInput helper function
                 std::unique_ptr<Keyboard> keyboard;
         };
 
     private:
+        Mapping *m_mapping;
+
         // process QKeyEvent sent from some widget/window
         // as a button press in this virtual Input Device
         void processKeyEvent( QKeyEvent *event );
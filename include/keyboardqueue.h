@@ -0,0 +1,95 @@
+#ifndef KEYBOARDQUEUE_H
+#define KEYBOARDQUEUE_H
+
+#include <QHash>
+#include <QKeyEvent>
+
+#include <atomic>
+
+#include "libretro.h"
+
+/* The KeyboardQueue carries the computer's keyboard over to cores that emulate one (RETRO_DEVICE_KEYBOARD),
+ * DOSBox and the like.
+ *
+ * Qt delivers key events on the GUI thread, the core runs on the emulation thread. Key events are translated
+ * to RETROK_* codes and RETROKMOD_* modifiers right away and pushed into a single producer / single consumer
+ * ring, so typing never blocks either side. Right before retro_run(), deliver() empties the ring into the core's
+ * retro_keyboard_event callback and updates the pressed keys that RETRO_DEVICE_KEYBOARD queries read.
+ *
+ * libretro's keycodes name keys, not characters, so shifted symbols are sent as their unshifted key (on a US layout),
+ * the character still says what was typed. A key is released with the keycode it was pressed with, whatever Qt
+ * reports for the release once the modifiers changed.
+ *
+ * Events only get queued between start() and stop(), and not while the game is paused, so the frontend's own
+ * menus and settings don't reach the core. Keys held when the game gets paused are released.
+ * The frontend's hotkeys don't either. While the core takes key events they need Ctrl held, so that plain
+ * Space and Escape are the game's, see isHotkey().
+ *
+ * The KeyboardQueue class is instantiated inside of the InputManager class, which lives in the inputmanager.cpp file.
+ */
+
+class KeyboardQueue {
+    public:
+        KeyboardQueue();
+
+        //
+        // GUI thread
+        //
+
+        void push( const QKeyEvent *event );
+
+        // Nothing is queued while paused, keys that are down get released first
+        void setPaused( bool paused );
+
+        // Whether event is one of VideoItem::keyEvent()'s keys, with Ctrl if the core has a keyboard callback
+        bool isHotkey( const QKeyEvent *event ) const;
+
+        //
+        // Core side: start() and stop() around the game, the rest from the emulation thread
+        //
+
+        // Drops whatever was typed before, then starts queuing
+        void start();
+        void stop();
+
+        // callback may be null, the pressed keys are still tracked for cores that only poll
+        void deliver( retro_keyboard_event_t callback );
+
+        bool isPressed( unsigned keycode ) const {
+            return keycode < RETROK_LAST && ( pressed[keycode / 32] >> ( keycode % 32 ) ) & 1;
+        }
+
+        // RETROK_UNKNOWN for keys libretro has no code for, they still get their character.
+        // Shifted symbols give their unshifted key, RETROK_1 for Qt::Key_Exclam.
+        static unsigned translateKey( int key, Qt::KeyboardModifiers modifiers );
+        static uint16_t translateModifiers( Qt::KeyboardModifiers modifiers );
+
+    private:
+        static const unsigned event_count = 256; // must be a power of two
+
+        struct Event {
+            bool down;
+            unsigned keycode;
+            uint32_t character;
+            uint16_t modifiers;
+        };
+
+        Event events[event_count];
+        std::atomic<unsigned> head; // Written by push()
+        std::atomic<unsigned> tail; // Written by deliver()
+        std::atomic<bool> queuing;
+        std::atomic<bool> core_callback; // Whether deliver() last got a callback
+
+        // Emulation thread only
+        quint32 pressed[( RETROK_LAST + 31 ) / 32];
+
+        // GUI thread only, the keycode each key down was queued with, by native scan code (Qt key code without one)
+        QHash<quint64, unsigned> down_keys;
+        bool m_paused;
+
+        static quint64 physicalKey( const QKeyEvent *event );
+
+        bool pushEvent( const Event &event );
+};
+
+#endif // KEYBOARDQUEUE_H
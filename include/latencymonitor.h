@@ -0,0 +1,79 @@
+#ifndef LATENCYMONITOR_H
+#define LATENCYMONITOR_H
+
+#include <QElapsedTimer>
+
+#include "inputmanager.h"
+#include "logging.h"
+
+/* The LatencyMonitor measures how long input takes to show up on screen, per port.
+ *
+ * Every input event is timestamped when SDL or Qt delivers it (see InputDevice::lastEventTime()). From there,
+ * the monitor follows the first new event of each port through the pipeline:
+ *  - latched, when the core polls input,
+ *  - uploaded, when the frame the core ran with it gets uploaded in VideoItem::setTexture(),
+ *  - swapped, when the window's frameSwapped signal fires, which is as close to photons as we can get.
+ * Any event arriving meanwhile is only followed once the previous one made it to the screen.
+ *
+ * Each stage gets its own histogram, all three are reported every few seconds. Everything runs on the render
+ * thread, which is also where the core runs, so nothing needs locking. Device names are taken from the port snapshot
+ * when an event is latched, the device list itself belongs to the GUI thread.
+ *
+ * The LatencyMonitor class is instantiated inside of the VideoItem class, which lives in the videoitem.cpp file.
+ */
+
+class LatencyMonitor {
+    public:
+        LatencyMonitor();
+
+        void inputLatched( const InputManager &inputs );
+        void frameUploaded();
+        void frameSwapped();
+
+        // Logs every histogram, and starts over
+        void report();
+
+    private:
+        static const int report_interval = 5000; // milliseconds
+
+        // Half a millisecond each, anything past the last bucket goes into it
+        static const int bucket_width = 500000; // nanoseconds
+        static const int bucket_count = 200;
+
+        struct Histogram {
+            quint32 buckets[bucket_count];
+            quint32 count;
+            qint64 sum;
+            qint64 max;
+
+            void clear();
+            void add( qint64 nsecs );
+            double percentile( double fraction ) const; // milliseconds
+            QString summary() const;
+            QString distribution() const;
+        };
+
+        enum Stage {
+            Idle,
+            Latched,
+            Uploaded,
+        };
+
+        struct Port {
+            qint64 last_event; // last event time seen, to spot new ones
+            qint64 event;
+            qint64 latched;
+            qint64 uploaded;
+            Stage stage;
+            QString device_name; // as of the last latched event
+
+            Histogram to_latch;
+            Histogram to_upload;
+            Histogram to_photon;
+        };
+
+        Port ports[InputManager::max_ports];
+        QElapsedTimer report_timer;
+};
+
+#endif // LATENCYMONITOR_H
@@ -0,0 +1,24 @@
+#ifndef LATENCYTESTCORE_H
+#define LATENCYTESTCORE_H
+
+#include "core.h"
+
+/* The latency test core is a tiny libretro core built into Phoenix, for measuring input latency without a camera.
+ *
+ * It shows a single color over the whole screen, and switches between black and white whenever a button
+ * gets pressed on any port, on the very frame it sees the press. A photodiode taped to the screen, or just the
+ * LatencyMonitor's logs, then tells how long input takes to show up. It plays silence, so audio sync still works.
+ *
+ * Core::loadCore() uses it instead of loading a library when given LatencyTestCore::path.
+ */
+
+namespace LatencyTestCore {
+
+    extern const char *const path;
+
+    // Points every symbol to the built-in core
+    void resolveSymbols( LibretroSymbols *symbols );
+
+}
+
+#endif // LATENCYTESTCORE_H
@@ -24,6 +24,7 @@ class LibraryDbManager {
         int version() const;
 
         static const QString table_games;
+        static const QString connection_name;
 
     private:
         LibraryDbManager( const LibraryDbManager & );
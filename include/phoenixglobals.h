@@ -29,6 +29,15 @@ class PhoenixGlobals : public QObject {
         void setSelectedGame( const QString &file );
         void setSelectedCore( const QString &file );
 
+        // From the command line, a WAV file path or "hash". Audio is rendered there instead of the sound card
+        void setNullAudioOutput( const QString &target );
+        QString nullAudioOutput() const;
+
+        // From the command line, input latency gets measured and logged
+        void setMeasureInputLatency( bool measure );
+        bool measureInputLatency() const;
+        void setLatencyTest( bool test );
+
     public slots:
         QString offlineStoragePath() const;
         QString biosPath() const;
@@ -38,6 +47,9 @@ class PhoenixGlobals : public QObject {
         QFileInfo selectedGame() const;
         QFileInfo selectedCore() const;
 
+        // The built-in latency test core when it was asked for on the command line, empty otherwise
+        QString latencyTestCore() const;
+
         bool validCore( QString core_path );
         bool validGame( QString game_path );
 
@@ -49,6 +61,9 @@ class PhoenixGlobals : public QObject {
         QString m_config_path;
         QFileInfo m_selected_game;
         QFileInfo m_selected_core;
+        QString m_null_audio_output;
+        bool m_measure_input_latency;
+        bool m_latency_test;
 
 };
 
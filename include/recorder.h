@@ -0,0 +1,120 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QFile>
+#include <QString>
+
+#include <atomic>
+#include <vector>
+#include <memory>
+
+#include "libretro.h"
+#include "audiobuffer.h"
+#include "logging.h"
+
+/* The Recorder class streams the raw output of a running core to disk, for QA session captures.
+ *
+ * Video frames are taken at videoRefreshCallback() time, and audio at audioSampleBatchCallback() time.
+ * Both are pushed into lock-free single producer / single consumer queues that are drained by
+ * a writer thread, which converts and streams them to a Y4M (video) and a WAV (audio) file.
+ *
+ * The push*() methods are called from inside of retro_run() and never block: when the writer falls behind
+ * (e.g. under disk pressure), frames are dropped and counted instead.
+ *
+ * The Recorder class is instantiated inside of the VideoItem class, which lives in the videoitem.cpp file.
+ */
+
+class Recorder : public QObject {
+        Q_OBJECT
+
+    public:
+        Recorder( QObject *parent = 0 );
+        ~Recorder();
+
+        //
+        // Producer side, called from the emulation thread
+        //
+
+        void pushVideoFrame( const void *data, unsigned width, unsigned height, size_t pitch, retro_pixel_format format );
+
+        // The core asked to duplicate the previous frame, no pixels are copied
+        void pushDupeFrame();
+
+        void pushAudio( const int16_t *data, size_t frames );
+
+        bool isRecording() const {
+            return recording.load( std::memory_order_acquire );
+        }
+
+        quint64 droppedFrames() const {
+            return dropped_frames.load( std::memory_order_relaxed );
+        }
+
+        quint64 droppedAudioFrames() const {
+            return dropped_audio_frames.load( std::memory_order_relaxed );
+        }
+
+    signals:
+        void recordingChanged( bool recording );
+        void recordingFinished( QString base_path, quint64 dropped_frames, quint64 dropped_audio_frames );
+
+    public slots:
+        // Opens base_path.y4m and base_path.wav and starts draining the queues.
+        // Must be invoked on the writer thread (use a queued connection).
+        void slotStart( QString base_path, double fps, double sample_rate, unsigned max_width, unsigned max_height );
+        void slotStop();
+
+    private slots:
+        void slotDrain();
+
+    private:
+        // One preallocated video frame, pixels are stored tightly packed (pitch == width * bpp)
+        struct FrameSlot {
+            std::vector<char> pixels;
+            unsigned width;
+            unsigned height;
+            retro_pixel_format format;
+            bool dupe;
+        };
+
+        static const unsigned frame_slot_count = 16; // Must be a power of two
+
+        FrameSlot frame_slots[frame_slot_count];
+        std::atomic<unsigned> frame_head; // Written by the producer
+        std::atomic<unsigned> frame_tail; // Written by the consumer
+
+        std::unique_ptr<AudioBuffer> audio_queue;
+
+        std::atomic<bool> recording;
+        std::atomic<quint64> dropped_frames;
+        std::atomic<quint64> dropped_audio_frames;
+
+        QThread writer_thread;
+        QTimer drain_timer;
+
+        // Writer thread state
+        QString m_base_path;
+        QFile video_file;
+        QFile audio_file;
+        double m_fps;
+        double m_sample_rate;
+        unsigned canvas_width;
+        unsigned canvas_height;
+        quint64 frames_written;
+        quint64 audio_bytes_written;
+        std::vector<uchar> yuv_frame; // Last converted frame, rewritten for dupes
+        std::vector<char> audio_scratch;
+
+        void writeFrame( const FrameSlot &slot );
+        void writeY4MHeader();
+        void writeWavHeader();
+        void convertToYUV444( const FrameSlot &slot );
+        void discardQueued();
+        void failWrite( const QFile &file );
+
+};
+
+#endif // RECORDER_H
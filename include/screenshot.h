@@ -0,0 +1,76 @@
+#ifndef SCREENSHOT_H
+#define SCREENSHOT_H
+
+#include <QObject>
+#include <QMutex>
+#include <QString>
+#include <QList>
+#include <QThreadPool>
+
+#include <atomic>
+#include <vector>
+
+#include "libretro.h"
+#include "logging.h"
+
+/* The Screenshot class captures frames straight from the core's framebuffer, at the core's native resolution.
+ *
+ * A capture only copies the frame once, into a pooled buffer, on the thread that ran the core.
+ * Encoding to PNG (or WebP, when the Qt image plugin is available) happens on a QThreadPool worker,
+ * so taking a screenshot never stalls a frame.
+ *
+ * Saved screenshots are also used as savestate thumbnails and as library artwork for games
+ * that don't have any scraped artwork.
+ *
+ * The Screenshot class is instantiated inside of the VideoItem class, which lives in the videoitem.cpp file.
+ */
+
+class Screenshot : public QObject {
+        Q_OBJECT
+
+    public:
+        enum Purpose {
+            UserScreenshot,
+            StateThumbnail
+        };
+
+        Screenshot( QObject *parent = 0 );
+        ~Screenshot();
+
+        // Thread-safe, the next frame produced by the core is saved to path.
+        // game is the one running when the request was made, it's handed back by saved().
+        void request( Purpose purpose, QString path, QString game );
+
+        bool isPending() const {
+            return has_requests.load( std::memory_order_acquire );
+        }
+
+        // Called on the thread that runs the core, right after a new frame was produced
+        void capture( const void *data, unsigned width, unsigned height, size_t pitch, retro_pixel_format format );
+
+        // Buffer pool, used by the encoding tasks to give their buffer back
+        std::vector<char> acquireBuffer( size_t size );
+        void releaseBuffer( std::vector<char> &&buffer );
+
+    signals:
+        void saved( QString path, int purpose, QString game );
+
+    private:
+        struct Request {
+            Purpose purpose;
+            QString path;
+            QString game;
+        };
+
+        QMutex requests_mutex;
+        QList<Request> requests;
+        std::atomic<bool> has_requests;
+
+        QMutex pool_mutex;
+        std::vector<std::vector<char>> free_buffers;
+
+        QThreadPool encoder_pool;
+
+};
+
+#endif // SCREENSHOT_H
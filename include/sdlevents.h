@@ -2,18 +2,30 @@
 #ifndef SDLEVENTS_H
 #define SDLEVENTS_H
 
+#include <atomic>
 #include <functional>
 #include <mutex>
 #include <QObject>
-#include <QTimer>
+#include <QMutex>
 #include <QThread>
 #include <QList>
+#include <QHash>
+#include <QVarLengthArray>
 #include <SDL.h>
 #include "inputdevice.h"
 
 
 /* The SDLEvents class is sued to start SDL's event loop, binding it to a different thread,
  * and setting up callbacks to the appropriate InputDevice.
+ *
+ * The thread sleeps in SDL_WaitEventTimeout() until something happens, then drains SDL's whole queue.
+ * Waiting pumps the devices, so it happens under sdl_mutex like every other SDL call, a few milliseconds at a time.
+ * Events about an opened joystick go straight to its callback, looked up by instance ID. Everything else,
+ * devices being plugged in mostly, goes to every registered callback until one handles it.
+ * Each event is given the time it was taken off of the queue, so input latency can be measured from there.
+ *
+ * Other threads can't call into SDL's joystick and haptic functions while this one runs, some of them block
+ * for milliseconds. They post an event for the device instead, see postRumble(), and its callback does the work here.
  */
 class SDLEvents : public QObject {
         Q_OBJECT
@@ -21,8 +33,10 @@ class SDLEvents : public QObject {
         SDLEvents();
         virtual ~SDLEvents();
 
-        typedef std::function<bool( const SDL_Event * )> EventCallback;
+        // timestamp is from InputDevice::timestamp()
+        typedef std::function<bool( const SDL_Event *, qint64 timestamp )> EventCallback;
 
+        // Gets the events that aren't about any opened joystick
         void registerCallback( EventCallback *cb ) {
             QMutexLocker lock( &event_callbacks_mutex );
             event_callbacks.append( cb );
@@ -33,27 +47,71 @@ class SDLEvents : public QObject {
             event_callbacks.removeOne( cb );
         }
 
+        // Gets every event about the joystick with this instance ID, until it's removed.
+        // A device may be opened more than once, by the mapping capture for instance.
+        void registerInstance( SDL_JoystickID instance, EventCallback *cb ) {
+            QMutexLocker lock( &event_callbacks_mutex );
+            instance_callbacks.insert( instance, cb );
+        }
+
+        void removeInstance( SDL_JoystickID instance, EventCallback *cb ) {
+            QMutexLocker lock( &event_callbacks_mutex );
+            instance_callbacks.remove( instance, cb );
+        }
+
+        // Has rumbleEventType() delivered to the callbacks of instance, from any thread.
+        // SDL_PushEvent() only holds the queue's lock for a moment. False if the event couldn't be queued.
+        bool postRumble( SDL_JoystickID instance );
+
+        Uint32 rumbleEventType() const {
+            return rumble_event_type;
+        }
+
         // locks the SDL event loop.
-        // for when functions outside of the SDL thread want to call SDL functions
+        // for when functions outside of the SDL thread want to call SDL functions.
+        // Waits for the loop's current SDL_WaitEventTimeout() to return, wait_timeout at most.
         std::unique_lock<QMutex> lockSDL() {
-            return std::unique_lock<QMutex>( sdl_mutex );
+            lock_requests++;
+            std::unique_lock<QMutex> lock( sdl_mutex );
+            lock_requests--;
+            return lock;
         }
 
     protected slots:
-        void pollSDL();
         void threadStarted();
         void threadFinished();
 
     private:
-        QTimer polltimer;
+        // Any event ends the wait. The wait holds sdl_mutex, this is also how long lockSDL() may block.
+        static const int wait_timeout = 10; // milliseconds
+        static const int batch_size = 32;
+
+        // Callbacks per instance that fit on the stack, more still get the event
+        static const int max_instance_callbacks = 4;
+
         QThread thread;
+        std::atomic<bool> running;
+
+        // Pushed to end the wait when shutting down
+        std::atomic<Uint32> wake_event_type;
+        std::atomic<Uint32> rumble_event_type;
 
         // buffer used to temporarily store events we got from SDL
-        SDL_Event *event_list;
+        SDL_Event event_list[batch_size];
 
         QList<EventCallback *> event_callbacks;
+        QMultiHash<SDL_JoystickID, EventCallback *> instance_callbacks;
         QMutex event_callbacks_mutex;
         QMutex sdl_mutex;
+
+        // Threads waiting in lockSDL(), the loop lets them in before taking sdl_mutex again
+        std::atomic<int> lock_requests;
+
+        void run();
+        void dispatch( const SDL_Event *event, qint64 timestamp );
+
+        // Whether event is about a single opened joystick, and which one
+        bool eventInstance( const SDL_Event *event, SDL_JoystickID *instance ) const;
 };
 
 #endif
@@ -0,0 +1,119 @@
+#ifndef SHADERCHAIN_H
+#define SHADERCHAIN_H
+
+#include <QOpenGLFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLBuffer>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QSize>
+
+#include <memory>
+#include <vector>
+
+#include "logging.h"
+
+/* The ShaderChain renders the core's frame through a preset of fragment shader passes (CRT, NTSC, sharp-bilinear...).
+ *
+ * Every pass draws into its own FBO, the next pass samples it. The last pass is always sized to the viewport,
+ * and its texture is what ends up being drawn by the scene graph.
+ *
+ * Shaders follow the usual libretro GLSL conventions: a Source sampler, SourceSize, OutputSize,
+ * OriginalSize (vec4: width, height, 1 / width, 1 / height) and FrameCount uniforms.
+ *
+ * Linked programs are kept in an on-disk cache, using glGetProgramBinary(), so they don't get
+ * recompiled on every launch. Entries are keyed by the GL driver strings and a hash of the shader sources.
+ *
+ * All of it must run on the rendering thread, with the scene graph's context current.
+ *
+ * The ShaderChain is instantiated inside of the VideoItem class, which lives in the videoitem.cpp file.
+ */
+
+class ShaderChain : protected QOpenGLFunctions {
+    public:
+        struct Pass {
+            enum ScaleType {
+                ScaleSource,  // relative to the pass' input
+                ScaleViewport // relative to the final output
+            };
+
+            QString fragment; // file name under :/shaders/
+            ScaleType scale_type;
+            float scale_x;
+            float scale_y;
+            bool filter_linear; // how this pass samples its input
+        };
+
+        ShaderChain();
+        ~ShaderChain();
+
+        // Names accepted by setPreset(), "none" disables the chain
+        static QStringList presetNames();
+
+        // Must be called once the context is current, before anything else
+        void initialize( const QString &cache_path );
+        bool isInitialized() const {
+            return initialized;
+        }
+
+        // Releases every GL resource, the context must still be current
+        void release();
+
+        bool setPreset( const QString &name );
+        QString preset() const {
+            return m_preset;
+        }
+
+        bool isEnabled() const {
+            return !programs.empty();
+        }
+
+        // Runs all passes on input_texture, returns the texture holding the result.
+        // The GL state is left dirty, call QQuickWindow::resetOpenGLState() afterwards.
+        GLuint render( GLuint input_texture, const QSize &input_size, const QSize &output_size );
+
+    private:
+        typedef void ( QOPENGLF_APIENTRYP GetProgramBinaryFn )( GLuint program, GLsizei buf_size, GLsizei *length,
+                GLenum *binary_format, void *binary );
+        typedef void ( QOPENGLF_APIENTRYP ProgramBinaryFn )( GLuint program, GLenum binary_format,
+                const void *binary, GLsizei length );
+        typedef void ( QOPENGLF_APIENTRYP ProgramParameteriFn )( GLuint program, GLenum pname, GLint value );
+
+        struct Program {
+            GLuint id;
+            GLint source;
+            GLint source_size;
+            GLint output_size;
+            GLint original_size;
+            GLint frame_count;
+        };
+
+        bool initialized;
+        QString m_preset;
+        std::vector<Pass> passes;
+        std::vector<Program> programs;
+        std::vector<std::unique_ptr<QOpenGLFramebufferObject>> fbos;
+        QOpenGLBuffer quad;
+        unsigned frame_count;
+
+        // Program binary cache, empty cache_path means it's not supported by the driver
+        QString cache_path;
+        QByteArray driver_key;
+        GetProgramBinaryFn getProgramBinary;
+        ProgramBinaryFn programBinary;
+        ProgramParameteriFn programParameteri;
+
+        static std::vector<Pass> presetPasses( const QString &name );
+
+        bool buildProgram( const QString &fragment_file, Program &program );
+        GLuint linkFromCache( const QString &file );
+        GLuint linkFromSource( const QByteArray &vertex, const QByteArray &fragment );
+        void storeInCache( GLuint program, const QString &file );
+        GLuint compileShader( GLenum type, const QByteArray &source );
+
+        void resizeTargets( const QSize &input_size, const QSize &output_size );
+        void clearPasses();
+};
+
+#endif // SHADERCHAIN_H
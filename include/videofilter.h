@@ -0,0 +1,139 @@
+#ifndef VIDEOFILTER_H
+#define VIDEOFILTER_H
+
+#include <QImage>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "libretro.h"
+
+/* CPU-side upscaling filters, applied between the core's framebuffer and the texture upload.
+ *
+ * They give good looking output on machines where GPU shaders aren't an option (thin clients, software GL).
+ * All filters work on XRGB8888 pixels. The pipeline converts the core's frame to that format first,
+ * then runs each filter stage split in horizontal bands across QtConcurrent's thread pool.
+ *
+ * The VideoFilterPipeline is instantiated inside of the VideoItem class, which lives in the videoitem.cpp file.
+ */
+
+class VideoFilter {
+    public:
+        virtual ~VideoFilter() {}
+
+        // Integer scale factor applied to both dimensions
+        virtual unsigned scale() const = 0;
+
+        // Filters source rows [first_row, last_row) into the matching destination rows.
+        // Pitches are in pixels. Rows outside of the band may be read, but never written.
+        virtual void process( const quint32 *src, size_t src_pitch, unsigned width, unsigned height,
+                              quint32 *dst, size_t dst_pitch, unsigned first_row, unsigned last_row ) const = 0;
+};
+
+// Plain pixel replication
+class NearestFilter : public VideoFilter {
+    public:
+        NearestFilter( unsigned factor ) : factor( factor ) {}
+
+        unsigned scale() const override {
+            return factor;
+        }
+
+        void process( const quint32 *src, size_t src_pitch, unsigned width, unsigned height,
+                      quint32 *dst, size_t dst_pitch, unsigned first_row, unsigned last_row ) const override;
+
+    private:
+        unsigned factor;
+};
+
+// Scale2x / AdvMAME2x edge interpolation
+class Scale2xFilter : public VideoFilter {
+    public:
+        unsigned scale() const override {
+            return 2;
+        }
+
+        void process( const quint32 *src, size_t src_pitch, unsigned width, unsigned height,
+                      quint32 *dst, size_t dst_pitch, unsigned first_row, unsigned last_row ) const override;
+};
+
+// Scale3x / AdvMAME3x edge interpolation
+class Scale3xFilter : public VideoFilter {
+    public:
+        unsigned scale() const override {
+            return 3;
+        }
+
+        void process( const quint32 *src, size_t src_pitch, unsigned width, unsigned height,
+                      quint32 *dst, size_t dst_pitch, unsigned first_row, unsigned last_row ) const override;
+};
+
+// Pixel replication with the last row of every scaled line darkened to 75%
+class ScanlinesFilter : public VideoFilter {
+    public:
+        ScanlinesFilter( unsigned factor ) : factor( factor ) {}
+
+        unsigned scale() const override {
+            return factor;
+        }
+
+        void process( const quint32 *src, size_t src_pitch, unsigned width, unsigned height,
+                      quint32 *dst, size_t dst_pitch, unsigned first_row, unsigned last_row ) const override;
+
+    private:
+        unsigned factor;
+};
+
+class VideoFilterPipeline {
+    public:
+        VideoFilterPipeline();
+        ~VideoFilterPipeline();
+
+        // Names accepted by setFilter(), "none" disables the pipeline
+        static QStringList filterNames();
+
+        bool setFilter( const QString &name );
+
+        QString filter() const {
+            return m_filter;
+        }
+
+        bool isEnabled() const {
+            return !stages.empty();
+        }
+
+        // Runs the whole chain on one frame, the returned image wraps the pipeline's own
+        // output buffer and stays valid until the next call
+        QImage process( const void *data, unsigned width, unsigned height, size_t pitch, retro_pixel_format format );
+
+        // Average time spent per frame, in microseconds, since the last call (conversion included).
+        // If report is given, it's filled with the same average broken down by stage.
+        qreal takeAverageCost( QString *report = nullptr );
+
+    private:
+        struct Band {
+            unsigned first_row;
+            unsigned last_row;
+        };
+
+        std::vector<std::unique_ptr<VideoFilter>> stages;
+        std::vector<std::vector<quint32>> buffers; // [0] is the converted frame, [i + 1] the output of stage i
+        std::vector<Band> bands;
+        QString m_filter;
+
+        // Written by the rendering thread, read by whoever reports the cost.
+        // Index 0 is the pixel format conversion.
+        static const size_t max_stages = 4;
+        std::atomic<qint64> stage_nsecs[max_stages + 1];
+        std::atomic<qint64> total_nsecs;
+        std::atomic<qint64> frame_count;
+        std::atomic<size_t> stage_count;
+
+        void splitBands( unsigned height );
+        void convert( const void *data, unsigned width, unsigned height, size_t pitch, retro_pixel_format format );
+};
+
+#endif // VIDEOFILTER_H
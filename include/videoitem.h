@@ -8,6 +8,7 @@
 #include <QtGui/QOpenGLShaderProgram>
 #include <QtGui/QOpenGLContext>
 #include <QOpenGLTexture>
+#include <QOpenGLPixelTransferOptions>
 #include <QImage>
 #include <QWindow>
 #include <QByteArray>
@@ -18,6 +19,12 @@
 #include "qdebug.h"
 #include "core.h"
 #include "audio.h"
+#include "recorder.h"
+#include "latencymonitor.h"
+#include "screenshot.h"
+#include "videofilter.h"
+#include "shaderchain.h"
+#include "coreoptionsmodel.h"
 #include "keyboard.h"
 #include "logging.h"
 
@@ -45,14 +52,25 @@ class VideoItem : public QQuickItem {
         Q_PROPERTY( int filtering READ filtering WRITE setFiltering NOTIFY filteringChanged )
         Q_PROPERTY( bool stretchVideo READ stretchVideo WRITE setStretchVideo NOTIFY stretchVideoChanged )
         Q_PROPERTY( qreal aspectRatio READ aspectRatio WRITE setAspectRatio NOTIFY aspectRatioChanged )
+        Q_PROPERTY( bool integerScaling READ integerScaling WRITE setIntegerScaling NOTIFY integerScalingChanged )
+        Q_PROPERTY( bool recording READ recording NOTIFY recordingChanged )
+        Q_PROPERTY( QString videoFilter READ videoFilter WRITE setVideoFilter NOTIFY videoFilterChanged )
+        Q_PROPERTY( qreal videoFilterCost READ videoFilterCost NOTIFY videoFilterCostChanged )
+        Q_PROPERTY( QString shaderPreset READ shaderPreset WRITE setShaderPreset NOTIFY shaderPresetChanged )
+        Q_PROPERTY( QString resamplerQuality READ resamplerQuality WRITE setResamplerQuality NOTIFY resamplerQualityChanged )
+        Q_PROPERTY( qreal resamplerCost READ resamplerCost NOTIFY resamplerCostChanged )
+        Q_PROPERTY( QString syncMode READ syncMode WRITE setSyncMode NOTIFY syncModeChanged )
+        Q_PROPERTY( QString audioDevice READ audioDevice WRITE setAudioDevice NOTIFY audioDeviceChanged )
+        Q_PROPERTY( qreal audioBufferFill READ audioBufferFill NOTIFY audioBufferFillChanged )
+        Q_PROPERTY( QObject *coreOptions READ coreOptions CONSTANT )
 
 
     public:
         VideoItem();
         ~VideoItem();
 
-        void initShader();
-        void initGL();
+        void initShader(); // (re)loads the shader preset, rendering thread only
+        void initGL(); // sets up the shader chain once the scene graph's context is current
         void setCore( QString libcore );
         void setGame( QString game );
         void setRun( bool isRunning );
@@ -63,6 +81,12 @@ class VideoItem : public QQuickItem {
         void setFiltering( int filtering );
         void setStretchVideo( bool stretchVideo );
         void setAspectRatio( qreal aspectRatio );
+        void setIntegerScaling( bool integerScaling );
+        void setVideoFilter( QString videoFilter );
+        void setShaderPreset( QString shaderPreset );
+        void setResamplerQuality( QString resamplerQuality );
+        void setSyncMode( QString syncMode );
+        void setAudioDevice( QString audioDevice );
 
 
         QString libcore() const {
@@ -73,6 +97,10 @@ class VideoItem : public QQuickItem {
             return m_game;
         }
 
+        QObject *coreOptions() {
+            return &core_options;
+        }
+
         bool isRunning() const {
             return m_run;
         }
@@ -105,6 +133,49 @@ class VideoItem : public QQuickItem {
             return m_aspect_ratio;
         }
 
+        bool integerScaling() const {
+            return m_integer_scaling;
+        }
+
+        bool recording() const {
+            return recorder.isRecording();
+        }
+
+        QString videoFilter() const {
+            return m_video_filter;
+        }
+
+        // Average CPU time spent in the filter pipeline per frame, in microseconds
+        qreal videoFilterCost() const {
+            return m_video_filter_cost;
+        }
+
+        QString resamplerQuality() const {
+            return m_resampler_quality;
+        }
+
+        qreal resamplerCost() const {
+            return m_resampler_cost;
+        }
+
+        QString syncMode() const {
+            return m_sync_mode;
+        }
+
+        // Empty for the system's default device
+        QString audioDevice() const {
+            return m_audio_device;
+        }
+
+        // Milliseconds of core audio waiting to be played, averaged over the last second
+        qreal audioBufferFill() const {
+            return m_audio_buffer_fill;
+        }
+
+        QString shaderPreset() const {
+            return m_shader_preset;
+        }
+
 
 
 
@@ -117,6 +188,10 @@ class VideoItem : public QQuickItem {
             keyEvent( event );
         };
         QSGNode *updatePaintNode( QSGNode *, UpdatePaintNodeData * );
+        void geometryChanged( const QRectF &new_geometry, const QRectF &old_geometry ) override;
+
+        // Called when the item leaves its window, the textures are freed on the rendering thread
+        void releaseResources() override;
 
     signals:
         void libcoreChanged( QString );
@@ -130,6 +205,19 @@ class VideoItem : public QQuickItem {
         void filteringChanged();
         void stretchVideoChanged();
         void aspectRatioChanged();
+        void integerScalingChanged();
+        void recordingChanged();
+        void videoFilterChanged();
+        void resamplerQualityChanged( QString resamplerQuality );
+        void resamplerCostChanged();
+        void syncModeChanged();
+        void audioDeviceChanged();
+        void audioBufferFillChanged();
+        void videoFilterCostChanged();
+        void shaderPresetChanged();
+
+        // A user screenshot of game was saved, the library uses it as artwork for games that have none
+        void screenshotSaved( QString game, QString artwork );
 
     public slots:
         //void paint();
@@ -137,37 +225,78 @@ class VideoItem : public QQuickItem {
         void loadGameState();
         QStringList getAudioDevices();
 
+        // Records raw video and audio to path.y4m and path.wav,
+        // an empty path records into the save directory
+        void startRecording( QString path = "" );
+        void stopRecording();
+
+        // Saves the next frame at the core's native resolution into the save directory
+        void takeScreenshot();
+
+        QStringList getVideoFilters() {
+            return VideoFilterPipeline::filterNames();
+        }
+
+        QStringList getShaderPresets() {
+            return ShaderChain::presetNames();
+        }
+
+        QStringList getResamplerQualities() {
+            return AudioResampler::qualityNames();
+        }
+
+        // "video" paces the core on the display and stretches audio to match,
+        // "audio" paces it on the sound card and repeats or skips video frames
+        QStringList getSyncModes() {
+            return QStringList{ "video", "audio" };
+        }
+        quint64 recordingDroppedFrames() const {
+            return recorder.droppedFrames();
+        }
+
 
     private slots:
         void handleWindowChanged( QQuickWindow *win );
         void handleGeometryChanged( int unused ) {
             Q_UNUSED( unused );
-            refreshItemGeometry();
+            viewport_dirty = true;
         }
         void handleSceneGraphInitialized();
-        void updateFps() {
-            m_fps = fps_count * ( 1000.0 / fps_timer.interval() );
-            fps_count = 0;
-            emit fpsChanged( m_fps );
-        }
+        void handleSceneGraphInvalidated();
+        void handleScreenshotSaved( QString path, int purpose, QString game );
+        void updateFps();
 
 
     private:
         // Video
         // [1]
-        QSGTexture *texture;
+        QSGTexture *texture; // wraps frame_texture, or a placeholder until the first frame
+        QOpenGLTexture *frame_texture; // reused as long as the frame size and format stay the same
+        retro_pixel_format frame_texture_format;
         Core core;
-        int item_w;
-        int item_h;
-        qreal item_aspect; // item aspect ratio
-        QPoint viewportXY;
+        CoreOptionsModel core_options;
+
+        // Viewport, only recomputed when viewport_dirty is set or the core's resolution changes
+        bool viewport_dirty;
+        QRectF viewport_rect; // item coordinates
+        QSize viewport_pixel_size; // device pixels
+        QSize viewport_base_size; // core resolution it was computed for
+        qreal viewport_pixel_ratio;
         int fps_count;
         QTimer fps_timer;
         QElapsedTimer frame_timer;
         qint64 fps_deviation;
         int m_filtering;
         bool m_stretch_video;
+        bool m_integer_scaling;
         qreal m_aspect_ratio;
+        QString m_video_filter;
+        qreal m_video_filter_cost;
+        VideoFilterPipeline filter_pipeline; // only touched from the rendering thread
+        QString m_shader_preset;
+        QString loaded_shader_preset; // last preset initShader() tried, even if it failed
+        ShaderChain shader_chain; // rendering thread only
+        QSGTexture *shader_texture; // wraps the chain's output
         // [1]
 
         // Qml defined variables
@@ -185,27 +314,41 @@ class VideoItem : public QQuickItem {
         //[3]
         void updateAudioFormat();
         Audio audio;
+        QString m_resampler_quality;
+        QString m_audio_device;
+        qreal m_resampler_cost;
+        qreal logged_resampler_cost; // only logged again once it changed noticeably
+
+        // Audio master sync, rendering thread only except for m_sync_mode
+        QString m_sync_mode;
+        QElapsedTimer audio_sync_stall; // since the last frame audio asked for
+        void setAudioOverflowPolicy( AudioBuffer::OverflowPolicy policy );
+        qreal m_audio_buffer_fill;
+        qreal audio_fill_sum;
+        qreal audio_fill_min;
+        qreal audio_fill_max;
+        int audio_fill_samples;
+        int repeated_frames; // paints without a new frame
+        qreal logged_audio_fill; // only logged again once it changed noticeably
+        int audioFramesNeeded();
+        void sampleAudioFill();
         QThread audioThread;
-        QTimer audioTimer;
         //[3]
 
-        void refreshItemGeometry(); // called every time the item's with/height/x/y change
+        // Recording
+        Recorder recorder;
 
-        bool limitFps(); // return true if it's too soon to ask for another frame
+        // Only used with --input-latency
+        LatencyMonitor latency_monitor;
+        Screenshot screenshot;
 
-        static inline QImage::Format retroToQImageFormat( enum retro_pixel_format fmt ) {
-            static QImage::Format format_table[3] = {
-                QImage::Format_RGB16,   // RETRO_PIXEL_FORMAT_0RGB1555
-                QImage::Format_RGB32,   // RETRO_PIXEL_FORMAT_XRGB8888
-                QImage::Format_RGB16    // RETRO_PIXEL_FORMAT_RGB565
-            };
+        void refreshItemGeometry(); // computes the viewport, called from updatePaintNode() when it's dirty
+        void uploadFrame( const void *data, unsigned width, unsigned height, size_t pitch, retro_pixel_format format );
+        void scheduleTextureCleanup(); // GUI thread, hands the textures over to a render job
 
-            if( fmt >= 0 && fmt < ( sizeof( format_table ) / sizeof( QImage::Format ) ) ) {
-                return format_table[fmt];
-            }
+        bool limitFps(); // return true if it's too soon to ask for another frame
+        int framesToRun(); // how many frames to run before this paint, depends on the sync mode
 
-            return QImage::Format_Invalid;
-        }
 
 };
 
@@ -88,9 +88,13 @@ HEADERS += include/core.h                      \
            include/inputmanager.h              \
            include/inputdevice.h               \
            include/inputdevicemapping.h        \
+           include/analogresponse.h            \
+           include/latencymonitor.h            \
+           include/latencytestcore.h           \
            include/inputdeviceevent.h          \
            include/keyboard.h                  \
            include/keyboardevents.h            \
+           include/keyboardqueue.h             \
            include/librarydbmanager.h          \
            include/gamelibrarymodel.h          \
            include/phoenixlibrary.h            \
@@ -108,6 +112,16 @@ HEADERS += include/core.h                      \
            include/phoenixlibraryhelper.h      \
            include/utilities.h                 \
            include/usernotifications.h         \
+           include/recorder.h                  \
+           include/screenshot.h                \
+           include/videofilter.h               \
+           include/shaderchain.h               \
+           include/corelogger.h                \
+           include/corevariables.h             \
+           include/coreoptionsmodel.h          \
+           include/audiooutputdevice.h         \
+           include/audioresampler.h            \
+           include/audionullsink.h             \
 
 SOURCES += src/main.cpp                        \
            src/videoitem.cpp                   \
@@ -120,7 +134,11 @@ SOURCES += src/main.cpp                        \
            src/inputmanager.cpp                \
            src/inputdevice.cpp                 \
            src/inputdevicemapping.cpp          \
+           src/analogresponse.cpp              \
+           src/latencymonitor.cpp              \
+           src/latencytestcore.cpp             \
            src/keyboard.cpp                    \
+           src/keyboardqueue.cpp               \
            src/librarydbmanager.cpp            \
            src/gamelibrarymodel.cpp            \
            src/phoenixlibrary.cpp              \
@@ -135,8 +153,18 @@ SOURCES += src/main.cpp                        \
            src/phoenixglobals.cpp              \
            src/utilities.cpp                   \
            src/usernotifications.cpp           \
-
-RESOURCES = qml/qml.qrc assets/assets.qrc
+           src/recorder.cpp                    \
+           src/screenshot.cpp                  \
+           src/videofilter.cpp                 \
+           src/shaderchain.cpp                 \
+           src/corelogger.cpp                  \
+           src/corevariables.cpp               \
+           src/coreoptionsmodel.cpp            \
+           src/audiooutputdevice.cpp           \
+           src/audioresampler.cpp              \
+           src/audionullsink.cpp               \
+
+RESOURCES = qml/qml.qrc assets/assets.qrc shaders/shaders.qrc
 
 DISTFILES += \
     .astylerc
@@ -152,12 +152,93 @@ Item {
                 ComboBox {
                     anchors.right: parent.right;
                     implicitWidth: 100;
-                    model: gameView.video.getAudioDevices();
-                    onCurrentIndexChanged: {
-                        gameView.video.audioDevice = currentIndex;
+
+                    // The first entry follows the system's default device
+                    model: ["Default"].concat(gameView.video.getAudioDevices());
+                    currentIndex: Math.max(0, model.indexOf(root.audioDevice));
+                    onActivated: {
+                        root.audioDevice = index > 0 ? model[index] : "";
                     }
                 }
             }
+
+            RowLayout {
+                anchors {
+                    left: parent.left;
+                    right: parent.right;
+                }
+                spacing: 25;
+
+                Text {
+                    text: "Resampler"
+                    renderType: Text.QtRendering;
+                    color: settingsBubble.alternateTextColor;
+                    font {
+                        family: "Sans";
+                        pixelSize: 13;
+                    }
+                }
+
+                ComboBox {
+                    anchors.right: parent.right;
+                    implicitWidth: 100;
+                    model: gameView.video.getResamplerQualities();
+                    currentIndex: Math.max(0, model.indexOf(root.resamplerQuality));
+                    onActivated: {
+                        root.resamplerQuality = model[index];
+                    }
+                }
+            }
+
+            RowLayout {
+                anchors {
+                    left: parent.left;
+                    right: parent.right;
+                }
+                spacing: 25;
+
+                Text {
+                    text: "Sync To"
+                    renderType: Text.QtRendering;
+                    color: settingsBubble.alternateTextColor;
+                    font {
+                        family: "Sans";
+                        pixelSize: 13;
+                    }
+                }
+
+                ComboBox {
+                    anchors.right: parent.right;
+                    implicitWidth: 100;
+                    model: gameView.video.getSyncModes();
+                    currentIndex: Math.max(0, model.indexOf(root.syncMode));
+                    onActivated: {
+                        root.syncMode = model[index];
+                    }
+                }
+            }
+
+            Text {
+                visible: gameView.video.audioBufferFill > 0;
+                text: "Buffered: " + gameView.video.audioBufferFill.toFixed(1) + " ms";
+                renderType: Text.QtRendering;
+                color: settingsBubble.alternateTextColor;
+                font {
+                    family: "Sans";
+                    pixelSize: 11;
+                }
+            }
+
+            Text {
+                visible: gameView.video.resamplerCost > 0;
+                text: "Resampling: " + gameView.video.resamplerCost.toFixed(2) + " ms per second of audio";
+                renderType: Text.QtRendering;
+                color: settingsBubble.alternateTextColor;
+                font {
+                    family: "Sans";
+                    pixelSize: 11;
+                }
+            }
         }
     }
 }
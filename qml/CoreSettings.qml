@@ -122,6 +122,7 @@ Item {
                 }
 
                 PhoenixNormalButton {
+                    id: informationButton;
                     z: preferredButton.z - 1;
                     text: "Information";
                     implicitWidth: 70;
@@ -136,6 +137,25 @@ Item {
                         leftMargin: -1;
                     }
                 }
+
+                PhoenixNormalButton {
+                    z: preferredButton.z - 1;
+                    text: "Options";
+                    implicitWidth: 70;
+                    exclusiveGroup: topButtonGroup;
+                    checkable: true;
+                    onClicked: {
+                        if (coreSettingsStack.currentItem.stackName !== "coreOptions") {
+                            settingsWindow.height = 550;
+                            settingsWindow.width = 350;
+                            coreSettingsStack.push({item: coreOptions, replace: true, immediate: true})
+                        }
+                    }
+                    anchors {
+                        left: informationButton.right;
+                        leftMargin: -1;
+                    }
+                }
             }
         }
     }
@@ -204,6 +224,83 @@ Item {
         }
     }
 
+    Component {
+        id: coreOptions;
+        Item {
+            property string stackName: "coreOptions";
+
+            // Options of the running core, changes apply on the next frame
+            PhoenixScrollView {
+                frameColor: "#000000FF";
+                borderEnabled: false;
+                handleHeight: 10;
+                anchors {
+                    fill: parent;
+                    topMargin: 15;
+                    leftMargin: 15;
+                    bottomMargin: 45;
+                }
+                ListView {
+                    spacing: 5;
+                    model: gameView.video.coreOptions;
+                    delegate: RowLayout {
+                        id: optionRow;
+                        property int row: index;
+                        anchors {
+                            left: parent.left;
+                            right: parent.right;
+                            rightMargin: 25;
+                        }
+
+                        spacing: 25;
+                        Text {
+                            Layout.fillWidth: true;
+                            text: description;
+                            renderType: Text.QtRendering;
+                            color: "#f1f1f1";
+                            elide: Text.ElideRight;
+                            font {
+                                family: "Sans";
+                                pixelSize: 12;
+                            }
+                        }
+
+                        PhoenixComboBox {
+                            implicitHeight: 25;
+                            model: choices;
+                            currentIndex: valueIndex;
+                            onActivated: gameView.video.coreOptions.setValue(optionRow.row, choices[index]);
+                        }
+                    }
+                }
+            }
+
+            Text {
+                visible: gameView.video.coreOptions.count === 0;
+                anchors.centerIn: parent;
+                text: "No options, start a game first";
+                renderType: Text.QtRendering;
+                color: settingsBubble.alternateTextColor;
+                font {
+                    family: "Sans";
+                    pixelSize: 12;
+                }
+            }
+
+            PhoenixNormalButton {
+                text: "Save for core";
+                enabled: gameView.video.coreOptions.count > 0;
+                anchors {
+                    bottom: parent.bottom;
+                    right: parent.right;
+                    bottomMargin: 10;
+                    rightMargin: 15;
+                }
+                onClicked: gameView.video.coreOptions.saveAsCoreDefaults();
+            }
+        }
+    }
+
     Component {
         id: coreInformation;
 
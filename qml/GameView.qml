@@ -124,13 +124,9 @@ Rectangle {
 
 
         focus: true;
-        anchors {
-           centerIn: parent;
-        }
 
-
-        height: parent.height;
-        width: stretchVideo ? parent.width : height * aspectRatio;
+        // The video keeps its aspect ratio inside of the item, see VideoItem::refreshItemGeometry()
+        anchors.fill: parent;
 
         systemDirectory: phoenixGlobals.biosPath();
         libcore: gameView.coreName;
@@ -139,6 +135,12 @@ Rectangle {
         volume: root.volumeLevel;
         filtering: root.filtering;
         stretchVideo: root.stretchVideo;
+        integerScaling: root.integerScaling;
+        videoFilter: root.videoFilter;
+        shaderPreset: root.shaderPreset;
+        resamplerQuality: root.resamplerQuality;
+        syncMode: root.syncMode;
+        audioDevice: root.audioDevice;
 
         //property real ratio: width / height;
 
@@ -150,6 +152,8 @@ Rectangle {
         }
 
 
+        onScreenshotSaved: phoenixLibrary.model().setFallbackArtwork(game, artwork);
+
         onSetWindowedChanged: {
             if (root.visibility == Window.FullScreen)
                 root.swapScreenSize();
@@ -186,6 +186,91 @@ Item {
                     }
                 }
             }
+
+            RowLayout {
+                anchors {
+                    left: parent.left;
+                    right: parent.right;
+                }
+
+                spacing: 25;
+                Text {
+                    text: "Integer Scaling"
+                    renderType: Text.QtRendering;
+                    color: settingsBubble.alternateTextColor;
+                    font {
+                        family: "Sans";
+                        pixelSize: 14;
+                    }
+                }
+
+                PhoenixSwitch {
+                    id: integerScalingSwitch;
+                    anchors.right: parent.right;
+                    checked: root.integerScaling;
+                    onCheckedChanged: {
+                        root.integerScaling = checked;
+                    }
+                }
+            }
+
+            RowLayout {
+                anchors {
+                    left: parent.left;
+                    right: parent.right;
+                }
+
+                spacing: 25;
+                Text {
+                    text: "CPU Filter"
+                    renderType: Text.QtRendering;
+                    color: settingsBubble.alternateTextColor;
+                    font {
+                        family: "Sans";
+                        pixelSize: 14;
+                    }
+                }
+
+                ComboBox {
+                    id: videoFilterBox;
+                    anchors.right: parent.right;
+                    implicitWidth: 100;
+                    model: gameView.video.getVideoFilters();
+                    currentIndex: Math.max(0, model.indexOf(root.videoFilter));
+                    onActivated: {
+                        root.videoFilter = model[index];
+                    }
+                }
+            }
+
+            RowLayout {
+                anchors {
+                    left: parent.left;
+                    right: parent.right;
+                }
+
+                spacing: 25;
+                Text {
+                    text: "Shader"
+                    renderType: Text.QtRendering;
+                    color: settingsBubble.alternateTextColor;
+                    font {
+                        family: "Sans";
+                        pixelSize: 14;
+                    }
+                }
+
+                ComboBox {
+                    id: shaderPresetBox;
+                    anchors.right: parent.right;
+                    implicitWidth: 100;
+                    model: gameView.video.getShaderPresets();
+                    currentIndex: Math.max(0, model.indexOf(root.shaderPreset));
+                    onActivated: {
+                        root.shaderPreset = model[index];
+                    }
+                }
+            }
         }
     }
 }
@@ -37,6 +37,12 @@ PhoenixWindow {
     property bool screenTimer: false;
     property int filtering: 2;
     property bool stretchVideo: false;
+    property bool integerScaling: false;
+    property string videoFilter: "none";
+    property string shaderPreset: "none";
+    property string resamplerQuality: "sinc-medium";
+    property string syncMode: "video";
+    property string audioDevice: "";
     property string itemInView: "grid";
     property string lastGameName: "Phoenix";
     property string lastSystemName: "";
@@ -534,6 +540,12 @@ PhoenixWindow {
         property alias volumeLevel: root.volumeLevel;
         property alias smooth: root.filtering;
         property alias stretchVideo: root.stretchVideo;
+        property alias integerScaling: root.integerScaling;
+        property alias videoFilter: root.videoFilter;
+        property alias shaderPreset: root.shaderPreset;
+        property alias resamplerQuality: root.resamplerQuality;
+        property alias syncMode: root.syncMode;
+        property alias audioDevice: root.audioDevice;
     }
 
     HeaderBar {
@@ -742,6 +754,13 @@ PhoenixWindow {
 
         initialItem: homeScreen;
 
+        Component.onCompleted: {
+            // The built-in core has no game, the name only shows up in the logs
+            var testCore = phoenixGlobals.latencyTestCore();
+            if (testCore !== "")
+                push({item: gameView, properties: {coreName: testCore, gameName: "latency-test", isRunning: true}});
+        }
+
         property string gameStackItemName: {
             if (currentItem != null && typeof currentItem.stackName !== "undefined") {
                 return currentItem.stackName;
@@ -0,0 +1,26 @@
+// Gaussian scanlines whose width follows brightness, plus an RGB aperture mask.
+// Expects a linear filtered Source, only the horizontal direction gets blurred.
+varying vec2 vTexCoord;
+
+uniform sampler2D Source;
+uniform vec4 SourceSize;
+
+const vec3 luma = vec3( 0.299, 0.587, 0.114 );
+
+void main() {
+    float line = vTexCoord.y * SourceSize.y;
+    float center = floor( line ) + 0.5;
+
+    // Sample on the middle of the source line, so the filter only blends horizontally
+    vec3 color = texture2D( Source, vec2( vTexCoord.x, center * SourceSize.w ) ).rgb;
+    color = pow( color, vec3( 2.4 ) );
+
+    float dist = line - center;
+    float width = mix( 0.3, 0.5, dot( color, luma ) );
+    color *= exp( -( dist * dist ) / ( 0.5 * width * width ) ) * 1.3;
+
+    float slot = mod( floor( gl_FragCoord.x ), 3.0 );
+    vec3 mask = slot < 1.0 ? vec3( 1.0, 0.8, 0.8 ) : ( slot < 2.0 ? vec3( 0.8, 1.0, 0.8 ) : vec3( 0.8, 0.8, 1.0 ) );
+
+    gl_FragColor = vec4( pow( color * mask, vec3( 1.0 / 2.2 ) ), 1.0 );
+}
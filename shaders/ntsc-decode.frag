@@ -0,0 +1,28 @@
+// Second half of the composite video emulation.
+// Separates luma and chroma from the encoded signal with box filters over whole carrier periods,
+// which leaves the color fringing real TVs had. Expects a nearest filtered Source.
+varying vec2 vTexCoord;
+
+uniform sampler2D Source;
+uniform vec4 SourceSize;
+uniform int FrameCount;
+
+const float PI = 3.14159265;
+const mat3 yiq_to_rgb = mat3( 1.0, 1.0, 1.0,
+                              0.956, -0.272, -1.106,
+                              0.621, -0.647, 1.703 );
+
+void main() {
+    vec2 pixel = floor( vTexCoord * SourceSize.xy );
+    vec3 yiq = vec3( 0.0 );
+
+    for( int i = -4; i < 4; i++ ) {
+        float x = pixel.x + float( i );
+        float signal = texture2D( Source, vec2( ( x + 0.5 ) * SourceSize.z, vTexCoord.y ) ).r * 2.2 - 0.6;
+        float phase = ( x + pixel.y * 2.0 + float( FrameCount ) ) * PI * 0.5;
+
+        yiq += vec3( signal, signal * cos( phase ) * 2.0, signal * sin( phase ) * 2.0 );
+    }
+
+    gl_FragColor = vec4( clamp( yiq_to_rgb * ( yiq / 8.0 ), 0.0, 1.0 ), 1.0 );
+}
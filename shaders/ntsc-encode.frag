@@ -0,0 +1,24 @@
+// First half of the composite video emulation.
+// Modulates chroma onto a carrier at 4 samples per source pixel, stored into the red channel.
+// Runs at 4x the source width, with a nearest filtered Source.
+varying vec2 vTexCoord;
+
+uniform sampler2D Source;
+uniform vec4 OutputSize;
+uniform int FrameCount;
+
+const float PI = 3.14159265;
+const mat3 rgb_to_yiq = mat3( 0.299, 0.596, 0.211,
+                              0.587, -0.274, -0.523,
+                              0.114, -0.322, 0.312 );
+
+void main() {
+    vec3 yiq = rgb_to_yiq * texture2D( Source, vTexCoord ).rgb;
+
+    vec2 pixel = floor( vTexCoord * OutputSize.xy );
+    float phase = ( pixel.x + pixel.y * 2.0 + float( FrameCount ) ) * PI * 0.5;
+    float signal = yiq.x + yiq.y * cos( phase ) + yiq.z * sin( phase );
+
+    // Composite signal ranges over [-0.6, 1.6], squeeze it into the 8 bit target
+    gl_FragColor = vec4( ( signal + 0.6 ) / 2.2, 0.0, 0.0, 1.0 );
+}
@@ -0,0 +1,19 @@
+// Nearest neighbour up to the largest integer scale, bilinear for the remainder.
+// Keeps pixels sharp at any output size without uneven pixel widths.
+// Expects a linear filtered Source.
+varying vec2 vTexCoord;
+
+uniform sampler2D Source;
+uniform vec4 SourceSize;
+uniform vec4 OutputSize;
+
+void main() {
+    vec2 texel = vTexCoord * SourceSize.xy;
+    vec2 scale = max( floor( OutputSize.xy * SourceSize.zw ), vec2( 1.0 ) );
+
+    vec2 region_range = 0.5 - 0.5 / scale;
+    vec2 center_dist = fract( texel ) - 0.5;
+    vec2 f = ( center_dist - clamp( center_dist, -region_range, region_range ) ) * scale + 0.5;
+
+    gl_FragColor = vec4( texture2D( Source, ( floor( texel ) + f ) * SourceSize.zw ).rgb, 1.0 );
+}
@@ -0,0 +1,8 @@
+// Plain copy, lets the pass' filtering do the scaling
+varying vec2 vTexCoord;
+
+uniform sampler2D Source;
+
+void main() {
+    gl_FragColor = vec4( texture2D( Source, vTexCoord ).rgb, 1.0 );
+}
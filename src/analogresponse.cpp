@@ -0,0 +1,25 @@
+#include "analogresponse.h"
+
+AnalogResponse::AnalogResponse() {
+    setResponse( 0.15, 1.0, 1.0 );
+}
+
+void AnalogResponse::setResponse( double deadzone, double curve, double sensitivity ) {
+    deadzone = qBound( 0.0, deadzone, 0.95 );
+    curve = qBound( 0.1, curve, 10.0 );
+    sensitivity = qMax( 0.0, sensitivity );
+
+    for( int i = 0; i < lut_size; i++ ) {
+        // Middle of the bucket, every magnitude in it gets the same gain
+        double magnitude = ( i + 0.5 ) * ( 1 << lut_shift );
+        double travel = ( magnitude / 32767.0 - deadzone ) / ( 1.0 - deadzone );
+
+        if( travel <= 0.0 ) {
+            gains[i] = 0.0f;
+            continue;
+        }
+
+        double output = qMin( 1.0, sensitivity * std::pow( qMin( travel, 1.0 ), curve ) );
+        gains[i] = float( output * 32767.0 / magnitude );
+    }
+}
@@ -1,40 +1,38 @@
 
+#include <QSettings>
+
 #include "audio.h"
 
 Audio::Audio( QObject *parent )
     : QObject( parent ),
       isCoreRunning( false ),
+      volume( 1.0 ),
+      devicePollTimer( new QTimer( this ) ),
+      resetPending( false ),
+      savedUnderruns( 0 ),
       audioOut( nullptr ),
-      audioOutIODev( nullptr ),
-      audioBuf( new AudioBuffer ) {
+      outputRunning( false ),
+      audioBuf( new AudioBuffer ),
+      audioOutIODev( new AudioOutputDevice( audioBuf.get(), this ) ),
+      nullSink( new AudioNullSink( audioOutIODev, audioBuf.get(), this ) ) {
 
     Q_CHECK_PTR( audioBuf );
 
-    resamplerState = nullptr;
-
     // We need to send this signal to ourselves
     connect( this, &Audio::signalFormatChanged, this, &Audio::slotHandleFormatChanged );
+    connect( audioOutIODev, &AudioOutputDevice::latencyChanged, this, &Audio::slotLatencyChanged );
 
-    outputDataFloat = nullptr;
-    outputDataShort = nullptr;
+    devicePollTimer->setInterval( 2000 );
+    connect( devicePollTimer, &QTimer::timeout, this, &Audio::slotPollDevices );
 }
 
 Audio::~Audio() {
+    // Finishes the WAV file
+    nullSink->stop();
+
     if( audioOut ) {
         delete audioOut;
     }
-
-    if( audioOutIODev ) {
-        delete audioOutIODev;
-    }
-
-    if( outputDataFloat ) {
-        delete outputDataFloat;
-    }
-
-    if( outputDataShort ) {
-        delete outputDataShort;
-    }
 }
 
 AudioBuffer *Audio::getAudioBuf() const {
@@ -45,180 +43,245 @@ void Audio::setInFormat( QAudioFormat newInFormat ) {
 
     qCDebug( phxAudio, "setInFormat(%iHz %ibits)", newInFormat.sampleRate(), newInFormat.sampleSize() );
 
-    QAudioDeviceInfo info( QAudioDeviceInfo::defaultOutputDevice() );
-
     audioFormatIn = newInFormat;
-    audioFormatOut = info.nearestFormat( newInFormat ); // try using the nearest supported format
+    qCDebug( phxAudio ) << "audioFormatIn" << audioFormatIn;
+
+    emit signalFormatChanged();
+
+}
+
+QAudioDeviceInfo Audio::findDevice() const {
+    if( !requestedDeviceName.isEmpty() ) {
+        foreach( const QAudioDeviceInfo &info, QAudioDeviceInfo::availableDevices( QAudio::AudioOutput ) ) {
+            if( info.deviceName() == requestedDeviceName ) {
+                return info;
+            }
+        }
+    }
 
-    if( audioFormatOut.sampleRate() < audioFormatIn.sampleRate() ) {
+    return QAudioDeviceInfo::defaultOutputDevice();
+}
+
+QAudioFormat Audio::chooseOutFormat( const QAudioDeviceInfo &info ) const {
+    QAudioFormat format = info.nearestFormat( audioFormatIn ); // try using the nearest supported format
+
+    if( format.sampleRate() < audioFormatIn.sampleRate() ) {
         // If that got us a format with a worse sample rate, use preferred format
-        audioFormatOut = info.preferredFormat();
+        format = info.preferredFormat();
     }
 
-    sampleRateRatio = ( double )audioFormatOut.sampleRate()  / audioFormatIn.sampleRate();
+    // The resampler works in floats, if the sound card takes them too there's nothing to convert back
+    QAudioFormat floatFormat = format;
+    floatFormat.setSampleType( QAudioFormat::Float );
+    floatFormat.setSampleSize( 32 );
 
-    qCDebug( phxAudio ) << "audioFormatIn" << audioFormatIn;
-    qCDebug( phxAudio ) << "audioFormatOut" << audioFormatOut;
-    qCDebug( phxAudio ) << "sampleRateRatio" << sampleRateRatio;
-    qCDebug( phxAudio, "Using nearest format supported by sound card: %iHz %ibits",
-             audioFormatOut.sampleRate(), audioFormatOut.sampleSize() );
+    if( info.isFormatSupported( floatFormat ) ) {
+        format = floatFormat;
+    }
 
-    emit signalFormatChanged();
+    return format;
+}
 
+static QString deviceSettingsGroup( QString deviceName ) {
+    // Slashes would be taken for subgroups
+    return "audio_devices/" + QString( deviceName ).replace( '/', '_' ).replace( '\\', '_' );
 }
 
-void Audio::slotHandleFormatChanged() {
+void Audio::loadDeviceSettings() {
+    QSettings s;
+    s.beginGroup( deviceSettingsGroup( audioDeviceName ) );
+    audioOutIODev->setLatency( s.value( "latency", audioOutIODev->latency() ).toLongLong() );
+    savedUnderruns = s.value( "underruns", 0 ).toULongLong();
+    s.endGroup();
+
+    qCDebug( phxAudio ) << "Device" << audioDeviceName << "latency" << audioOutIODev->latency() / 1000.0 << "ms,"
+                        << savedUnderruns << "underruns so far";
+}
+
+void Audio::saveDeviceSettings() {
+    if( audioDeviceName.isEmpty() ) {
+        return;
+    }
+
+    QSettings s;
+    s.beginGroup( deviceSettingsGroup( audioDeviceName ) );
+    s.setValue( "latency", audioOutIODev->latency() );
+    s.setValue( "underruns", savedUnderruns + audioOutIODev->underruns() );
+    s.endGroup();
+}
+
+void Audio::slotLatencyChanged( qint64 usecs, quint64 underruns ) {
+    Q_UNUSED( usecs );
+    Q_UNUSED( underruns );
+    saveDeviceSettings();
+}
+
+void Audio::startOutput( const QAudioDeviceInfo &info, bool resetState ) {
+    resetState = resetState || resetPending;
+
     if( audioOut ) {
+        // Counts restart with the new output
+        saveDeviceSettings();
+        outputRunning = false;
         audioOut->stop();
         delete audioOut;
+        audioOut = nullptr;
+    }
+
+    audioDeviceName = info.deviceName();
+
+    // Keep checking for the requested device while we're stuck with another one
+    if( audioDeviceName != requestedDeviceName && !requestedDeviceName.isEmpty() ) {
+        devicePollTimer->start();
+    } else {
+        devicePollTimer->stop();
     }
 
-    audioOut = new QAudioOutput( audioFormatOut );
+    if( info.isNull() ) {
+        qCWarning( phxAudio ) << "No audio output device found";
+        devicePollTimer->start();
+        resetPending = resetState;
+        return;
+    }
+
+    audioFormatOut = chooseOutFormat( info );
+    qCDebug( phxAudio ) << "Output device" << audioDeviceName;
+    qCDebug( phxAudio ) << "audioFormatOut" << audioFormatOut;
+
+    loadDeviceSettings();
+
+    audioOut = new QAudioOutput( info, audioFormatOut );
     Q_CHECK_PTR( audioOut );
-    //audioOut->moveToThread( &audioThread );
 
     connect( audioOut, &QAudioOutput::stateChanged, this, &Audio::slotStateChanged );
-    audioOutIODev = audioOut->start();
+    audioOut->setVolume( volume );
+
+    // The sound card pulls data as it needs it, the buffer only has to cover a few periods
+    qint64 bufferSize = audioFormatOut.bytesForDuration( outputBufferDuration );
+    audioOut->setBufferSize( bufferSize );
+
+    audioOutIODev->close();
+
+    if( resetState ) {
+        audioOutIODev->setFormats( audioFormatIn, audioFormatOut, bufferSize );
+        resetPending = false;
+    } else {
+        audioOutIODev->setOutputFormat( audioFormatOut, bufferSize );
+    }
+
+    audioOutIODev->open( QIODevice::ReadOnly );
+    audioOut->start( audioOutIODev );
+    outputRunning = true;
 
     if( !isCoreRunning ) {
         audioOut->suspend();
     }
 
-    //audioOutIODev->moveToThread( &audioThread );
+    qCDebug( phxAudio ) << "Period size" << audioOut->periodSize() << "bytes, buffer size" << audioOut->bufferSize() << "bytes";
+}
 
-    // This is where the amount of time that passes between audio updates is set
-    // At timer intervals this low on most OSes the jitter is quite significant
-    // Try to grab data from the input buffer at least every frame
-    // qint64 durationInMs = audioFormatOut.durationForBytes( audioOut->periodSize() * 1.0 ) / 1000;
-    qint64 durationInMs = 16;
-    qCDebug( phxAudio ) << "Timer interval set to" << durationInMs << "ms, Period size" << audioOut->periodSize() << "bytes, buffer size" << audioOut->bufferSize() << "bytes";
+void Audio::startNullOutput() {
+    audioFormatOut = audioFormatIn;
+    audioFormatOut.setSampleRate( nullOutputRate );
+    audioFormatOut.setSampleType( QAudioFormat::SignedInt );
+    audioFormatOut.setSampleSize( 16 );
+    audioDeviceName.clear();
 
+    // A fixed ratio, so the output only depends on what the core produced
+    audioOutIODev->setDrcEnabled( false );
 
-    if( resamplerState ) {
-        src_delete( resamplerState );
-    }
+    audioOutIODev->close();
+    audioOutIODev->setFormats( audioFormatIn, audioFormatOut, audioFormatOut.bytesForDuration( outputBufferDuration ) );
+    resetPending = false;
+    audioOutIODev->open( QIODevice::ReadOnly );
 
-    int errorCode;
-    resamplerState = src_new( SRC_SINC_BEST_QUALITY, 2, &errorCode );
+    nullSink->start( nullOutputTarget, audioFormatIn, audioFormatOut );
+    outputRunning = true;
+}
 
-    if( !resamplerState ) {
-        qCWarning( phxAudio ) << "libresample could not init: " << src_strerror( errorCode ) ;
+void Audio::slotHandleFormatChanged() {
+    if( !nullOutputTarget.isEmpty() ) {
+        startNullOutput();
+        return;
     }
 
-    // Now that the IO devices are properly set up,
-    // allocate space for buffers that'll hold up to their hardware couterpart's size in data
-    auto outputDataSamples = audioOut->bufferSize() * 2;
-    qCDebug( phxAudio ) << "Allocated" << outputDataSamples << "for conversion.";
+    startOutput( findDevice(), true );
+}
 
-    if( outputDataFloat ) {
-        delete outputDataFloat;
-    }
+void Audio::slotSetNullOutput( QString target ) {
+    nullOutputTarget = target;
+    devicePollTimer->stop();
 
-    if( outputDataShort ) {
-        delete outputDataShort;
+    if( audioOut ) {
+        outputRunning = false;
+        audioOut->stop();
+        delete audioOut;
+        audioOut = nullptr;
     }
 
-    outputDataFloat = new float[outputDataSamples];
-    outputDataShort = new short[outputDataSamples];
+    if( audioFormatIn.isValid() ) {
+        startNullOutput();
+    }
 }
 
-void Audio::slotThreadStarted() {
-    if( !audioFormatIn.isValid() ) {
-        // We don't have a valid audio format yet...
-        qCDebug( phxAudio ) << "audioFormatIn is not valid";
+void Audio::slotSetDevice( QString deviceName ) {
+    requestedDeviceName = deviceName;
+
+    // Nothing to switch until the core gave us its format
+    if( !audioFormatIn.isValid() || !nullOutputTarget.isEmpty() ) {
         return;
     }
 
-    slotHandleFormatChanged();
+    slotSwitchDevice();
 }
 
-void Audio::slotHandlePeriodTimer() {
+void Audio::slotSwitchDevice() {
+    QAudioDeviceInfo info = findDevice();
 
-    // Handle the situation where there is no device to output to
-    if( !audioOutIODev ) {
-        qCDebug( phxAudio ) << "Audio device was not found, attempting reset...";
-        emit signalFormatChanged();
+    if( audioOut && info.deviceName() == audioDeviceName && audioOut->state() != QAudio::StoppedState ) {
         return;
     }
 
-    // Handle the situation where there is an error opening the audio device
-    if( audioOut->error() == QAudio::OpenError ) {
-        qWarning( phxAudio ) << "QAudio::OpenError, attempting reset...";
-        emit signalFormatChanged();
-    }
-
-    auto samplesPerFrame = 2;
-
-    // Max number of bytes/frames we can write to the output
-    auto outputBytesFree = audioOut->bytesFree();
-    auto outputFramesFree = audioFormatOut.framesForBytes( outputBytesFree );
-    // auto outputSamplesFree = outputFramesFree * samplesPerFrame;
+    qCDebug( phxAudio ) << "Switching output to" << info.deviceName();
+    startOutput( info, false );
+}
 
-    // If output buffer is somehow full despite DRC, empty it
-    if( !outputBytesFree ) {
-        qWarning( phxAudio ) << "Output buffer full, resetting...";
-        emit signalFormatChanged();
+void Audio::slotPollDevices() {
+    if( !audioFormatIn.isValid() || !nullOutputTarget.isEmpty() ) {
         return;
     }
 
-    // Compute the exact number of bytes to read from the circular buffer to
-    // produce outputBytesFree bytes of output; Taking resampling and DRC into account
-    double maxDeviation = 0.005;
-    auto outputBufferTargetPoint = audioOut->bufferSize() / 2;
-    auto distanceFromTarget = outputBufferTargetPoint - ( audioOut->bufferSize() - outputBytesFree );
-    double direction = ( double )distanceFromTarget / outputBufferTargetPoint;
-    double adjust = 1.0 + maxDeviation * direction;
-    double adjustedSampleRateRatio = sampleRateRatio * adjust;
-    auto audioFormatTemp = audioFormatIn;
-    audioFormatTemp.setSampleRate( audioFormatOut.sampleRate() * adjustedSampleRateRatio );
-    auto inputBytesToRead = audioFormatTemp.bytesForDuration( audioFormatOut.durationForBytes( distanceFromTarget < 0 ? 0 : distanceFromTarget ) );
-
-    // Read the input data
-    auto inputBytesRead = audioBuf->read( inputDataChar, inputBytesToRead );
-    auto inputFramesRead = audioFormatIn.framesForBytes( inputBytesRead );
-    auto inputSamplesRead = inputFramesRead * samplesPerFrame;
-
-    // libsamplerate works in floats, must convert to floats for processing
-    src_short_to_float_array( ( short * )inputDataChar, inputDataFloat, inputSamplesRead );
-
-    // Set up a struct containing parameters for the resampler
-    SRC_DATA srcData;
-    srcData.data_in = inputDataFloat;
-    srcData.data_out = outputDataFloat;
-    srcData.end_of_input = 0;
-    srcData.input_frames = inputFramesRead;
-    srcData.output_frames = outputFramesFree; // Max size
-    srcData.src_ratio = adjustedSampleRateRatio;
-
-    // Perform resample
-    src_set_ratio( resamplerState, adjustedSampleRateRatio );
-    auto errorCode = src_process( resamplerState, &srcData );
-
-    if( errorCode ) {
-        qCWarning( phxAudio ) << "libresample error: " << src_strerror( errorCode ) ;
+    QAudioDeviceInfo info = findDevice();
+
+    if( !audioOut || info.deviceName() != audioDeviceName ) {
+        slotSwitchDevice();
     }
+}
 
-    auto outputFramesConverted = srcData.output_frames_gen;
-    auto outputBytesConverted = audioFormatOut.bytesForFrames( outputFramesConverted );
-    auto outputSamplesConverted = outputFramesConverted * samplesPerFrame;
+void Audio::slotSetResamplerQuality( QString quality ) {
+    AudioResampler::Quality resampler_quality;
 
-    // Convert float data back to shorts
-    src_float_to_short_array( outputDataFloat, outputDataShort, outputSamplesConverted );
+    if( !AudioResampler::qualityFromName( quality, &resampler_quality ) ) {
+        qCWarning( phxAudio ) << "Unknown resampler quality" << quality;
+        return;
+    }
 
-    int outputBytesWritten = audioOutIODev->write( ( char * ) outputDataShort, outputBytesConverted );
-    Q_UNUSED( outputBytesWritten );
+    audioOutIODev->setResamplerQuality( resampler_quality );
+}
 
-    /*
-    qCDebug( phxAudio ) << "Input is" << ( audioBuf->size() * 100 / audioFormatIn.bytesForFrames( 4096 ) ) << "% full, output is"
-                        << ( ( ( double )( audioOut->bufferSize() - outputBytesFree ) / audioOut->bufferSize() ) * 100 )  << "% full ; DRC:" << adjust
-                        << ";" << inputBytesToRead << audioFormatIn.bytesForDuration( audioFormatOut.durationForBytes( outputBytesFree ) ) << sampleRateRatio << adjustedSampleRateRatio;
-    qCDebug( phxAudio ) << "\tInput: needed" << inputBytesToRead << "bytes, read" << inputBytesRead << "bytes";
-    qCDebug( phxAudio ) << "\tOutput: needed" << distanceFromTarget << "bytes, wrote" << outputBytesWritten << "bytes";
-    qCDebug( phxAudio ) << "\toutputBytesFree =" << outputBytesFree << "outputBufferTargetPoint =" << outputBufferTargetPoint << "distanceFromTarget =" << distanceFromTarget;
-    qCDebug( phxAudio ) << "Input: needed" << audioFormatIn.framesForBytes( inputBytesToRead ) << "frames, read" << audioFormatIn.framesForBytes( inputBytesRead ) << "frames";
-    qCDebug( phxAudio ) << "Output: needed" << audioFormatOut.framesForBytes( outputBytesToWrite ) << "frames, wrote" << audioFormatOut.framesForBytes( outputBytesWritten ) << "frames";
-    */
+void Audio::slotSetAudioMaster( bool audioMaster ) {
+    qCDebug( phxAudio ) << "Sync to" << ( audioMaster ? "audio" : "video" );
+    audioOutIODev->setDrcEnabled( !audioMaster && nullOutputTarget.isEmpty() );
+}
 
+void Audio::slotThreadStarted() {
+    if( !audioFormatIn.isValid() ) {
+        // We don't have a valid audio format yet...
+        qCDebug( phxAudio ) << "audioFormatIn is not valid";
+        return;
+    }
+
+    slotHandleFormatChanged();
 }
 
 void Audio::slotRunChanged( bool _isCoreRunning ) {
@@ -232,21 +295,28 @@ void Audio::slotRunChanged( bool _isCoreRunning ) {
         if( audioOut->state() != QAudio::SuspendedState ) {
             qCDebug( phxAudio ) << "Paused";
             audioOut->suspend();
-            emit signalStopTimer();
+            saveDeviceSettings();
         }
     } else {
         if( audioOut->state() != QAudio::ActiveState ) {
             qCDebug( phxAudio ) << "Started";
+
+            // Whatever piled up while paused would only add latency, start over from silence
+            audioBuf->clear();
+            audioOutIODev->refill();
             audioOut->resume();
-            emit signalStartTimer();
         }
     }
 }
 
 void Audio::slotStateChanged( QAudio::State s ) {
-    if( s == QAudio::IdleState && audioOut->error() == QAudio::UnderrunError ) {
-        qWarning( phxAudio ) << "audioOut underrun";
-        audioOutIODev = audioOut->start();
+    // The output device never runs dry, anything else is a real error, usually the device being unplugged
+    if( s == QAudio::StoppedState && audioOut->error() != QAudio::NoError ) {
+        qCWarning( phxAudio ) << "Audio output stopped:" << audioOut->error() << ", switching devices";
+        outputRunning = false;
+
+        // Not from inside of audioOut's own signal, it gets deleted
+        QTimer::singleShot( 500, this, SLOT( slotSwitchDevice() ) );
     }
 
     if( s != QAudio::IdleState && s != QAudio::ActiveState ) {
@@ -255,9 +325,9 @@ void Audio::slotStateChanged( QAudio::State s ) {
 }
 
 void Audio::slotSetVolume( qreal level ) {
+    volume = level;
+
     if( audioOut ) {
         audioOut->setVolume( level );
     }
 }
-
-
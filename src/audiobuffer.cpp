@@ -1,11 +1,30 @@
 
+#include <QThread>
+#include <QElapsedTimer>
+
+#include <cstring>
+
 #include <audiobuffer.h>
 
 
-AudioBuffer::AudioBuffer( size_t size )
+static size_t roundUpToPowerOfTwo( size_t size ) {
+    size_t power = 1;
+
+    while( power < size ) {
+        power <<= 1;
+    }
+
+    return power;
+}
+
+AudioBuffer::AudioBuffer( size_t size, OverflowPolicy policy )
     : m_head( 0 ),
       m_tail( 0 ),
-      m_size( size ) {
+      m_size( roundUpToPowerOfTwo( size ) ),
+      m_mask( m_size - 1 ),
+      m_policy( policy ),
+      m_overflows( 0 ),
+      m_dropped_bytes( 0 ) {
     m_buffer = new char[m_size];
 }
 
@@ -13,64 +32,123 @@ AudioBuffer::~AudioBuffer() {
     delete [] m_buffer;
 }
 
+void AudioBuffer::copyIn( size_t position, const char *data, size_t size ) {
+    size_t offset = position & m_mask;
+    size_t first = qMin( size, m_size - offset );
+
+    memcpy( m_buffer + offset, data, first );
+    memcpy( m_buffer, data + first, size - first );
+}
+
+void AudioBuffer::copyOut( size_t position, char *data, size_t size ) const {
+    size_t offset = position & m_mask;
+    size_t first = qMin( size, m_size - offset );
+
+    memcpy( data, m_buffer + offset, first );
+    memcpy( data + first, m_buffer, size - first );
+}
+
 size_t AudioBuffer::write( const char *data, size_t size ) {
-    size_t wrote = 0;
-    size_t head, tail, nextHead;
-
-    while( wrote < size ) {
-        head = m_head.load( std::memory_order_relaxed );
-        nextHead = next( head );
-        tail = m_tail.load( std::memory_order_acquire );
-
-        if( nextHead == tail ) {
-            // buffer is full. let's just clear it.
-            // It probably means the core produces frames too fast (not
-            // clocked right) or audio backend stopped reading frames.
-            // In the first case, it might cause audio to skip a bit.
-            qCDebug( phxAudio, "Buffer full, dropping samples" );
-            clear();
+    size_t head = m_head.load( std::memory_order_relaxed );
+    size_t tail = m_tail.load( std::memory_order_acquire );
+    size_t free = m_size - ( head - tail );
+
+    if( size > free ) {
+        m_overflows.fetch_add( 1, std::memory_order_relaxed );
+
+        switch( m_policy.load( std::memory_order_relaxed ) ) {
+            case DropOldest: {
+                // Anything larger than the whole buffer only keeps its end
+                if( size > m_size ) {
+                    m_dropped_bytes.fetch_add( size - m_size, std::memory_order_relaxed );
+                    data += size - m_size;
+                    size = m_size;
+                }
+
+                // The consumer may be moving the tail too, whoever loses the race retries
+                while( size > m_size - ( head - tail ) ) {
+                    size_t needed = size - ( m_size - ( head - tail ) );
+
+                    if( m_tail.compare_exchange_weak( tail, tail + needed, std::memory_order_acq_rel ) ) {
+                        m_dropped_bytes.fetch_add( needed, std::memory_order_relaxed );
+                        tail += needed;
+                    }
+                }
+
+                break;
+            }
+
+            case DropNewest:
+                m_dropped_bytes.fetch_add( size - free, std::memory_order_relaxed );
+                size = free;
+                break;
+
+            case Block: {
+                size_t wrote = 0;
+                QElapsedTimer waited;
+
+                while( wrote < size ) {
+                    tail = m_tail.load( std::memory_order_acquire );
+                    size_t chunk = qMin( size - wrote, m_size - ( head - tail ) );
+
+                    if( !chunk ) {
+                        if( !waited.isValid() ) {
+                            waited.start();
+                        } else if( waited.hasExpired( block_timeout ) ) {
+                            m_dropped_bytes.fetch_add( size - wrote, std::memory_order_relaxed );
+                            break;
+                        }
+
+                        QThread::yieldCurrentThread();
+                        continue;
+                    }
+
+                    copyIn( head, data + wrote, chunk );
+                    head += chunk;
+                    wrote += chunk;
+                    m_head.store( head, std::memory_order_release );
+                }
+
+                return wrote;
+            }
         }
-
-        m_buffer[head] = data[wrote++];
-        m_head.store( nextHead, std::memory_order_release );
     }
 
-    return wrote;
+    copyIn( head, data, size );
+    m_head.store( head + size, std::memory_order_release );
+
+    return size;
 }
 
 size_t AudioBuffer::read( char *data, size_t size ) {
-    size_t read = 0;
-    size_t head, tail;
+    size_t tail = m_tail.load( std::memory_order_acquire );
 
-    while( read < size ) {
-        tail = m_tail.load( std::memory_order_relaxed );
-        head = m_head.load( std::memory_order_acquire );
+    while( true ) {
+        size_t head = m_head.load( std::memory_order_acquire );
+        size_t count = qMin( size, head - tail );
 
-        if( tail == head ) {
-            break;
+        if( !count ) {
+            return 0;
         }
 
-        data[read++] = m_buffer[tail];
-        m_tail.store( next( tail ), std::memory_order_release );
-    }
-
-    return read;
-}
+        copyOut( tail, data, count );
 
-size_t AudioBuffer::size_impl( size_t tail, size_t head ) const {
-    if( head < tail ) {
-        return head + ( m_size - tail );
-    } else {
-        return head - tail;
+        // If the producer dropped the oldest bytes meanwhile, what was just copied may have been overwritten
+        if( m_tail.compare_exchange_strong( tail, tail + count, std::memory_order_acq_rel ) ) {
+            return count;
+        }
     }
 }
 
 size_t AudioBuffer::size() const {
-    size_t head = m_head.load( std::memory_order_relaxed );
-    size_t tail = m_tail.load( std::memory_order_relaxed );
-    return size_impl( tail, head );
+    size_t tail = m_tail.load( std::memory_order_acquire );
+    size_t head = m_head.load( std::memory_order_acquire );
+    return head - tail;
 }
 
 void AudioBuffer::clear() {
-    m_head.store( m_tail.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+    size_t tail = m_tail.load( std::memory_order_relaxed );
+
+    while( !m_tail.compare_exchange_weak( tail, m_head.load( std::memory_order_acquire ), std::memory_order_acq_rel ) ) {
+    }
 }
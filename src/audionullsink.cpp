@@ -0,0 +1,134 @@
+#include <QtEndian>
+
+#include <cmath>
+#include <cstring>
+
+#include "audionullsink.h"
+
+AudioNullSink::AudioNullSink( AudioOutputDevice *source, AudioBuffer *input, QObject *parent )
+    : QObject( parent ),
+      source( source ),
+      input( input ),
+      pull_timer( this ),
+      active( false ),
+      hash( QCryptographicHash::Sha1 ),
+      frames_rendered( 0 ),
+      busy_nsecs( 0 ) {
+
+    // Only checks whether the core produced enough, the output doesn't depend on this interval
+    pull_timer.setInterval( 1 );
+    connect( &pull_timer, &QTimer::timeout, this, &AudioNullSink::slotPull );
+}
+
+AudioNullSink::~AudioNullSink() {
+    stop();
+}
+
+bool AudioNullSink::start( QString target, QAudioFormat in, QAudioFormat out ) {
+    stop();
+
+    format_in = in;
+    format_out = out;
+    period.resize( out.bytesForDuration( period_duration ) );
+    hash.reset();
+    frames_rendered = 0;
+    busy_nsecs = 0;
+
+    if( target != "hash" ) {
+        file.setFileName( target );
+
+        if( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) {
+            qCWarning( phxAudio ) << "Could not open" << target << "for the null audio output:" << file.errorString();
+            return false;
+        }
+
+        // Rewritten with the right sizes when the sink stops
+        writeWavHeader();
+    }
+
+    qCDebug( phxAudio ) << "Null audio output to" << target << "at" << out.sampleRate() << "Hz";
+    active = true;
+    pull_timer.start();
+    return true;
+}
+
+void AudioNullSink::stop() {
+    if( !active ) {
+        return;
+    }
+
+    active = false;
+
+    // On shutdown this runs on the main thread, once the audio thread is done
+    if( thread() == QThread::currentThread() ) {
+        pull_timer.stop();
+    }
+
+    if( file.isOpen() ) {
+        file.seek( 0 );
+        writeWavHeader();
+        file.close();
+    }
+
+    double seconds = ( double )frames_rendered / format_out.sampleRate();
+    qCDebug( phxAudio, "Null audio output: %.3fs of audio, %.1fms spent (%.0fx realtime), sha1 %s",
+             seconds, busy_nsecs / 1000000.0, busy_nsecs ? seconds * 1e9 / busy_nsecs : 0.0,
+             hash.result().toHex().constData() );
+}
+
+void AudioNullSink::slotPull() {
+    if( !active ) {
+        return;
+    }
+
+    // Enough input for a whole period at the nominal ratio, and past the output's refill target
+    const double ratio = ( double )format_out.sampleRate() / format_in.sampleRate();
+    const size_t period_frames = format_out.framesForBytes( period.size() );
+    const size_t needed = qMax<size_t>( format_in.bytesForFrames( int( std::ceil( period_frames / ratio ) ) + 16 ),
+                                        source->inputTarget() );
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while( input->size() >= needed ) {
+        qint64 bytes = source->read( period.data(), period.size() );
+
+        if( bytes <= 0 ) {
+            break;
+        }
+
+        hash.addData( period.data(), bytes );
+
+        if( file.isOpen() && file.write( period.data(), bytes ) != bytes ) {
+            qCWarning( phxAudio ) << "Null audio output write failed:" << file.errorString();
+            file.close();
+        }
+
+        frames_rendered += format_out.framesForBytes( bytes );
+    }
+
+    busy_nsecs += timer.nsecsElapsed();
+}
+
+void AudioNullSink::writeWavHeader() {
+    const quint16 channels = format_out.channelCount();
+    const quint16 bits = format_out.sampleSize();
+    const quint32 rate = format_out.sampleRate();
+    const quint32 data_size = static_cast<quint32>( format_out.bytesForFrames( frames_rendered ) );
+
+    uchar header[44];
+    memcpy( header, "RIFF", 4 );
+    qToLittleEndian<quint32>( 36 + data_size, header + 4 );
+    memcpy( header + 8, "WAVEfmt ", 8 );
+    qToLittleEndian<quint32>( 16, header + 16 );
+    qToLittleEndian<quint16>( 1, header + 20 ); // PCM
+    qToLittleEndian<quint16>( channels, header + 22 );
+    qToLittleEndian<quint32>( rate, header + 24 );
+    qToLittleEndian<quint32>( rate * channels * bits / 8, header + 28 );
+    qToLittleEndian<quint16>( channels * bits / 8, header + 32 );
+    qToLittleEndian<quint16>( bits, header + 34 );
+    memcpy( header + 36, "data", 4 );
+    qToLittleEndian<quint32>( data_size, header + 40 );
+
+    file.write( reinterpret_cast<const char *>( header ), sizeof( header ) );
+}
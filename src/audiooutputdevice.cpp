@@ -0,0 +1,379 @@
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "audiooutputdevice.h"
+
+// Same scale as libsamplerate's src_short_to_float_array(), [-32768, 32767] maps to [-1.0, 1.0)
+static void shortToFloat( const short *in, float *out, size_t count ) {
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128 scale = _mm_set1_ps( 1.0f / 32768.0f );
+
+    for( ; i + 8 <= count; i += 8 ) {
+        __m128i samples = _mm_loadu_si128( reinterpret_cast<const __m128i *>( in + i ) );
+
+        // Sign extend by putting each sample in the high half, then shifting it back down
+        __m128i low = _mm_srai_epi32( _mm_unpacklo_epi16( samples, samples ), 16 );
+        __m128i high = _mm_srai_epi32( _mm_unpackhi_epi16( samples, samples ), 16 );
+
+        _mm_storeu_ps( out + i, _mm_mul_ps( _mm_cvtepi32_ps( low ), scale ) );
+        _mm_storeu_ps( out + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( high ), scale ) );
+    }
+
+#endif
+
+    for( ; i < count; i++ ) {
+        out[i] = in[i] * ( 1.0f / 32768.0f );
+    }
+}
+
+// Rounds to nearest and saturates, resamplers overshoot a little around full scale
+static void floatToShort( const float *in, short *out, size_t count ) {
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128 scale = _mm_set1_ps( 32768.0f );
+
+    for( ; i + 8 <= count; i += 8 ) {
+        __m128i low = _mm_cvtps_epi32( _mm_mul_ps( _mm_loadu_ps( in + i ), scale ) );
+        __m128i high = _mm_cvtps_epi32( _mm_mul_ps( _mm_loadu_ps( in + i + 4 ), scale ) );
+
+        _mm_storeu_si128( reinterpret_cast<__m128i *>( out + i ), _mm_packs_epi32( low, high ) );
+    }
+
+#endif
+
+    for( ; i < count; i++ ) {
+        float sample = in[i] * 32768.0f;
+        out[i] = short( qBound( -32768.0f, std::nearbyint( sample ), 32767.0f ) );
+    }
+}
+
+// Passed by reference to qMin() and qBound()
+const qint64 AudioOutputDevice::min_latency;
+const qint64 AudioOutputDevice::max_latency;
+
+AudioOutputDevice::AudioOutputDevice( AudioBuffer *input, QObject *parent )
+    : QIODevice( parent ),
+      input( input ),
+      sample_rate_ratio( 1.0 ),
+      input_target( 0 ),
+      drc_enabled( true ),
+      resampler_quality( AudioResampler::SincMedium ),
+      output_rate( 0 ),
+      input_pending( 0 ),
+      float_output( false ),
+      passthrough( false ),
+      underrun_count( 0 ),
+      target_latency( 25000 ),
+      refilling( true ) {
+}
+
+AudioOutputDevice::~AudioOutputDevice() {
+}
+
+void AudioOutputDevice::setFormats( QAudioFormat in, QAudioFormat out, qint64 buffer_size ) {
+    format_in = in;
+    input_target = in.bytesForDuration( target_latency );
+
+    resampler.setQuality( resampler_quality, channels );
+
+    input_pending = 0;
+    passthrough = false;
+    refilling = true;
+    stable_timer.invalidate();
+    raise_timer.invalidate();
+    input->clear();
+
+    setOutputFormat( out, buffer_size );
+}
+
+void AudioOutputDevice::setOutputFormat( QAudioFormat out, qint64 buffer_size ) {
+    format_out = out;
+    sample_rate_ratio = ( double )out.sampleRate() / format_in.sampleRate();
+    float_output = out.sampleType() == QAudioFormat::Float;
+    output_rate = out.sampleRate();
+
+    // Underruns are saved per device, the old one's don't count against this one
+    underrun_count = 0;
+
+    // The latency may have been loaded for another device, or for a format the input buffer holds more of
+    target_latency = qMin( target_latency, maxLatency() );
+    input_target = format_in.bytesForDuration( target_latency );
+
+    // The backend never asks for more than its whole buffer at once
+    reserve( out.framesForBytes( buffer_size ) );
+
+    qCDebug( phxAudio ) << "Output device ready, ratio" << sample_rate_ratio << "latency" << target_latency / 1000.0 << "ms,"
+                        << ( float_output ? "float" : "16 bit" ) << "output";
+}
+
+void AudioOutputDevice::reserve( size_t frames ) {
+    // The resampler may need a little more input than output, for DRC and its own delay
+    size_t input_frames = frames / sample_rate_ratio * ( 1.0 + max_deviation ) + 64;
+
+    if( output_float.size() < frames * channels ) {
+        output_float.resize( frames * channels );
+    }
+
+    if( input_short.size() < input_frames * channels ) {
+        input_short.resize( input_frames * channels );
+    }
+
+    // Room for what the resampler left over last time, on top of a full read
+    if( input_float.size() < input_frames * 2 * channels ) {
+        input_float.resize( input_frames * 2 * channels );
+    }
+}
+
+void AudioOutputDevice::setResamplerQuality( AudioResampler::Quality quality ) {
+    if( quality == resampler_quality ) {
+        return;
+    }
+
+    resampler_quality = quality;
+
+    // The frames already buffered by the old converter are lost, a few milliseconds at most
+    resampler.setQuality( quality, channels );
+    qCDebug( phxAudio ) << "Resampler quality set to" << AudioResampler::qualityNames().at( quality );
+}
+
+void AudioOutputDevice::setLatency( qint64 usecs ) {
+    target_latency = qBound( min_latency, usecs, maxLatency() );
+}
+
+qint64 AudioOutputDevice::maxLatency() const {
+    if( !format_in.isValid() ) {
+        return max_latency;
+    }
+
+    // A target the buffer can't reach would mean refilling forever
+    qint64 room = format_in.durationForBytes( input->capacity() ) - frame_headroom;
+    return qBound( min_latency, room, max_latency );
+}
+
+void AudioOutputDevice::underrun() {
+    underrun_count++;
+    refilling = true;
+    stable_timer.start();
+
+    qint64 highest = maxLatency();
+
+    if( target_latency >= highest || ( raise_timer.isValid() && !raise_timer.hasExpired( raise_cooldown ) ) ) {
+        return;
+    }
+
+    // Up fast, a single underrun is much more noticeable than a few more milliseconds of latency
+    target_latency = qMin( highest, target_latency * 3 / 2 );
+    input_target = format_in.bytesForDuration( target_latency );
+    raise_timer.start();
+
+    qCDebug( phxAudio, "Underrun, latency raised to %.1fms", target_latency / 1000.0 );
+    emit latencyChanged( target_latency, underrun_count );
+}
+
+void AudioOutputDevice::adaptLatency() {
+    if( !stable_timer.isValid() ) {
+        stable_timer.start();
+        return;
+    }
+
+    if( target_latency == min_latency || !stable_timer.hasExpired( stable_period ) ) {
+        return;
+    }
+
+    // Down slowly, one step per stable period
+    target_latency = qMax( min_latency, target_latency * 9 / 10 );
+    input_target = format_in.bytesForDuration( target_latency );
+    stable_timer.start();
+
+    qCDebug( phxAudio, "Stable, latency lowered to %.1fms", target_latency / 1000.0 );
+    emit latencyChanged( target_latency, underrun_count );
+}
+
+qint64 AudioOutputDevice::bytesAvailable() const {
+    // There is always something to play, silence if nothing else
+    return format_out.bytesForDuration( 1000000 ) + QIODevice::bytesAvailable();
+}
+
+double AudioOutputDevice::fillDirection() const {
+    if( !drc_enabled.load( std::memory_order_relaxed ) ) {
+        return 0.0;
+    }
+
+    // Positive when the core is ahead of the target, negative when it's behind
+    double target = input_target.load( std::memory_order_relaxed );
+    double direction = ( ( double )input->size() - target ) / target;
+    return qBound( -1.0, direction, 1.0 );
+}
+
+size_t AudioOutputDevice::fillInput( size_t frames ) {
+    if( input_short.size() < frames * channels ) {
+        input_short.resize( frames * channels );
+    }
+
+    if( input_float.size() < ( input_pending + frames ) * channels ) {
+        input_float.resize( ( input_pending + frames ) * channels );
+    }
+
+    size_t bytes = input->read( ( char * )input_short.data(), format_in.bytesForFrames( frames ) );
+    size_t frames_read = format_in.framesForBytes( bytes );
+
+    shortToFloat( input_short.data(), input_float.data() + input_pending * channels, frames_read * channels );
+    input_pending += frames_read;
+
+    return frames_read;
+}
+
+size_t AudioOutputDevice::resample( float *out, size_t frames_wanted, double ratio ) {
+    size_t frames_out = 0;
+
+    while( frames_out < frames_wanted ) {
+        // Just what this period needs, plus a little for the resampler's own delay
+        size_t frames_needed = ( frames_wanted - frames_out ) / ratio + 1;
+
+        if( input_pending < frames_needed && !fillInput( frames_needed - input_pending ) && !input_pending ) {
+            break;
+        }
+
+        size_t frames_used, frames_generated;
+
+        if( !resampler.process( input_float.data(), input_pending, out + frames_out * channels,
+                                frames_wanted - frames_out, ratio, &frames_used, &frames_generated ) ) {
+            break;
+        }
+
+        // Whatever the resampler didn't use goes first next time
+        input_pending -= frames_used;
+        memmove( input_float.data(), input_float.data() + frames_used * channels, input_pending * channels * sizeof( float ) );
+
+        frames_out += frames_generated;
+
+        if( !frames_generated && !frames_used ) {
+            break;
+        }
+    }
+
+    return frames_out;
+}
+
+size_t AudioOutputDevice::readPassthrough( char *data, size_t frames_wanted ) {
+    size_t frames_out = 0;
+
+    // Input the resampler didn't get to yet comes first, it's still at the input rate
+    if( input_pending ) {
+        size_t frames = qMin( input_pending, frames_wanted );
+
+        if( float_output ) {
+            memcpy( data, input_float.data(), frames * channels * sizeof( float ) );
+        } else {
+            floatToShort( input_float.data(), ( short * )data, frames * channels );
+        }
+
+        input_pending -= frames;
+        memmove( input_float.data(), input_float.data() + frames * channels, input_pending * channels * sizeof( float ) );
+        frames_out = frames;
+    }
+
+    if( frames_out == frames_wanted ) {
+        return frames_out;
+    }
+
+    if( !float_output ) {
+        // Same format on both sides, straight copy
+        size_t bytes = input->read( data + format_out.bytesForFrames( frames_out ), format_in.bytesForFrames( frames_wanted - frames_out ) );
+        return frames_out + format_in.framesForBytes( bytes );
+    }
+
+    size_t frames = frames_wanted - frames_out;
+
+    if( input_short.size() < frames * channels ) {
+        input_short.resize( frames * channels );
+    }
+
+    size_t bytes = input->read( ( char * )input_short.data(), format_in.bytesForFrames( frames ) );
+    frames = format_in.framesForBytes( bytes );
+    shortToFloat( input_short.data(), ( float * )data + frames_out * channels, frames * channels );
+
+    return frames_out + frames;
+}
+
+qint64 AudioOutputDevice::readData( char *data, qint64 max_size ) {
+    size_t frames_wanted = format_out.framesForBytes( max_size );
+
+    if( !frames_wanted || !format_in.isValid() ) {
+        return 0;
+    }
+
+    if( refilling ) {
+        if( input->size() < input_target.load( std::memory_order_relaxed ) ) {
+            memset( data, 0, format_out.bytesForFrames( frames_wanted ) );
+            return format_out.bytesForFrames( frames_wanted );
+        }
+
+        refilling = false;
+    }
+
+    double direction = fillDirection();
+
+    // Only changes with the sync mode. Clock drift is corrected by DRC's small rate changes instead,
+    // leaving and entering the passthrough mid-stream loses the resampler's state and clicks.
+    bool use_passthrough = sample_rate_ratio == 1.0 && !drc_enabled.load( std::memory_order_relaxed );
+
+    if( use_passthrough != passthrough ) {
+        passthrough = use_passthrough;
+
+        // Whatever the resampler still holds is from before the passthrough
+        if( !passthrough ) {
+            resampler.reset();
+        }
+    }
+
+    size_t frames_out;
+
+    if( passthrough ) {
+        frames_out = readPassthrough( data, frames_wanted );
+    } else {
+        // Above the target the core is ahead, consume the input faster by producing less output per input frame
+        double ratio = sample_rate_ratio * ( 1.0 - max_deviation * direction );
+
+        if( output_float.size() < frames_wanted * channels ) {
+            output_float.resize( frames_wanted * channels );
+        }
+
+        // Float output goes straight into the backend's buffer when it's aligned
+        bool direct = float_output && reinterpret_cast<quintptr>( data ) % alignof( float ) == 0;
+        float *out = direct ? reinterpret_cast<float *>( data ) : output_float.data();
+
+        frames_out = resample( out, frames_wanted, ratio );
+
+        if( !direct ) {
+            if( float_output ) {
+                memcpy( data, out, frames_out * channels * sizeof( float ) );
+            } else {
+                floatToShort( out, ( short * )data, frames_out * channels );
+            }
+        }
+    }
+
+    // The core couldn't keep up, play silence rather than letting the backend stop
+    if( frames_out < frames_wanted ) {
+        memset( data + format_out.bytesForFrames( frames_out ), 0, format_out.bytesForFrames( frames_wanted - frames_out ) );
+        underrun();
+    } else {
+        adaptLatency();
+    }
+
+    return format_out.bytesForFrames( frames_wanted );
+}
+
+qint64 AudioOutputDevice::writeData( const char *data, qint64 max_size ) {
+    Q_UNUSED( data );
+    Q_UNUSED( max_size );
+    return -1;
+}
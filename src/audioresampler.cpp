@@ -0,0 +1,221 @@
+#include <QElapsedTimer>
+
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "audioresampler.h"
+
+AudioResampler::AudioResampler()
+    : quality( SincMedium ),
+      channels( 2 ),
+      state( nullptr ),
+      position( 1.0 ),
+      cost_nsecs( 0 ),
+      cost_frames( 0 ) {
+}
+
+AudioResampler::~AudioResampler() {
+    if( state ) {
+        src_delete( state );
+    }
+}
+
+QStringList AudioResampler::qualityNames() {
+    // Same order as Quality
+    return QStringList{ "sinc-best", "sinc-medium", "sinc-fast", "linear", "cubic" };
+}
+
+bool AudioResampler::qualityFromName( QString name, Quality *quality ) {
+    int index = qualityNames().indexOf( name );
+
+    if( index == -1 ) {
+        return false;
+    }
+
+    *quality = static_cast<Quality>( index );
+    return true;
+}
+
+bool AudioResampler::setQuality( Quality quality, int channels ) {
+    this->quality = quality;
+    this->channels = channels;
+
+    if( state ) {
+        src_delete( state );
+        state = nullptr;
+    }
+
+    if( quality != Cubic ) {
+        static const int converters[] = { SRC_SINC_BEST_QUALITY, SRC_SINC_MEDIUM_QUALITY, SRC_SINC_FASTEST, SRC_LINEAR };
+
+        int errorCode;
+        state = src_new( converters[quality], channels, &errorCode );
+
+        if( !state ) {
+            qCWarning( phxAudio ) << "libresample could not init: " << src_strerror( errorCode ) ;
+            return false;
+        }
+    }
+
+    reset();
+    return true;
+}
+
+void AudioResampler::reset() {
+    if( state ) {
+        src_reset( state );
+    }
+
+    // Starts on silence
+    work.assign( cubic_history * channels, 0.0f );
+    position = 1.0;
+
+    cost_nsecs = 0;
+    cost_frames = 0;
+}
+
+bool AudioResampler::process( const float *in, size_t in_frames, float *out, size_t out_frames, double ratio,
+                              size_t *in_used, size_t *out_generated ) {
+    QElapsedTimer timer;
+    timer.start();
+
+    *in_used = 0;
+    *out_generated = 0;
+
+    if( quality == Cubic ) {
+        // Input goes after the history, the work buffer only grows up to the largest input seen
+        size_t history_samples = cubic_history * channels;
+        work.resize( history_samples + in_frames * channels );
+        memcpy( work.data() + history_samples, in, in_frames * channels * sizeof( float ) );
+
+        size_t total_frames = cubic_history + in_frames;
+        *out_generated = processCubic( total_frames, out, out_frames, 1.0 / ratio );
+
+        // Frames before the one under position - 1 are not needed anymore
+        size_t used = qMin<size_t>( in_frames, size_t( position ) - 1 );
+        memmove( work.data(), work.data() + used * channels, history_samples * sizeof( float ) );
+        work.resize( history_samples );
+        position -= used;
+        *in_used = used;
+    } else {
+        if( !state ) {
+            return false;
+        }
+
+        SRC_DATA src_data;
+        src_data.data_in = in;
+        src_data.data_out = out;
+        src_data.end_of_input = 0;
+        src_data.input_frames = in_frames;
+        src_data.output_frames = out_frames;
+        src_data.src_ratio = ratio;
+
+        src_set_ratio( state, ratio );
+        auto errorCode = src_process( state, &src_data );
+
+        if( errorCode ) {
+            qCWarning( phxAudio ) << "libresample error: " << src_strerror( errorCode ) ;
+            return false;
+        }
+
+        *in_used = src_data.input_frames_used;
+        *out_generated = src_data.output_frames_gen;
+    }
+
+    cost_nsecs.fetch_add( timer.nsecsElapsed(), std::memory_order_relaxed );
+    cost_frames.fetch_add( *out_generated, std::memory_order_relaxed );
+    return true;
+}
+
+// Catmull-Rom spline through xm1, x0, x1 and x2, evaluated at t between x0 and x1
+static inline float cubic( float xm1, float x0, float x1, float x2, float t ) {
+    return x0 + 0.5f * t * ( x1 - xm1 + t * ( 2.0f * xm1 - 5.0f * x0 + 4.0f * x1 - x2 + t * ( 3.0f * ( x0 - x1 ) + x2 - xm1 ) ) );
+}
+
+size_t AudioResampler::processCubic( size_t total_frames, float *out, size_t out_frames, double step ) {
+    const float *w = work.data();
+    size_t generated = 0;
+
+#ifdef __SSE2__
+
+    // Two stereo output frames per iteration, lanes are { L a, R a, L b, R b }
+    if( channels == 2 ) {
+        const __m128 half = _mm_set1_ps( 0.5f );
+        const __m128 two = _mm_set1_ps( 2.0f );
+        const __m128 three = _mm_set1_ps( 3.0f );
+        const __m128 four = _mm_set1_ps( 4.0f );
+        const __m128 five = _mm_set1_ps( 5.0f );
+
+        while( generated + 2 <= out_frames ) {
+            double position_b = position + step;
+            size_t a = size_t( position );
+            size_t b = size_t( position_b );
+
+            if( b + 2 >= total_frames ) {
+                break;
+            }
+
+            float ta = float( position - a );
+            float tb = float( position_b - b );
+            __m128 t = _mm_set_ps( tb, tb, ta, ta );
+
+            const __m64 *fa = reinterpret_cast<const __m64 *>( w + ( a - 1 ) * 2 );
+            const __m64 *fb = reinterpret_cast<const __m64 *>( w + ( b - 1 ) * 2 );
+            __m128 xm1 = _mm_loadh_pi( _mm_loadl_pi( _mm_setzero_ps(), fa ), fb );
+            __m128 x0 = _mm_loadh_pi( _mm_loadl_pi( _mm_setzero_ps(), fa + 1 ), fb + 1 );
+            __m128 x1 = _mm_loadh_pi( _mm_loadl_pi( _mm_setzero_ps(), fa + 2 ), fb + 2 );
+            __m128 x2 = _mm_loadh_pi( _mm_loadl_pi( _mm_setzero_ps(), fa + 3 ), fb + 3 );
+
+            __m128 c3 = _mm_sub_ps( _mm_add_ps( _mm_mul_ps( three, _mm_sub_ps( x0, x1 ) ), x2 ), xm1 );
+            __m128 c2 = _mm_sub_ps( _mm_add_ps( _mm_sub_ps( _mm_mul_ps( two, xm1 ), _mm_mul_ps( five, x0 ) ), _mm_mul_ps( four, x1 ) ), x2 );
+            __m128 c1 = _mm_sub_ps( x1, xm1 );
+            __m128 y = _mm_add_ps( c2, _mm_mul_ps( t, c3 ) );
+            y = _mm_add_ps( c1, _mm_mul_ps( t, y ) );
+            y = _mm_add_ps( x0, _mm_mul_ps( _mm_mul_ps( half, t ), y ) );
+
+            _mm_storeu_ps( out + generated * 2, y );
+
+            generated += 2;
+            position = position_b + step;
+        }
+    }
+
+#endif
+
+    // Tail, and anything that isn't stereo
+    while( generated < out_frames ) {
+        size_t i = size_t( position );
+
+        if( i + 2 >= total_frames ) {
+            break;
+        }
+
+        float t = float( position - i );
+
+        for( int c = 0; c < channels; c++ ) {
+            out[generated * channels + c] = cubic( w[( i - 1 ) * channels + c], w[i * channels + c],
+                                                   w[( i + 1 ) * channels + c], w[( i + 2 ) * channels + c], t );
+        }
+
+        generated++;
+        position += step;
+    }
+
+    return generated;
+}
+
+qreal AudioResampler::takeCost( int sample_rate ) {
+    qint64 nsecs = cost_nsecs.exchange( 0, std::memory_order_relaxed );
+    qint64 frames = cost_frames.exchange( 0, std::memory_order_relaxed );
+
+    if( !frames || sample_rate <= 0 ) {
+        return 0.0;
+    }
+
+    // nanoseconds per frame * frames per second, in milliseconds
+    return ( qreal )nsecs / frames * sample_rate / 1000000.0;
+}
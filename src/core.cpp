@@ -1,31 +1,10 @@
+#include <cstring>
+
 #include "core.h"
 #include "phoenixglobals.h"
-
-//  ________________________
-// |                        |
-// |        Globals         |
-// |________________________|
-
-QDebug operator<<( QDebug debug, const Core::Variable &var ) {
-    // join a QVector of std::strings. (Really, C++ ?)
-    auto &choices = var.choices();
-    std::string joinedchoices;
-
-    foreach( auto &choice, choices ) {
-        joinedchoices.append( choice );
-
-        if( &choice != &choices.last() ) {
-            joinedchoices.append( ", " );
-        }
-    }
-
-    auto QStr = QString::fromStdString; // shorter alias
-
-    debug << qPrintable( QString( "Core::Variable(%1=%2, description=\"%3\", choices=[%4])" ).
-                         arg( QStr( var.key() ) ).arg( QStr( var.value( "<not set>" ) ) ).
-                         arg( QStr( var.description() ) ).arg( QStr( joinedchoices ) ) );
-    return debug;
-}
+#include "recorder.h"
+#include "latencytestcore.h"
+#include "latencymonitor.h"
 
 //  ________________________
 // |                        |
@@ -51,6 +30,8 @@ LibretroSymbols::LibretroSymbols() {
 Core::Core() {
     libretro_core = nullptr;
     audio_buf = nullptr;
+    recorder = nullptr;
+    latency_monitor = nullptr;
     system_av_info = new retro_system_av_info();
     system_info = new retro_system_info();
     symbols = new LibretroSymbols;
@@ -64,8 +45,13 @@ Core::Core() {
     left_channel = 0;
     right_channel = 0;
 
+    // Enough for a frame at 48kHz and 50Hz, or more than one for most cores
+    audio_frame_samples.reserve( 2048 * 2 );
+
     is_dupe_frame = false;
+    input_polled = false;
     m_sram = nullptr;
+    unsupported_commands = 0;
 
     Core::core = this;
 
@@ -79,7 +65,16 @@ Core::~Core() {
     saveSRAM();
     symbols->retro_unload_game();
     symbols->retro_deinit();
-    libretro_core->unload();
+
+    // Cores don't always stop the motors before they go away
+    input_manager.stopRumble();
+    input_manager.keyboardQueue().stop();
+
+    // Built-in cores have no library
+    if( libretro_core ) {
+        libretro_core->unload();
+    }
+
     game_data.clear();
     library_name.clear();
 
@@ -101,10 +96,17 @@ Core::~Core() {
 //
 
 bool Core::loadCore( const char *path ) {
-    libretro_core = new QLibrary( path );
-    libretro_core->load();
+    if( strcmp( path, LatencyTestCore::path ) == 0 ) {
+        // Built in, there's no library to load
+        LatencyTestCore::resolveSymbols( symbols );
+        library_name = path;
+    } else {
+        libretro_core = new QLibrary( path );
+        libretro_core->load();
 
-    if( libretro_core->isLoaded() ) {
+        if( !libretro_core->isLoaded() ) {
+            return false;
+        }
 
         library_name = libretro_core->fileName().toLocal8Bit();
 
@@ -134,29 +136,26 @@ bool Core::loadCore( const char *path ) {
         resolved_sym( retro_get_region );
         resolved_sym( retro_get_memory_data );
         resolved_sym( retro_get_memory_size );
+    }
 
-        // Set callbacks
-        symbols->retro_set_environment( environmentCallback );
-        symbols->retro_set_audio_sample( audioSampleCallback );
-        symbols->retro_set_audio_sample_batch( audioSampleBatchCallback );
-        symbols->retro_set_input_poll( inputPollCallback );
-        symbols->retro_set_input_state( inputStateCallback );
-        symbols->retro_set_video_refresh( videoRefreshCallback );
-        //symbols->retro_get_memory_data( getMemoryData );
-        //symbols->retro_get_memory_size( getMemorySize );
-
-        // Init the core
-        symbols->retro_init();
-
-        // Get some info about the game
-        symbols->retro_get_system_info( system_info );
-        full_path_needed = system_info->need_fullpath;
+    // Set callbacks
+    symbols->retro_set_environment( environmentCallback );
+    symbols->retro_set_audio_sample( audioSampleCallback );
+    symbols->retro_set_audio_sample_batch( audioSampleBatchCallback );
+    symbols->retro_set_input_poll( inputPollCallback );
+    symbols->retro_set_input_state( inputStateCallback );
+    symbols->retro_set_video_refresh( videoRefreshCallback );
+    //symbols->retro_get_memory_data( getMemoryData );
+    //symbols->retro_get_memory_size( getMemorySize );
 
-        return true;
+    // Init the core
+    symbols->retro_init();
 
-    }
+    // Get some info about the game
+    symbols->retro_get_system_info( system_info );
+    full_path_needed = system_info->need_fullpath;
 
-    return false;
+    return true;
 
 } // Core::loadCore()
 
@@ -229,6 +228,9 @@ bool Core::loadGame( const char *path ) {
 
     loadSRAM();
 
+    // Keys typed in the menus stay there
+    input_manager.keyboardQueue().start();
+
     return true;
 
 } // Core::loadGame()
@@ -237,15 +239,49 @@ void Core::doFrame() {
     // Update the static pointer
     core = this;
 
+    // Option edits only ever land between two frames
+    variables.latch();
+
+    // Keys typed since the last frame, a callback per key would stall the GUI thread
+    input_manager.keyboardQueue().deliver( symbols->retro_keyboard_event );
+
     // Tell the core to run a frame
+    input_polled = false;
     symbols->retro_run();
 
+    // The core is supposed to poll once per frame, if it didn't, latch the input for the next one anyway
+    if( !input_polled ) {
+        inputPollCallback();
+    }
+
     if( symbols->retro_audio ) {
         symbols->retro_audio();
     }
 
+    flushAudioSamples();
+
 } // void doFrame()
 
+void Core::flushAudioSamples() {
+    if( audio_frame_samples.empty() ) {
+        return;
+    }
+
+    size_t frames = audio_frame_samples.size() / 2;
+
+    if( audio_buf ) {
+        audio_buf->write( ( const char * )audio_frame_samples.data(), frames * sizeof( int16_t ) * 2 );
+    }
+
+    if( recorder && recorder->isRecording() ) {
+        recorder->pushAudio( audio_frame_samples.data(), frames );
+    }
+
+    // Keeps the capacity, no allocation on the next frame
+    audio_frame_samples.clear();
+
+} // Core::flushAudioSamples()
+
 //
 // Misc
 //
@@ -378,321 +414,219 @@ void Core::loadSRAM() {
 // |________________________|
 
 void Core::audioSampleCallback( int16_t left, int16_t right ) {
-    if( core->audio_buf ) {
-        uint32_t sample = ( ( uint16_t ) left << 16 ) | ( uint16_t ) right;
-        core->audio_buf->write( ( const char * )&sample, sizeof( int16_t ) * 2 );
-    }
+    // Interleaved left first, same as the batches
+    core->audio_frame_samples.push_back( left );
+    core->audio_frame_samples.push_back( right );
 
 } // Core::audioSampleCallback()
 
 size_t Core::audioSampleBatchCallback( const int16_t *data, size_t frames ) {
+    // Keeps the order if a core mixes both callbacks
+    core->flushAudioSamples();
+
     if( core->audio_buf ) {
         core->audio_buf->write( ( const char * )data, frames * sizeof( int16_t ) * 2 );
     }
 
+    if( core->recorder && core->recorder->isRecording() ) {
+        core->recorder->pushAudio( data, frames );
+    }
+
     return frames;
     
 } // Core::audioSampleBatchCallback()
 
-bool Core::environmentCallback( unsigned cmd, void *data ) {
-    switch( cmd ) {
-        case RETRO_ENVIRONMENT_SET_ROTATION: // 1
-            qDebug() << "\tRETRO_ENVIRONMENT_SET_ROTATION (1)";
-            break;
-
-        case RETRO_ENVIRONMENT_GET_OVERSCAN: // 2
-            qDebug() << "\tRETRO_ENVIRONMENT_GET_OVERSCAN (2) (handled)";
-            // Crop away overscan
-            return true;
-
-        case RETRO_ENVIRONMENT_GET_CAN_DUPE: // 3
-            *( bool * )data = true;
-            return true;
-
-        // 4 and 5 have been deprecated
-        
-        case RETRO_ENVIRONMENT_SET_MESSAGE: // 6
-            qDebug() << "\tRETRO_ENVIRONMENT_SET_MESSAGE (6)";
-            break;
-
-        case RETRO_ENVIRONMENT_SHUTDOWN: // 7
-            qDebug() << "\tRETRO_ENVIRONMENT_SHUTDOWN (7)";
-            break;
-
-        case RETRO_ENVIRONMENT_SET_PERFORMANCE_LEVEL: // 8
-            qDebug() << "\tRETRO_ENVIRONMENT_SET_PERFORMANCE_LEVEL (8)";
-            break;
-
-        case RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY: // 9
-            qCDebug( phxCore ) << "\tRETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY (9)";
-            *static_cast<const char **>( data ) = core->system_directory.constData();
-            return true;
-
-        case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT: { // 10
-            qDebug() << "\tRETRO_ENVIRONMENT_SET_PIXEL_FORMAT (10) (handled)";
-
-            retro_pixel_format *pixelformat = ( enum retro_pixel_format * )data;
-            Core::core->pixel_format = *pixelformat;
-
-            switch( *pixelformat ) {
-                case RETRO_PIXEL_FORMAT_0RGB1555:
-                    qDebug() << "\tPixel format: 0RGB1555\n";
-                    return true;
-                    
-                case RETRO_PIXEL_FORMAT_RGB565:
-                    qDebug() << "\tPixel format: RGB565\n";
-                    return true;
-                    
-                case RETRO_PIXEL_FORMAT_XRGB8888:
-                    qDebug() << "\tPixel format: XRGB8888\n";
-                    return true;
-                    
-                default:
-                    qDebug() << "\tError: Pixel format is not supported. (" << pixelformat << ")";
-                    break;
-            }
-
-            return false;
-        }
-
-        case RETRO_ENVIRONMENT_SET_INPUT_DESCRIPTORS: // 11
-            qDebug() << "\tRETRO_ENVIRONMENT_SET_INPUT_DESCRIPTORS (11) (handled)";
-            Core::core->input_descriptor = *( retro_input_descriptor * )data;
-            return true;
-
-        case RETRO_ENVIRONMENT_SET_KEYBOARD_CALLBACK: // 12
-            qDebug() << "\tRETRO_ENVIRONMENT_SET_KEYBOARD_CALLBACK (12) (handled)";
-            Core::core->symbols->retro_keyboard_event = ( decltype( LibretroSymbols::retro_keyboard_event ) )data;
-            break;
-
-        case RETRO_ENVIRONMENT_SET_DISK_CONTROL_INTERFACE: // 13
-            qDebug() << "\tRETRO_ENVIRONMENT_SET_DISK_CONTROL_INTERFACE (13)";
-            break;
-
-        case RETRO_ENVIRONMENT_SET_HW_RENDER: // 14
-            qDebug() << "\tRETRO_ENVIRONMENT_SET_HW_RENDER (14)";
-            Core::core->hw_callback = *( retro_hw_render_callback * )data;
-
-            switch( Core::core->hw_callback.context_type ) {
-                case RETRO_HW_CONTEXT_NONE:
-                    qDebug() << "No hardware context was selected";
-                    break;
-
-                case RETRO_HW_CONTEXT_OPENGL:
-                    qDebug() << "OpenGL 2 context was selected";
-                    break;
-
-                case RETRO_HW_CONTEXT_OPENGLES2:
-                    qDebug() << "OpenGL ES 2 context was selected";
-                    Core::core->hw_callback.context_type = RETRO_HW_CONTEXT_OPENGLES2;
-                    break;
-
-                case RETRO_HW_CONTEXT_OPENGLES3:
-                    qDebug() << "OpenGL 3 context was selected";
-                    break;
-
-                default:
-                    qCritical() << "RETRO_HW_CONTEXT: " << Core::core->hw_callback.context_type << " was not handled";
-                    break;
-            }
-
-            break;
+// Environment commands are dispatched through a table indexed by the command number,
+// commands without a handler are reported as unsupported to the core.
+// The handlers are friends of Core, so they can reach its private members.
+struct CoreEnvironment {
+    typedef bool ( *Handler )( Core *core, void *data );
 
-        case RETRO_ENVIRONMENT_GET_VARIABLE: { // 15
-            auto *rv = static_cast<struct retro_variable *>( data );
+    static const unsigned command_count = 64;
 
-            if( core->variables.contains( rv->key ) ) {
-                const auto &var = core->variables[rv->key];
+    Handler handlers[command_count];
 
-                if( var.isValid() ) {
-                    rv->value = var.value().c_str();
-                }
-            }
-
-            break;
+    CoreEnvironment() {
+        for( auto &handler : handlers ) {
+            handler = nullptr;
         }
 
-        case RETRO_ENVIRONMENT_SET_VARIABLES: { // 16
-            qCDebug( phxCore ) << "SET_VARIABLES:";
-            auto *rv = static_cast<const struct retro_variable *>( data );
-
-            for( ; rv->key != NULL; rv++ ) {
-                Core::Variable v( rv );
-                core->variables.insert( v.key(), v );
-                qCDebug( phxCore ) << "\t" << v;
-            }
+        handlers[RETRO_ENVIRONMENT_GET_OVERSCAN] = getOverscan;
+        handlers[RETRO_ENVIRONMENT_GET_CAN_DUPE] = getCanDupe;
+        handlers[RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY] = getSystemDirectory;
+        handlers[RETRO_ENVIRONMENT_SET_PIXEL_FORMAT] = setPixelFormat;
+        handlers[RETRO_ENVIRONMENT_SET_INPUT_DESCRIPTORS] = setInputDescriptors;
+        handlers[RETRO_ENVIRONMENT_SET_KEYBOARD_CALLBACK] = setKeyboardCallback;
+        handlers[RETRO_ENVIRONMENT_SET_HW_RENDER] = setHwRender;
+        handlers[RETRO_ENVIRONMENT_GET_VARIABLE] = getVariable;
+        handlers[RETRO_ENVIRONMENT_SET_VARIABLES] = setVariables;
+        handlers[RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE] = getVariableUpdate;
+        handlers[RETRO_ENVIRONMENT_GET_LIBRETRO_PATH] = getLibretroPath;
+        handlers[RETRO_ENVIRONMENT_SET_FRAME_TIME_CALLBACK] = setFrameTimeCallback;
+        handlers[RETRO_ENVIRONMENT_GET_LOG_INTERFACE] = getLogInterface;
+        handlers[RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY] = getSaveDirectory;
+        handlers[RETRO_ENVIRONMENT_GET_RUMBLE_INTERFACE] = getRumbleInterface;
+    }
 
-            break;
-        }
+    static bool getOverscan( Core *core, void *data ) {
+        Q_UNUSED( core )
+        // Crop away overscan
+        *static_cast<bool *>( data ) = false;
+        return true;
+    }
 
-        case RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE: // 17
-            //            qDebug() << "\tRETRO_ENVIRONMENT_GET_VARIABLE_UPDATE (17)";
-            break;
-
-        case RETRO_ENVIRONMENT_SET_SUPPORT_NO_GAME: // 18
-            qDebug() << "\tRETRO_ENVIRONMENT_SET_SUPPORT_NO_GAME (18)";
-            break;
-
-        case RETRO_ENVIRONMENT_GET_LIBRETRO_PATH: // 19
-            *static_cast<const char **>( data ) = core->getLibraryName().constData();
-            break;
-
-        // 20 has been deprecated
-        
-        case RETRO_ENVIRONMENT_SET_FRAME_TIME_CALLBACK: // 21
-            qDebug() << "RETRO_ENVIRONMENT_SET_FRAME_TIME_CALLBACK (21)";
-            Core::core->symbols->retro_frame_time = ( decltype( LibretroSymbols::retro_frame_time ) )data;
-            break;
-
-        case RETRO_ENVIRONMENT_SET_AUDIO_CALLBACK: // 22
-            qDebug() << "\tRETRO_ENVIRONMENT_SET_AUDIO_CALLBACK (22)";
-            break;
-
-        case RETRO_ENVIRONMENT_GET_RUMBLE_INTERFACE: // 23
-            qDebug() << "\tRETRO_ENVIRONMENT_GET_RUMBLE_INTERFACE (23)";
-            break;
-
-        case RETRO_ENVIRONMENT_GET_INPUT_DEVICE_CAPABILITIES: // 24
-            qDebug() << "\tRETRO_ENVIRONMENT_GET_INPUT_DEVICE_CAPABILITIES (24)";
-            break;
-
-        case RETRO_ENVIRONMENT_GET_SENSOR_INTERFACE: // 25
-            qDebug() << "\tRETRO_ENVIRONMENT_GET_SENSOR_INTERFACE (25)";
-            break;
-
-        case RETRO_ENVIRONMENT_GET_CAMERA_INTERFACE: // 26
-            qDebug() << "\tRETRO_ENVIRONMENT_GET_CAMERA_INTERFACE (26)";
-            break;
-
-        case RETRO_ENVIRONMENT_GET_LOG_INTERFACE: {// 27
-            struct retro_log_callback *logcb = ( struct retro_log_callback * )data;
-            logcb->log = logCallback;
-            return true;
-        }
+    static bool getCanDupe( Core *core, void *data ) {
+        Q_UNUSED( core )
+        *static_cast<bool *>( data ) = true;
+        return true;
+    }
 
-        case RETRO_ENVIRONMENT_GET_PERF_INTERFACE: // 28
-            qDebug() << "\tRETRO_ENVIRONMENT_GET_PERF_INTERFACE (28)";
-            break;
+    static bool getSystemDirectory( Core *core, void *data ) {
+        *static_cast<const char **>( data ) = core->system_directory.constData();
+        return true;
+    }
 
-        case RETRO_ENVIRONMENT_GET_LOCATION_INTERFACE: // 29
-            qDebug() << "\tRETRO_ENVIRONMENT_GET_LOCATION_INTERFACE (29)";
-            break;
+    static bool setPixelFormat( Core *core, void *data ) {
+        retro_pixel_format pixel_format = *static_cast<const retro_pixel_format *>( data );
+
+        switch( pixel_format ) {
+            case RETRO_PIXEL_FORMAT_0RGB1555:
+            case RETRO_PIXEL_FORMAT_RGB565:
+            case RETRO_PIXEL_FORMAT_XRGB8888:
+                core->pixel_format = pixel_format;
+                core->logger.log( RETRO_LOG_DEBUG, "Pixel format: %s", pixel_format == RETRO_PIXEL_FORMAT_XRGB8888
+                                  ? "XRGB8888" : pixel_format == RETRO_PIXEL_FORMAT_RGB565 ? "RGB565" : "0RGB1555" );
+                return true;
+
+            default:
+                core->logger.log( RETRO_LOG_WARN, "Pixel format %d is not supported", pixel_format );
+                return false;
+        }
+    }
 
-        case RETRO_ENVIRONMENT_GET_CONTENT_DIRECTORY: // 30
-            qDebug() << "\tRETRO_ENVIRONMENT_GET_CONTENT_DIRECTORY (30)";
-            break;
+    static bool setInputDescriptors( Core *core, void *data ) {
+        core->input_descriptor = *static_cast<const retro_input_descriptor *>( data );
+        return true;
+    }
 
-        case RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY: // 31
-            qCDebug( phxCore ) << "\tRETRO_ENVIRONMENT_GET_SAVE_DIRECTORY (31)";
-            *static_cast<const char **>( data ) = core->save_directory.constData();
-            qCDebug( phxCore ) << "Save Directory: " << core->save_directory;
-            break;
+    static bool setKeyboardCallback( Core *core, void *data ) {
+        core->symbols->retro_keyboard_event = static_cast<const retro_keyboard_callback *>( data )->callback;
+        return true;
+    }
 
-        case RETRO_ENVIRONMENT_SET_SYSTEM_AV_INFO: // 32
-            qDebug() << "\tRETRO_ENVIRONMENT_SET_SYSTEM_AV_INFO (32)";
-            break;
+    static bool setHwRender( Core *core, void *data ) {
+        core->hw_callback = *static_cast<const retro_hw_render_callback *>( data );
+        core->logger.log( RETRO_LOG_WARN, "Hardware rendering (context type %d) is not supported",
+                          core->hw_callback.context_type );
+        return false;
+    }
 
-        case RETRO_ENVIRONMENT_SET_PROC_ADDRESS_CALLBACK: // 33
-            qDebug() << "\tRETRO_ENVIRONMENT_SET_PROC_ADDRESS_CALLBACK (33)";
-            break;
+    static bool getVariable( Core *core, void *data ) {
+        auto *variable = static_cast<retro_variable *>( data );
+        variable->value = core->variables.value( variable->key );
+        return variable->value != nullptr;
+    }
 
-        case RETRO_ENVIRONMENT_SET_SUBSYSTEM_INFO: // 34
-            qDebug() << "\tRETRO_ENVIRONMENT_SET_SUBSYSTEM_INFO (34)";
-            break;
+    static bool setVariables( Core *core, void *data ) {
+        core->variables.define( static_cast<const retro_variable *>( data ) );
 
-        case RETRO_ENVIRONMENT_SET_CONTROLLER_INFO: // 35
-            qDebug() << "\tRETRO_ENVIRONMENT_SET_CONTROLLER_INFO (35)";
-            break;
+        for( int i = 0; i < core->variables.count(); i++ ) {
+            const CoreVariables::Variable &variable = core->variables.at( i );
+            core->logger.log( RETRO_LOG_DEBUG, "Variable %s: %s", variable.key, variable.description );
+        }
 
-        default:
-            qDebug() << "Error: Environment command " << cmd << " is not defined in the frontend's libretro.h!.";
-            return false;
+        return true;
     }
-    
-    // Command was not handled
-    return false;
-    
-} // Core::environmentCallback()
-
-void Core::inputPollCallback( void ) {
-    // qDebug() << "Core::inputPollCallback";
-    return;
-    
-} // Core::inputPollCallback()
 
-int16_t Core::inputStateCallback( unsigned port, unsigned device, unsigned index, unsigned id ) {
-    Q_UNUSED( index )
+    static bool getVariableUpdate( Core *core, void *data ) {
+        *static_cast<bool *>( data ) = core->variables.takeUpdate();
+        return true;
+    }
 
-    if( static_cast<int>( port ) >= input_manager.getDevices().size() ) {
-        return 0;
+    static bool getLibretroPath( Core *core, void *data ) {
+        *static_cast<const char **>( data ) = core->library_name.constData();
+        return true;
     }
 
-    InputDevice *deviceobj = input_manager.getDevice( port );
+    static bool setFrameTimeCallback( Core *core, void *data ) {
+        // Stored, but the frontend doesn't call it yet
+        core->symbols->retro_frame_time = static_cast<const retro_frame_time_callback *>( data )->callback;
+        return false;
+    }
 
-    // make sure the InputDevice was configured
-    // to map to the requested RETRO_DEVICE.
+    static bool getLogInterface( Core *core, void *data ) {
+        Q_UNUSED( core )
+        static_cast<retro_log_callback *>( data )->log = Core::logCallback;
+        return true;
+    }
 
+    static bool getSaveDirectory( Core *core, void *data ) {
+        *static_cast<const char **>( data ) = core->save_directory.constData();
+        return true;
+    }
 
-    if( deviceobj->mapping()->deviceType() != device ) {
-        return 0;
+    static bool getRumbleInterface( Core *core, void *data ) {
+        Q_UNUSED( core )
+        static_cast<retro_rumble_interface *>( data )->set_rumble_state = Core::rumbleCallback;
+        return true;
     }
+};
 
-    // we don't handle index for now...
-    return deviceobj->state( id );
+bool Core::environmentCallback( unsigned cmd, void *data ) {
+    static const CoreEnvironment environment;
 
-} // Core::inputStateCallback()
+    // The experimental flag doesn't take part in the numbering
+    unsigned index = cmd & ~RETRO_ENVIRONMENT_EXPERIMENTAL;
 
-void Core::logCallback( enum retro_log_level level, const char *fmt, ... ) {
-    QVarLengthArray<char, 1024> outbuf( 1024 );
-    va_list args;
-    va_start( args, fmt );
-    int ret = vsnprintf( outbuf.data(), outbuf.size(), fmt, args );
+    if( index < CoreEnvironment::command_count ) {
+        if( environment.handlers[index] ) {
+            return environment.handlers[index]( core, data );
+        }
+    } else {
+        index = CoreEnvironment::command_count;
+    }
 
-    if( ret < 0 ) {
-        qCDebug( phxCore ) << "logCallback: could not format string";
-        return;
-    } else if( ( ret + 1 ) > outbuf.size() ) {
-        outbuf.resize( ret + 1 );
-        ret = vsnprintf( outbuf.data(), outbuf.size(), fmt, args );
+    // Cores may ask for the same unsupported command every frame, only say it once.
+    // Out of range commands share the last bit.
+    quint64 bit = quint64( 1 ) << qMin( index, CoreEnvironment::command_count - 1 );
 
-        if( ret < 0 ) {
-            qCDebug( phxCore ) << "logCallback: could not format string";
-            return;
-        }
+    if( !( core->unsupported_commands.fetch_or( bit, std::memory_order_relaxed ) & bit ) ) {
+        core->logger.log( RETRO_LOG_DEBUG, "Environment command %u is not supported", cmd );
     }
 
-    va_end( args );
+    return false;
 
-    // remove trailing newline, which are already added by qCDebug
-    if( outbuf.value( ret - 1 ) == '\n' ) {
-        outbuf[ret - 1] = '\0';
+} // Core::environmentCallback()
 
-        if( outbuf.value( ret - 2 ) == '\r' ) {
-            outbuf[ret - 2] = '\0';
-        }
+void Core::inputPollCallback( void ) {
+    // Every inputStateCallback() until the next poll sees this snapshot
+    core->input_polled = true;
+    input_manager.pollDevices();
+
+    if( core->latency_monitor ) {
+        core->latency_monitor->inputLatched( input_manager );
     }
 
-    switch( level ) {
-        case RETRO_LOG_DEBUG:
-            qCDebug( phxCore ) << outbuf.data();
-            break;
+} // Core::inputPollCallback()
 
-        case RETRO_LOG_INFO:
-            qCDebug( phxCore ) << outbuf.data();
-            break;
+int16_t Core::inputStateCallback( unsigned port, unsigned device, unsigned index, unsigned id ) {
+    // From the snapshot taken by the last inputPollCallback()
+    return input_manager.portState( port, device, index, id );
 
-        case RETRO_LOG_WARN:
-            qCWarning( phxCore ) << outbuf.data();
-            break;
+} // Core::inputStateCallback()
 
-        case RETRO_LOG_ERROR:
-            qCCritical( phxCore ) << outbuf.data();
-            break;
+bool Core::rumbleCallback( unsigned port, retro_rumble_effect effect, uint16_t strength ) {
+    // Called from inside of retro_run(), only posts the strength, SDL's thread drives the motors
+    return input_manager.setRumble( port, effect, strength );
 
-        default:
-            qCWarning( phxCore ) << outbuf.data();
-            break;
-    }
+} // Core::rumbleCallback()
+
+void Core::logCallback( enum retro_log_level level, const char *fmt, ... ) {
+    // Formatting and output happen off of the emulation thread, see CoreLogger
+    va_list args;
+    va_start( args, fmt );
+    core->logger.vlog( level, fmt, args );
+    va_end( args );
 
 } // Core::retro_log()
 
@@ -708,6 +642,14 @@ void Core::videoRefreshCallback( const void *data, unsigned width, unsigned heig
     core->video_height = height;
     core->video_pitch = pitch;
 
+    if( core->recorder && core->recorder->isRecording() ) {
+        if( data ) {
+            core->recorder->pushVideoFrame( data, width, height, pitch, core->pixel_format );
+        } else {
+            core->recorder->pushDupeFrame();
+        }
+    }
+
     return;
     
 } // Core::videoRefreshCallback()
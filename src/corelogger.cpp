@@ -0,0 +1,233 @@
+#include <QMutexLocker>
+
+#include <cstdio>
+#include <cstring>
+
+#include "corelogger.h"
+
+// Each logger gets a unique id, so a thread's cached ring can't outlive the logger it came from
+static std::atomic<quint64> next_logger_id( 1 );
+
+struct ThreadRingCache {
+    quint64 logger_id;
+    void *ring;
+};
+
+static thread_local ThreadRingCache thread_ring_cache = { 0, nullptr };
+
+// FNV-1a, only used to spot repeated messages
+static quint32 hashMessage( const char *message ) {
+    quint32 hash = 2166136261u;
+
+    for( ; *message; message++ ) {
+        hash = ( hash ^ quint8( *message ) ) * 16777619u;
+    }
+
+    return hash;
+}
+
+CoreLogger::Ring::Ring()
+    : head( 0 ),
+      tail( 0 ),
+      last_hash( 0 ),
+      tokens_updated( 0 ),
+      tokens( qint64( rate_burst ) * 1000000000 ),
+      pending_repeats( 0 ),
+      dropped_full( 0 ),
+      dropped_rate( 0 ) {
+}
+
+CoreLogger::CoreLogger( QObject *parent )
+    : QObject( parent ),
+      logger_id( next_logger_id.fetch_add( 1 ) ),
+      total_dropped( 0 ),
+      drain_ticks( 0 ) {
+
+    clock.start();
+
+    // Often enough that messages still show up close to when they were logged
+    drain_timer.setInterval( 20 );
+
+    this->moveToThread( &drain_thread );
+    drain_timer.moveToThread( &drain_thread );
+    connect( &drain_timer, &QTimer::timeout, this, &CoreLogger::slotDrain );
+    connect( &drain_thread, &QThread::started, &drain_timer, static_cast<void ( QTimer::* )( void )>( &QTimer::start ) );
+
+    // finished is emitted from the thread itself, a timer can only be stopped from its own thread
+    connect( &drain_thread, &QThread::finished, &drain_timer, &QTimer::stop, Qt::DirectConnection );
+    drain_thread.setObjectName( "phoenix-log" );
+
+    drain_thread.start( QThread::LowPriority );
+}
+
+CoreLogger::~CoreLogger() {
+    drain_thread.quit();
+    drain_thread.wait();
+
+    // Whatever was logged after the last tick
+    drain( true );
+}
+
+CoreLogger::Ring *CoreLogger::threadRing() {
+    ThreadRingCache &cache = thread_ring_cache;
+
+    if( cache.logger_id == logger_id ) {
+        return static_cast<Ring *>( cache.ring );
+    }
+
+    // First message from this thread
+    Ring *ring = new Ring;
+    ring->tokens_updated = clock.nsecsElapsed();
+    {
+        QMutexLocker lock( &rings_mutex );
+        rings.emplace_back( ring );
+    }
+
+    cache.logger_id = logger_id;
+    cache.ring = ring;
+    return ring;
+}
+
+bool CoreLogger::takeToken( Ring *ring, qint64 now ) {
+    const qint64 cost = 1000000000;
+    const qint64 capacity = qint64( rate_burst ) * cost;
+
+    ring->tokens = qMin( capacity, ring->tokens + ( now - ring->tokens_updated ) * rate_limit );
+    ring->tokens_updated = now;
+
+    if( ring->tokens < cost ) {
+        return false;
+    }
+
+    ring->tokens -= cost;
+    return true;
+}
+
+void CoreLogger::log( retro_log_level level, const char *fmt, ... ) {
+    va_list args;
+    va_start( args, fmt );
+    vlog( level, fmt, args );
+    va_end( args );
+}
+
+void CoreLogger::vlog( retro_log_level level, const char *fmt, va_list args ) {
+    Ring *ring = threadRing();
+    qint64 now = clock.nsecsElapsed();
+
+    // Checked before formatting, a core flooding the log shouldn't pay for messages nobody will see
+    if( !takeToken( ring, now ) ) {
+        ring->dropped_rate.fetch_add( 1, std::memory_order_relaxed );
+        total_dropped.fetch_add( 1, std::memory_order_relaxed );
+        return;
+    }
+
+    unsigned head = ring->head.load( std::memory_order_relaxed );
+    bool full = head - ring->tail.load( std::memory_order_acquire ) >= entry_count;
+
+    Entry &entry = ring->entries[head & ( entry_count - 1 )];
+
+    // When the ring is full, the message is only formatted to be compared with the last one,
+    // the drainer still owns the slot. Repeats get folded either way.
+    char overflow[message_size];
+    char *message = full ? overflow : entry.message;
+
+    // Formatted straight into the slot, longer messages get truncated
+    int length = vsnprintf( message, message_size, fmt, args );
+
+    if( length < 0 ) {
+        strcpy( message, "(could not format message)" );
+        length = int( strlen( message ) );
+    } else if( size_t( length ) >= message_size ) {
+        length = message_size - 1;
+        memcpy( message + length - 3, "...", 3 );
+    }
+
+    // Trailing newlines are already added by the logging framework
+    while( length > 0 && ( message[length - 1] == '\n' || message[length - 1] == '\r' ) ) {
+        message[--length] = '\0';
+    }
+
+    quint32 hash = hashMessage( message );
+
+    if( hash == ring->last_hash && head != 0 ) {
+        ring->pending_repeats.fetch_add( 1, std::memory_order_relaxed );
+        return;
+    }
+
+    if( full ) {
+        ring->dropped_full.fetch_add( 1, std::memory_order_relaxed );
+        total_dropped.fetch_add( 1, std::memory_order_relaxed );
+        return;
+    }
+
+    ring->last_hash = hash;
+    entry.level = level;
+    entry.timestamp = now;
+    entry.repeats = ring->pending_repeats.exchange( 0, std::memory_order_relaxed );
+
+    ring->head.store( head + 1, std::memory_order_release );
+}
+
+void CoreLogger::slotDrain() {
+    // Statistics are only reported about once per second
+    drain( ++drain_ticks % 50 == 0 );
+}
+
+void CoreLogger::drain( bool report ) {
+    QMutexLocker lock( &rings_mutex );
+
+    for( auto &ring : rings ) {
+        unsigned tail = ring->tail.load( std::memory_order_relaxed );
+        unsigned head = ring->head.load( std::memory_order_acquire );
+
+        for( ; tail != head; tail++ ) {
+            const Entry &entry = ring->entries[tail & ( entry_count - 1 )];
+
+            if( entry.repeats ) {
+                qCDebug( phxCore, "(previous message repeated %u times)", entry.repeats );
+            }
+
+            print( entry.level, entry.timestamp, entry.message );
+
+            ring->tail.store( tail + 1, std::memory_order_release );
+        }
+
+        if( !report ) {
+            continue;
+        }
+
+        quint32 repeats = ring->pending_repeats.exchange( 0, std::memory_order_relaxed );
+
+        if( repeats ) {
+            qCDebug( phxCore, "(previous message repeated %u times)", repeats );
+        }
+
+        quint64 full = ring->dropped_full.exchange( 0, std::memory_order_relaxed );
+        quint64 rate = ring->dropped_rate.exchange( 0, std::memory_order_relaxed );
+
+        if( full || rate ) {
+            qCWarning( phxCore, "Core log: dropped %llu messages (%llu over the rate limit, %llu with a full queue)",
+                       full + rate, rate, full );
+        }
+    }
+}
+
+void CoreLogger::print( retro_log_level level, qint64 timestamp, const char *message ) {
+    double seconds = timestamp / 1000000000.0;
+
+    switch( level ) {
+        case RETRO_LOG_WARN:
+            qCWarning( phxCore, "[%.3f] %s", seconds, message );
+            break;
+
+        case RETRO_LOG_ERROR:
+            qCCritical( phxCore, "[%.3f] %s", seconds, message );
+            break;
+
+        case RETRO_LOG_DEBUG:
+        case RETRO_LOG_INFO:
+        default:
+            qCDebug( phxCore, "[%.3f] %s", seconds, message );
+            break;
+    }
+}
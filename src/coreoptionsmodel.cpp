@@ -0,0 +1,153 @@
+#include <QSettings>
+
+#include "coreoptionsmodel.h"
+#include "logging.h"
+
+CoreOptionsModel::CoreOptionsModel( QObject *parent )
+    : QAbstractListModel( parent ),
+      variables( nullptr ) {
+}
+
+QString CoreOptionsModel::settingsGroup( QString core_name, QString game_name ) {
+    QString group = "core_options/" + core_name;
+
+    if( !game_name.isEmpty() ) {
+        group += "/" + game_name;
+    }
+
+    return group;
+}
+
+QHash<QByteArray, QByteArray> CoreOptionsModel::savedValues( QString core_name, QString game_name ) {
+    QHash<QByteArray, QByteArray> values;
+    QSettings s;
+
+    for( const QString &group : { settingsGroup( core_name ), settingsGroup( core_name, game_name ) } ) {
+        s.beginGroup( group );
+
+        // childKeys() skips the per game subgroups
+        for( const QString &key : s.childKeys() ) {
+            values[key.toUtf8()] = s.value( key ).toString().toUtf8();
+        }
+
+        s.endGroup();
+    }
+
+    return values;
+}
+
+void CoreOptionsModel::reload( CoreVariables *variables, QString core_name, QString game_name ) {
+    beginResetModel();
+    this->variables = variables;
+    m_core_name = core_name;
+    m_game_name = game_name;
+    endResetModel();
+
+    emit countChanged();
+}
+
+int CoreOptionsModel::rowCount( const QModelIndex &parent ) const {
+    if( parent.isValid() || !variables ) {
+        return 0;
+    }
+
+    return variables->count();
+}
+
+QVariant CoreOptionsModel::data( const QModelIndex &index, int role ) const {
+    if( !variables || !index.isValid() || index.row() >= variables->count() ) {
+        return QVariant();
+    }
+
+    const CoreVariables::Variable &variable = variables->at( index.row() );
+
+    switch( role ) {
+        case KeyRole:
+            return QString::fromUtf8( variable.key );
+
+        case Qt::DisplayRole:
+        case DescriptionRole:
+            return QString::fromUtf8( variable.description );
+
+        case ChoicesRole: {
+            QStringList choices;
+
+            for( const char *choice : variable.choices ) {
+                choices.append( QString::fromUtf8( choice ) );
+            }
+
+            return choices;
+        }
+
+        case ValueRole:
+            return QString::fromUtf8( variables->stagedValue( index.row() ) );
+
+        case ValueIndexRole: {
+            const char *value = variables->stagedValue( index.row() );
+
+            // Values always point into the choices, no need to compare the strings
+            for( size_t i = 0; i < variable.choices.size(); i++ ) {
+                if( variable.choices[i] == value ) {
+                    return int( i );
+                }
+            }
+
+            return -1;
+        }
+
+        default:
+            return QVariant();
+    }
+}
+
+QHash<int, QByteArray> CoreOptionsModel::roleNames() const {
+    QHash<int, QByteArray> roles;
+    roles[KeyRole] = "key";
+    roles[DescriptionRole] = "description";
+    roles[ChoicesRole] = "choices";
+    roles[ValueRole] = "value";
+    roles[ValueIndexRole] = "valueIndex";
+    return roles;
+}
+
+bool CoreOptionsModel::setValue( int row, QString value ) {
+    if( !variables || row < 0 || row >= variables->count() ) {
+        return false;
+    }
+
+    const char *key = variables->at( row ).key;
+    QByteArray utf8_value = value.toUtf8();
+
+    if( !variables->setValue( key, utf8_value.constData() ) ) {
+        qCWarning( phxCore ) << "Invalid value" << value << "for core option" << key;
+        return false;
+    }
+
+    QSettings s;
+    s.beginGroup( settingsGroup( m_core_name, m_game_name ) );
+    s.setValue( QString::fromUtf8( key ), value );
+    s.endGroup();
+
+    QModelIndex model_index = index( row );
+    emit dataChanged( model_index, model_index, { ValueRole, ValueIndexRole } );
+    return true;
+}
+
+void CoreOptionsModel::saveAsCoreDefaults() {
+    if( !variables ) {
+        return;
+    }
+
+    QSettings s;
+    s.beginGroup( settingsGroup( m_core_name ) );
+
+    for( int i = 0; i < variables->count(); i++ ) {
+        const char *value = variables->stagedValue( i );
+
+        if( value ) {
+            s.setValue( QString::fromUtf8( variables->at( i ).key ), QString::fromUtf8( value ) );
+        }
+    }
+
+    s.endGroup();
+}
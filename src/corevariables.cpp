@@ -0,0 +1,200 @@
+#include <cstring>
+
+#include "corevariables.h"
+
+CoreVariables::CoreVariables()
+    : staged_changed( false ),
+      updated( false ) {
+}
+
+quint32 CoreVariables::hash( const char *key ) {
+    // FNV-1a
+    quint32 hash = 2166136261u;
+
+    for( ; *key; key++ ) {
+        hash = ( hash ^ quint8( *key ) ) * 16777619u;
+    }
+
+    return hash;
+}
+
+const char *CoreVariables::intern( const QByteArray &string ) {
+    // Choices such as "enabled|disabled" repeat a lot, share them
+    const char *&data = interned[string];
+
+    if( !data ) {
+        strings.append( string );
+        data = strings.last().constData();
+    }
+
+    return data;
+}
+
+void CoreVariables::setOverrides( const QHash<QByteArray, QByteArray> &overrides ) {
+    QMutexLocker lock( &staged_mutex );
+    m_overrides = overrides;
+
+    // Most cores declare their variables in retro_set_environment(), before any game is loaded
+    for( auto it = overrides.constBegin(); it != overrides.constEnd(); ++it ) {
+        int index = find( it.key().constData() );
+        const char *value = index != -1 ? choice( index, it.value().constData() ) : nullptr;
+
+        if( value ) {
+            active[index] = staged[index] = value;
+        }
+    }
+}
+
+void CoreVariables::define( const retro_variable *new_variables ) {
+    // Keeps the UI from reading a half built list
+    QMutexLocker lock( &staged_mutex );
+
+    variables.clear();
+    strings.clear();
+    interned.clear();
+
+    for( ; new_variables && new_variables->key; new_variables++ ) {
+        std::unique_ptr<Variable> variable( new Variable );
+        variable->key = intern( new_variables->key );
+
+        // "Text before first ';' is description. This ';' must be followed by a space,
+        // and followed by a list of possible values split up with '|'."
+        QByteArray value( new_variables->value ? new_variables->value : "" );
+        int split = value.indexOf( "; " );
+
+        if( split != -1 ) {
+            variable->description = intern( value.left( split ) );
+
+            for( const QByteArray &choice : value.mid( split + 2 ).split( '|' ) ) {
+                variable->choices.push_back( intern( choice ) );
+            }
+        } else {
+            variable->description = intern( value );
+        }
+
+        variables.push_back( std::move( variable ) );
+    }
+
+    interned.clear();
+
+    // At most half full, so probes stay short
+    size_t size = 16;
+
+    while( size < variables.size() * 2 ) {
+        size *= 2;
+    }
+
+    table.assign( size, Slot{ 0, -1 } );
+
+    for( size_t i = 0; i < variables.size(); i++ ) {
+        quint32 h = hash( variables[i]->key );
+        size_t index = h & ( size - 1 );
+
+        while( table[index].index != -1 ) {
+            index = ( index + 1 ) & ( size - 1 );
+        }
+
+        table[index] = Slot{ h, int( i ) };
+    }
+
+    active.assign( variables.size(), nullptr );
+
+    for( size_t i = 0; i < variables.size(); i++ ) {
+        const Variable &variable = *variables[i];
+        auto override = m_overrides.constFind( variable.key );
+
+        if( override != m_overrides.constEnd() ) {
+            active[i] = choice( int( i ), override->constData() );
+        }
+
+        if( !active[i] && !variable.choices.empty() ) {
+            active[i] = variable.choices.front();
+        }
+    }
+
+    staged = active;
+    staged_changed = false;
+    updated = false;
+}
+
+int CoreVariables::find( const char *key ) const {
+    if( !key || table.empty() ) {
+        return -1;
+    }
+
+    quint32 h = hash( key );
+    size_t mask = table.size() - 1;
+
+    for( size_t index = h & mask; table[index].index != -1; index = ( index + 1 ) & mask ) {
+        const Slot &slot = table[index];
+
+        if( slot.hash == h ) {
+            if( strcmp( variables[slot.index]->key, key ) == 0 ) {
+                return slot.index;
+            }
+        }
+    }
+
+    return -1;
+}
+
+const char *CoreVariables::choice( int index, const char *value ) const {
+    for( const char *choice : variables[index]->choices ) {
+        if( strcmp( choice, value ) == 0 ) {
+            return choice;
+        }
+    }
+
+    return nullptr;
+}
+
+const char *CoreVariables::value( const char *key ) const {
+    int index = find( key );
+    return index != -1 ? active[index] : nullptr;
+}
+
+void CoreVariables::latch() {
+    if( !staged_changed.load( std::memory_order_acquire ) ) {
+        return;
+    }
+
+    // Never wait on the UI, try again next frame
+    if( !staged_mutex.tryLock() ) {
+        return;
+    }
+
+    if( staged != active ) {
+        // Same size, neither the swap nor the copy allocate
+        active.swap( staged );
+        staged = active;
+        updated.store( true, std::memory_order_release );
+    }
+
+    staged_changed.store( false, std::memory_order_relaxed );
+    staged_mutex.unlock();
+}
+
+bool CoreVariables::setValue( const char *key, const char *value ) {
+    QMutexLocker lock( &staged_mutex );
+
+    int index = find( key );
+
+    if( index == -1 || !value ) {
+        return false;
+    }
+
+    const char *new_value = choice( index, value );
+
+    if( !new_value ) {
+        return false;
+    }
+
+    staged[index] = new_value;
+    staged_changed.store( true, std::memory_order_release );
+    return true;
+}
+
+const char *CoreVariables::stagedValue( int index ) const {
+    QMutexLocker lock( &staged_mutex );
+    return index >= 0 && index < int( staged.size() ) ? staged[index] : nullptr;
+}
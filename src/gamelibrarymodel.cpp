@@ -137,6 +137,11 @@ QSqlQuery GameLibraryModel::executeQuery( QString query, QVariantList args ) {
     return q;
 }
 
+bool GameLibraryModel::setFallbackArtwork( QString filename, QString artwork ) {
+    return submitQuery( "UPDATE " + LibraryDbManager::table_games + " SET artwork = ? WHERE filename = ?"
+                        " AND (artwork IS NULL OR artwork = '')", QVariantList { artwork, filename } );
+}
+
 bool GameLibraryModel::submitQuery( QString query ) {
     // -100 is chosen just to keep the query always true;
     if( executeQuery( query ).size() > -100 ) {
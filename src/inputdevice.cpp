@@ -1,11 +1,18 @@
 
+#include <QMetaMethod>
+
 #include "inputdevice.h"
 #include "inputdevicemapping.h"
 
 
 InputDevice::InputDevice( InputDeviceMapping *mapping )
     : m_mapping( mapping ),
-      ids_state() {
+      buttons( 0 ),
+      last_event_time( 0 ) {
+
+    for( auto &axis : analog ) {
+        axis.store( 0, std::memory_order_relaxed );
+    }
 }
 
 InputDevice::~InputDevice() {
@@ -16,6 +23,12 @@ void InputDevice::setDeviceName( const char *new_name ) {
     device_name = QString( new_name );
 }
 
+bool InputDevice::isCapturing() const {
+    // Cheap, it only checks a bitmap of connected signals
+    static const QMetaMethod signal = QMetaMethod::fromSignal( &InputDevice::inputEventReceived );
+    return isSignalConnected( signal );
+}
+
 void InputDevice::deleteEventPtr( InputDeviceEvent *ev ) {
     if( ev ) {
         delete ev;
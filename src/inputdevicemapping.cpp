@@ -5,6 +5,9 @@
 #include <QRegExp>
 
 
+// Passed by reference to std::fill()
+const retro_device_id InputDeviceMapping::unmapped;
+
 InputDeviceMapping::InputDeviceMapping() {
     device_type = RETRO_DEVICE_NONE;
 
@@ -18,12 +21,25 @@ bool InputDeviceMapping::populateFromSettings( QSettings &s ) {
     // retro device type
     QString device_type = s.value( "device_type" ).toString();
 
-    if( device_type != "joypad" ) {
-        // TODO: only supported type for now
+    if( device_type == "joypad" ) {
+        setDeviceType( RETRO_DEVICE_JOYPAD );
+    } else if( device_type == "analog" ) {
+        setDeviceType( RETRO_DEVICE_ANALOG );
+    } else {
+        // TODO: only supported types for now
         return false;
     }
 
-    setDeviceType( RETRO_DEVICE_JOYPAD );
+    // Deadzones and sensitivities are fractions of the full range, curves are exponents
+    stick_responses[0].setResponse( s.value( "analog_left_deadzone", 0.15 ).toDouble(),
+                                    s.value( "analog_left_curve", 1.0 ).toDouble(),
+                                    s.value( "analog_left_sensitivity", 1.0 ).toDouble() );
+    stick_responses[1].setResponse( s.value( "analog_right_deadzone", 0.15 ).toDouble(),
+                                    s.value( "analog_right_curve", 1.0 ).toDouble(),
+                                    s.value( "analog_right_sensitivity", 1.0 ).toDouble() );
+    trigger_response.setResponse( s.value( "trigger_deadzone", 0.05 ).toDouble(),
+                                  s.value( "trigger_curve", 1.0 ).toDouble(),
+                                  s.value( "trigger_sensitivity", 1.0 ).toDouble() );
 
     auto *map = settings_mappings.value( device_type );
 
@@ -96,11 +112,13 @@ DeviceMap *InputDeviceMapping::mappings() {
 
 void InputDeviceMapping::setMapping( const InputDeviceEvent *ev, retro_device_id id ) {
     mapping[ev->clone()] = id;
+    compileMapping();
 }
 
 
 void InputDeviceMapping::setMapping( const InputDeviceEvent *ev, const retro_device_id id, const unsigned port ) {
     mapping[ev->clone()] = id;
+    compileMapping();
 
     //delete ev;
 
@@ -11,12 +11,16 @@
 #include "inputdevicemappingfactory.h"
 
 
+// Passed by reference to qMin()
+const unsigned InputManager::max_ports;
+
 InputManager::InputManager() {
     top_window = nullptr;
     settings_window = nullptr;
     m_context = nullptr;
     m_attach_devices = false;
     m_finding_devices = false;
+    port_count = 0;
 
 }
 
@@ -97,6 +101,33 @@ QList<InputDevice *> InputManager::getDevices() const {
     return devices;
 }
 
+void InputManager::pollDevices() {
+    // Events are handled as they come, by SDL's thread and by Qt's, there's nothing to pump here.
+    // Only bumps a reference count, the list itself isn't copied
+    const QList<InputDevice *> current_devices = devices;
+    unsigned count = qMin<unsigned>( current_devices.size(), max_ports );
+
+    for( unsigned port = 0; port < count; port++ ) {
+        InputDevice *device = current_devices.at( port );
+        retro_device_type type = device->mapping()->deviceType();
+        ports[port].device_type = type == RETRO_DEVICE_ANALOG ? RETRO_DEVICE_JOYPAD : type;
+
+        // Before the state, so the snapshot includes at least that event
+        ports[port].event_time = device->lastEventTime();
+        ports[port].state = device->snapshot();
+        ports[port].device = device;
+    }
+
+    port_count = count;
+}
+
+void InputManager::stopRumble() {
+    for( auto *device : devices ) {
+        device->setRumble( RETRO_RUMBLE_STRONG, 0 );
+        device->setRumble( RETRO_RUMBLE_WEAK, 0 );
+    }
+}
+
 void InputManager::scanDevicesAsync() {
     QFuture<void> fut = QtConcurrent::run( this, &InputManager::scanDevices );
     Q_UNUSED( fut )
@@ -149,6 +180,9 @@ void InputManager::scanJoysticks() {
             s.beginGroup( "input" );
             s.beginGroup( QString( "port%1" ).arg( current_port ) );
             s.setValue( "input_driver", "sdl_joystick" );
+
+            // The left stick emulates the d-pad, which every core understands.
+            // "analog" sends the sticks to the core instead, for the ones that ask for them.
             s.setValue( "device_type", "joypad" );
 
             s.setValue( "joypad_a", "a" );
@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <functional>
 #include <QMap>
 #include <QPair>
@@ -11,16 +12,36 @@
 
 static SDLEvents sdl_events;
 
+// Runs on SDL's timer thread and only posts an event, the joystick may be gone by the time it's handled
+static Uint32 refreshRumble( Uint32 interval, void *param ) {
+    sdl_events.postRumble( static_cast<SDL_JoystickID>( reinterpret_cast<intptr_t>( param ) ) );
+    return interval;
+}
+
 
 Joystick::Joystick( InputDeviceMapping *mapping ) : InputDevice( mapping ) {
     device_attached = false;
     joystick = nullptr;
     controller = nullptr;
     m_deadzone = 20000;
+
+    instance_id = -1;
+    rumble_requested = 0;
+    rumble_posted = false;
+    rumble_applied = 0;
+    rumble_applied_at = 0;
+    rumble_timer = 0;
+    haptic = nullptr;
+    haptic_unsupported = false;
+
+    for( auto &value : raw_axes ) {
+        value = 0;
+    }
+
     m_mapping = reinterpret_cast<Mapping *>( InputDevice::m_mapping );
     Q_ASSERT( m_mapping != nullptr );
 
-    callback = std::bind( &Joystick::handleSDLEvent, this, std::placeholders::_1 );
+    callback = std::bind( &Joystick::handleSDLEvent, this, std::placeholders::_1, std::placeholders::_2 );
     sdl_events.registerCallback( &callback );
 
     for( int i = 0; i < SDL_NumJoysticks(); i++ ) {
@@ -41,6 +62,26 @@ Joystick::Joystick( InputDeviceMapping *mapping ) : InputDevice( mapping ) {
 Joystick::~Joystick() {
     auto l = sdl_events.lockSDL();
     sdl_events.removeCallback( &callback );
+    closeDevice();
+}
+
+void Joystick::closeDevice() {
+    SDL_Joystick *opened = openedJoystick();
+
+    if( opened ) {
+        sdl_events.removeInstance( SDL_JoystickInstanceID( opened ), &callback );
+    }
+
+    instance_id = -1;
+    stopRumbleTimer();
+
+    // Stops whatever effect is playing
+    if( haptic ) {
+        SDL_HapticClose( haptic );
+        haptic = nullptr;
+    }
+
+    haptic_unsupported = false;
 
     if( controller ) {
         SDL_GameControllerClose( controller );
@@ -50,6 +91,7 @@ Joystick::~Joystick() {
 
     joystick = nullptr;
     controller = nullptr;
+    device_attached = false;
 }
 
 void Joystick::setDeadZone( int threashHold ) {
@@ -104,6 +146,7 @@ bool Joystick::attachJoystick( int which ) {
     }
 
     setDeviceName( SDL_JoystickName( joystick ) );
+    registerInstance( joystick );
     device_attached = true;
     return true;
 }
@@ -119,10 +162,22 @@ bool Joystick::attachGameController( int which ) {
     }
 
     setDeviceName( SDL_GameControllerName( controller ) );
+    registerInstance( SDL_GameControllerGetJoystick( controller ) );
     device_attached = true;
     return true;
 }
 
+void Joystick::registerInstance( SDL_Joystick *opened ) {
+    SDL_JoystickID instance = SDL_JoystickInstanceID( opened );
+
+    // A new device starts still, rumble the core asks for from now on is applied to it
+    rumble_applied = 0;
+    rumble_requested = 0;
+    rumble_posted = false;
+    sdl_events.registerInstance( instance, &callback );
+    instance_id = instance;
+}
+
 bool Joystick::deviceAdded( const SDL_Event *event ) {
     int which = event->type == SDL_CONTROLLERDEVICEADDED ? event->cdevice.which
                 : event->jdevice.which;
@@ -149,15 +204,11 @@ bool Joystick::deviceAdded( const SDL_Event *event ) {
 bool Joystick::deviceRemoved( const SDL_Event *event ) {
     if( event->type == SDL_CONTROLLERDEVICEREMOVED
         && ControllerMatchEvent( event->cdevice ) ) {
-        SDL_GameControllerClose( controller );
-        controller = nullptr;
-        device_attached = false;
+        closeDevice();
         qCDebug( phxInput ) << "Controller removed";
         return true;
     } else if( JoystickMatchEvent( event->jdevice ) ) {
-        SDL_JoystickClose( joystick );
-        joystick = nullptr;
-        device_attached = false;
+        closeDevice();
         qCDebug( phxInput ) << "Joystick removed";
         return true;
     }
@@ -171,14 +222,15 @@ bool Joystick::controllerButtonChanged( const SDL_Event *event ) {
     }
 
     const SDL_ControllerButtonEvent *cbutton = &event->cbutton;
-    auto ev = ControllerButtonEvent::fromSDLEvent( *cbutton );
     bool is_pressed = ( cbutton->type == SDL_CONTROLLERBUTTONDOWN || cbutton->type == SDL_JOYBUTTONDOWN ) ? true : false;
 
-    emit inputEventReceived( new ControllerButtonEvent( ev ), is_pressed );
+    if( isCapturing() ) {
+        emit inputEventReceived( new ControllerButtonEvent( ControllerButtonEvent::fromSDLEvent( *cbutton ) ), is_pressed );
+    }
 
-    auto retro_id = m_mapping->getMapping( &ev );
+    auto retro_id = m_mapping->buttonMapping( cbutton->button );
 
-    if( retro_id != ( unsigned )~0 ) {
+    if( retro_id != InputDeviceMapping::unmapped ) {
         setState( retro_id, is_pressed );
     }
 
@@ -190,12 +242,21 @@ bool Joystick::controllerAxisChanged( const SDL_Event *event ) {
         return false;
     }
 
+    // Game controllers send every axis twice, once as a joystick with the raw axis numbers
+    if( event->type == SDL_JOYAXISMOTION && controller ) {
+        return false;
+    }
+
     const SDL_ControllerAxisEvent *caxis = &event->caxis;
     auto ev = ControllerAxisEvent::fromSDLEvent( *caxis );
+    AnalogAxis analog_axis;
 
-    if( caxis->value < 0 && caxis->value < -deadZone() ) {
-        emit inputEventReceived( new ControllerAxisEvent( ev ), caxis->value );
-    } else if( caxis->value > 0 && caxis->value > deadZone() ) {
+    if( event->type != SDL_JOYHATMOTION && analogAxis( event, &analog_axis ) ) {
+        updateAnalog( analog_axis, caxis->value );
+    }
+
+    // Axes send a flood of events, most of them inside of the dead zone
+    if( ( caxis->value < -deadZone() || caxis->value > deadZone() ) && isCapturing() ) {
         emit inputEventReceived( new ControllerAxisEvent( ev ), caxis->value );
     }
 
@@ -228,7 +289,191 @@ bool Joystick::controllerAxisChanged( const SDL_Event *event ) {
     return true;
 }
 
-bool Joystick::handleSDLEvent( const SDL_Event *event ) {
+bool Joystick::analogAxis( const SDL_Event *event, AnalogAxis *axis ) const {
+    if( event->type == SDL_CONTROLLERAXISMOTION ) {
+        switch( event->caxis.axis ) {
+            case SDL_CONTROLLER_AXIS_LEFTX:
+                *axis = LeftX;
+                return true;
+
+            case SDL_CONTROLLER_AXIS_LEFTY:
+                *axis = LeftY;
+                return true;
+
+            case SDL_CONTROLLER_AXIS_RIGHTX:
+                *axis = RightX;
+                return true;
+
+            case SDL_CONTROLLER_AXIS_RIGHTY:
+                *axis = RightY;
+                return true;
+
+            case SDL_CONTROLLER_AXIS_TRIGGERLEFT:
+                *axis = TriggerL2;
+                return true;
+
+            case SDL_CONTROLLER_AXIS_TRIGGERRIGHT:
+                *axis = TriggerR2;
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    // Plain joysticks have no known layout, assume the first four axes are two sticks
+    if( event->jaxis.axis < stick_axis_count ) {
+        *axis = static_cast<AnalogAxis>( event->jaxis.axis );
+        return true;
+    }
+
+    return false;
+}
+
+void Joystick::updateAnalog( AnalogAxis axis, int16_t value ) {
+    raw_axes[axis] = value;
+
+    if( axis == TriggerL2 || axis == TriggerR2 ) {
+        int16_t trigger = m_mapping->triggerResponse().applyTrigger( value );
+        setAnalogState( axis, trigger );
+
+        // Cores that only know about digital buttons get a press past half way
+        setState( axis == TriggerL2 ? RETRO_DEVICE_ID_JOYPAD_L2 : RETRO_DEVICE_ID_JOYPAD_R2, trigger > 16384 );
+        return;
+    }
+
+    // Sticks only feed the core on analog ports, joypad ports emulate the d-pad with them instead
+    if( m_mapping->deviceType() != RETRO_DEVICE_ANALOG ) {
+        return;
+    }
+
+    unsigned stick = axis / 2;
+    int16_t x, y;
+    m_mapping->stickResponse( stick ).applyStick( raw_axes[stick * 2], raw_axes[stick * 2 + 1], &x, &y );
+    setAnalogState( static_cast<AnalogAxis>( stick * 2 ), x );
+    setAnalogState( static_cast<AnalogAxis>( stick * 2 + 1 ), y );
+}
+
+bool Joystick::setRumble( retro_rumble_effect effect, uint16_t strength ) {
+    if( effect != RETRO_RUMBLE_STRONG && effect != RETRO_RUMBLE_WEAK ) {
+        return false;
+    }
+
+    SDL_JoystickID instance = instance_id.load( std::memory_order_relaxed );
+
+    if( instance < 0 ) {
+        return false;
+    }
+
+    unsigned shift = effect == RETRO_RUMBLE_STRONG ? 16 : 0;
+    quint32 requested = rumble_requested.load( std::memory_order_relaxed );
+    quint32 updated;
+
+    do {
+        updated = ( requested & ~( 0xffffu << shift ) ) | ( quint32( strength ) << shift );
+
+        // Cores tend to set the same strength on every frame
+        if( updated == requested ) {
+            return true;
+        }
+    } while( !rumble_requested.compare_exchange_weak( requested, updated ) );
+
+    // One event is enough for any number of updates, the SDL thread reads the latest strengths
+    if( !rumble_posted.exchange( true ) && !sdl_events.postRumble( instance ) ) {
+        rumble_posted = false;
+    }
+
+    return true;
+}
+
+void Joystick::applyRumble() {
+    // Cleared first, updates made from now on post another event
+    rumble_posted = false;
+    quint32 requested = rumble_requested;
+    SDL_Joystick *opened = openedJoystick();
+
+    if( !opened ) {
+        return;
+    }
+
+    // The same strengths again only matter when the timer says SDL's duration is running out
+    if( requested == rumble_applied && ( !rumble_timer || !SDL_TICKS_PASSED( SDL_GetTicks(), rumble_applied_at + rumble_refresh / 2 ) ) ) {
+        return;
+    }
+
+    Uint16 strong = requested >> 16;
+    Uint16 weak = requested & 0xffff;
+
+#if SDL_VERSION_ATLEAST( 2, 0, 9 )
+    // Both motors, on the devices SDL knows how to rumble
+    int ret = controller ? SDL_GameControllerRumble( controller, strong, weak, rumble_duration )
+              : SDL_JoystickRumble( opened, strong, weak, rumble_duration );
+
+    if( ret == 0 ) {
+        rumble_applied = requested;
+        rumble_applied_at = SDL_GetTicks();
+
+        if( !requested ) {
+            stopRumbleTimer();
+        } else if( !rumble_timer ) {
+            SDL_JoystickID instance = SDL_JoystickInstanceID( opened );
+            rumble_timer = SDL_AddTimer( rumble_refresh, refreshRumble, reinterpret_cast<void *>( intptr_t( instance ) ) );
+
+            if( !rumble_timer ) {
+                qCDebug( phxInput, "Joystick: %s rumble will stop after %us: %s", qPrintable( deviceName() ),
+                         rumble_duration / 1000, SDL_GetError() );
+            }
+        }
+
+        return;
+    }
+
+#endif
+
+    if( !haptic && !haptic_unsupported ) {
+        haptic = SDL_HapticOpenFromJoystick( opened );
+
+        if( !haptic || SDL_HapticRumbleInit( haptic ) < 0 ) {
+            qCDebug( phxInput, "Joystick: %s can't rumble: %s", qPrintable( deviceName() ), SDL_GetError() );
+
+            if( haptic ) {
+                SDL_HapticClose( haptic );
+                haptic = nullptr;
+            }
+
+            haptic_unsupported = true;
+        }
+    }
+
+    // Nothing to retry, the device won't rumble
+    rumble_applied = requested;
+
+    if( !haptic ) {
+        return;
+    }
+
+    // The simple rumble API only drives one strength, the strongest of both motors
+    if( requested == 0 ) {
+        SDL_HapticRumbleStop( haptic );
+    } else {
+        SDL_HapticRumblePlay( haptic, qMax( strong, weak ) / 65535.0f, SDL_HAPTIC_INFINITY );
+    }
+}
+
+void Joystick::stopRumbleTimer() {
+    if( rumble_timer ) {
+        SDL_RemoveTimer( rumble_timer );
+        rumble_timer = 0;
+    }
+}
+
+bool Joystick::handleSDLEvent( const SDL_Event *event, qint64 timestamp ) {
+    // Not a constant, SDL hands out the type when the thread starts
+    if( event->type == sdl_events.rumbleEventType() ) {
+        applyRumble();
+        return true;
+    }
+
     switch( event->type ) {
         case SDL_CONTROLLERDEVICEADDED:
         case SDL_JOYDEVICEADDED:
@@ -250,6 +495,7 @@ bool Joystick::handleSDLEvent( const SDL_Event *event ) {
         case SDL_JOYBUTTONUP:
         case SDL_CONTROLLERBUTTONDOWN:
         case SDL_CONTROLLERBUTTONUP:
+            markEvent( timestamp );
             controllerButtonChanged( event );
             break;
 
@@ -257,6 +503,7 @@ bool Joystick::handleSDLEvent( const SDL_Event *event ) {
         case SDL_JOYAXISMOTION:
         case SDL_JOYHATMOTION:
         case SDL_CONTROLLERAXISMOTION:
+            markEvent( timestamp );
             controllerAxisChanged( event );
             break;
     }
@@ -264,6 +511,35 @@ bool Joystick::handleSDLEvent( const SDL_Event *event ) {
     return false;
 }
 
+Joystick::Mapping::Mapping() : joystick_guid() {
+    for( auto &id : button_table ) {
+        id.store( unmapped, std::memory_order_relaxed );
+    }
+}
+
+void Joystick::Mapping::compileMapping() {
+    retro_device_id table[button_table_size];
+    std::fill( table, table + button_table_size, unmapped );
+
+    for( const auto &m : *mappings() ) {
+        if( m.first->type() != int( input_event_type_id<ControllerButtonEvent>() ) ) {
+            continue;
+        }
+
+        unsigned button = static_cast<const ControllerButtonEvent *>( m.first )->event();
+
+        // SDL_CONTROLLER_BUTTON_INVALID wraps around
+        if( button < button_table_size ) {
+            table[button] = m.second;
+        }
+    }
+
+    // The SDL thread keeps reading while the mapping gets edited, each entry is swapped on its own
+    for( unsigned i = 0; i < button_table_size; i++ ) {
+        button_table[i].store( table[i], std::memory_order_relaxed );
+    }
+}
+
 QVariant Joystick::Mapping::setMappingOnInput( retro_device_id id, QJSValue cb ) {
     // use a smart pointer so we can capture Connection in the lambda and not
     // have to handle deletion ourselves.
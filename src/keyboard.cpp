@@ -1,15 +1,21 @@
 
+#include <algorithm>
+
 #include <QGuiApplication>
 #include <QWindow>
 
 #include "keyboard.h"
 #include "logging.h"
 #include "keyboardevents.h"
+#include "phoenixglobals.h"
 
 
 Keyboard::Keyboard( InputDeviceMapping *mapping ) : InputDevice( mapping ) {
     setDeviceName( "Keyboard (Qt KeyEvent)" );
 
+    m_mapping = static_cast<Mapping *>( InputDevice::m_mapping );
+    Q_ASSERT( m_mapping != nullptr );
+
 }
 
 Keyboard::~Keyboard() {
@@ -41,17 +47,70 @@ bool Keyboard::eventFilter( QObject *obj, QEvent *event ) {
 }
 
 inline void Keyboard::processKeyEvent( QKeyEvent *event ) {
+    markEvent( timestamp() );
     bool is_pressed = ( event->type() == QEvent::KeyPress ) ? true : false;
+
+    // Cores that emulate a keyboard get every key, on top of the ones mapped to the joypad
+    input_manager.keyboardQueue().push( event );
+
     auto ev = KeyboardKeyEvent::fromKeyEvent( event );
-    emit inputEventReceived( new KeyboardKeyEvent( ev ), is_pressed );
+    if( isCapturing() ) {
+        emit inputEventReceived( new KeyboardKeyEvent( ev ), is_pressed );
+    }
 
-    auto retro_id = m_mapping->getMapping( &ev );
+    auto retro_id = m_mapping->keyMapping( ev.event().first, ev.event().second );
 
-    if( retro_id != ( unsigned )~0 ) {
+    if( retro_id != InputDeviceMapping::unmapped ) {
         setState( retro_id, is_pressed );
     }
 }
 
+Keyboard::Mapping::Mapping() {
+    std::fill( key_table, key_table + key_table_size, unmapped );
+}
+
+int Keyboard::Mapping::keyIndex( Qt::Key key ) {
+    unsigned code = key;
+
+    if( code < 0x100 ) {
+        return int( code );
+    }
+
+    if( code - Qt::Key_Escape < 0x100 ) {
+        return int( 0x100 + code - Qt::Key_Escape );
+    }
+
+    return -1;
+}
+
+retro_device_id Keyboard::Mapping::keyMapping( Qt::Key key, Qt::KeyboardModifiers modifiers ) {
+    int index = modifiers == Qt::NoModifier ? keyIndex( key ) : -1;
+
+    if( index != -1 ) {
+        return key_table[index];
+    }
+
+    KeyboardKeyEvent ev( QtKeyboardKeyEvent( key, modifiers ) );
+    return getMapping( &ev, unmapped );
+}
+
+void Keyboard::Mapping::compileMapping() {
+    std::fill( key_table, key_table + key_table_size, unmapped );
+
+    for( const auto &m : *mappings() ) {
+        if( m.first->type() != int( input_event_type_id<KeyboardKeyEvent>() ) ) {
+            continue;
+        }
+
+        const QtKeyboardKeyEvent &key = static_cast<const KeyboardKeyEvent *>( m.first )->event();
+        int index = key.second == Qt::NoModifier ? keyIndex( key.first ) : -1;
+
+        if( index != -1 ) {
+            key_table[index] = m.second;
+        }
+    }
+}
+
 QVariant Keyboard::Mapping::setMappingOnInput( retro_device_id id, QJSValue cb ) {
     auto conn = std::make_shared<QMetaObject::Connection>();
 
@@ -0,0 +1,377 @@
+#include <cstring>
+
+#include "keyboardqueue.h"
+#include "logging.h"
+
+KeyboardQueue::KeyboardQueue()
+    : head( 0 ),
+      tail( 0 ),
+      queuing( false ),
+      core_callback( false ),
+      m_paused( false ) {
+    for( auto &bits : pressed ) {
+        bits = 0;
+    }
+}
+
+unsigned KeyboardQueue::translateKey( int key, Qt::KeyboardModifiers modifiers ) {
+    // With NumLock off, keypad keys come as arrows, Home, End... and are handled below
+    if( modifiers & Qt::KeypadModifier ) {
+        if( key >= Qt::Key_0 && key <= Qt::Key_9 ) {
+            return RETROK_KP0 + ( key - Qt::Key_0 );
+        }
+
+        switch( key ) {
+            case Qt::Key_Period:
+            case Qt::Key_Comma:
+                return RETROK_KP_PERIOD;
+
+            case Qt::Key_Slash:
+                return RETROK_KP_DIVIDE;
+
+            case Qt::Key_Asterisk:
+                return RETROK_KP_MULTIPLY;
+
+            case Qt::Key_Minus:
+                return RETROK_KP_MINUS;
+
+            case Qt::Key_Plus:
+                return RETROK_KP_PLUS;
+
+            case Qt::Key_Enter:
+            case Qt::Key_Return:
+                return RETROK_KP_ENTER;
+
+            case Qt::Key_Equal:
+                return RETROK_KP_EQUALS;
+
+            default:
+                break;
+        }
+    }
+
+    // Qt names letters by their upper case, whatever the shift state
+    if( key >= Qt::Key_A && key <= Qt::Key_Z ) {
+        return RETROK_a + ( key - Qt::Key_A );
+    }
+
+    // Qt names the other keys by what they type. Cores like DOSBox only know the unshifted keys.
+    static const char shifted[] = "!@#$%^&*()_+{}|:\"<>?~";
+    static const char unshifted[] = "1234567890-=[]\\;',./`";
+    const char *symbol = key > 0 && key < 0x80 ? strchr( shifted, key ) : nullptr;
+
+    if( symbol ) {
+        return unsigned( unshifted[symbol - shifted] );
+    }
+
+    // The rest of printable ASCII uses the same codes in both
+    if( key >= Qt::Key_Space && key <= Qt::Key_QuoteLeft ) {
+        return unsigned( key );
+    }
+
+    if( key >= Qt::Key_F1 && key <= Qt::Key_F15 ) {
+        return RETROK_F1 + ( key - Qt::Key_F1 );
+    }
+
+    // Qt doesn't tell left and right modifiers apart, they are reported as the left ones
+    switch( key ) {
+        case Qt::Key_Backspace:
+            return RETROK_BACKSPACE;
+
+        case Qt::Key_Tab:
+        case Qt::Key_Backtab:
+            return RETROK_TAB;
+
+        case Qt::Key_Clear:
+            return RETROK_CLEAR;
+
+        case Qt::Key_Return:
+            return RETROK_RETURN;
+
+        case Qt::Key_Enter:
+            return RETROK_KP_ENTER;
+
+        case Qt::Key_Pause:
+            return RETROK_PAUSE;
+
+        case Qt::Key_Escape:
+            return RETROK_ESCAPE;
+
+        case Qt::Key_Delete:
+            return RETROK_DELETE;
+
+        case Qt::Key_Up:
+            return RETROK_UP;
+
+        case Qt::Key_Down:
+            return RETROK_DOWN;
+
+        case Qt::Key_Right:
+            return RETROK_RIGHT;
+
+        case Qt::Key_Left:
+            return RETROK_LEFT;
+
+        case Qt::Key_Insert:
+            return RETROK_INSERT;
+
+        case Qt::Key_Home:
+            return RETROK_HOME;
+
+        case Qt::Key_End:
+            return RETROK_END;
+
+        case Qt::Key_PageUp:
+            return RETROK_PAGEUP;
+
+        case Qt::Key_PageDown:
+            return RETROK_PAGEDOWN;
+
+        case Qt::Key_NumLock:
+            return RETROK_NUMLOCK;
+
+        case Qt::Key_CapsLock:
+            return RETROK_CAPSLOCK;
+
+        case Qt::Key_ScrollLock:
+            return RETROK_SCROLLOCK;
+
+        case Qt::Key_Shift:
+            return RETROK_LSHIFT;
+
+        case Qt::Key_Control:
+            return RETROK_LCTRL;
+
+        case Qt::Key_Alt:
+            return RETROK_LALT;
+
+        case Qt::Key_AltGr:
+            return RETROK_RALT;
+
+        case Qt::Key_Meta:
+            return RETROK_LMETA;
+
+        case Qt::Key_Super_L:
+            return RETROK_LSUPER;
+
+        case Qt::Key_Super_R:
+            return RETROK_RSUPER;
+
+        case Qt::Key_Mode_switch:
+            return RETROK_MODE;
+
+        case Qt::Key_Multi_key:
+            return RETROK_COMPOSE;
+
+        case Qt::Key_Help:
+            return RETROK_HELP;
+
+        case Qt::Key_Print:
+            return RETROK_PRINT;
+
+        case Qt::Key_SysReq:
+            return RETROK_SYSREQ;
+
+        case Qt::Key_Menu:
+            return RETROK_MENU;
+
+        case Qt::Key_PowerOff:
+            return RETROK_POWER;
+
+        default:
+            return RETROK_UNKNOWN;
+    }
+}
+
+uint16_t KeyboardQueue::translateModifiers( Qt::KeyboardModifiers modifiers ) {
+    // Qt doesn't report the lock keys' state, cores that care follow their key events
+    uint16_t retro_modifiers = RETROKMOD_NONE;
+
+    if( modifiers & Qt::ShiftModifier ) {
+        retro_modifiers |= RETROKMOD_SHIFT;
+    }
+
+    if( modifiers & Qt::ControlModifier ) {
+        retro_modifiers |= RETROKMOD_CTRL;
+    }
+
+    if( modifiers & Qt::AltModifier ) {
+        retro_modifiers |= RETROKMOD_ALT;
+    }
+
+    if( modifiers & Qt::MetaModifier ) {
+        retro_modifiers |= RETROKMOD_META;
+    }
+
+    return retro_modifiers;
+}
+
+quint64 KeyboardQueue::physicalKey( const QKeyEvent *event ) {
+    // Some platforms and synthesized events have no scan code, Qt's key code is the next best thing
+    if( event->nativeScanCode() ) {
+        return event->nativeScanCode();
+    }
+
+    return ( quint64( 1 ) << 32 ) | quint32( event->key() );
+}
+
+bool KeyboardQueue::isHotkey( const QKeyEvent *event ) const {
+    switch( event->key() ) {
+        case Qt::Key_Escape:
+        case Qt::Key_Space:
+        case Qt::Key_F12:
+            break;
+
+        default:
+            return false;
+    }
+
+    return !core_callback.load( std::memory_order_relaxed ) || ( event->modifiers() & Qt::ControlModifier );
+}
+
+void KeyboardQueue::setPaused( bool paused ) {
+    if( paused && !m_paused && queuing.load( std::memory_order_relaxed ) ) {
+        // Delivered when the game resumes, their own releases would come while nothing gets queued
+        for( unsigned keycode : down_keys ) {
+            Event key = { false, keycode, 0, 0 };
+
+            if( !pushEvent( key ) ) {
+                break;
+            }
+        }
+    }
+
+    if( paused ) {
+        down_keys.clear();
+    }
+
+    m_paused = paused;
+}
+
+void KeyboardQueue::push( const QKeyEvent *event ) {
+    if( m_paused ) {
+        return;
+    }
+
+    if( !queuing.load( std::memory_order_relaxed ) ) {
+        down_keys.clear();
+        return;
+    }
+
+    // Emulated keyboards repeat held keys on their own
+    if( event->isAutoRepeat() ) {
+        return;
+    }
+
+    Event key;
+    key.down = event->type() == QEvent::KeyPress;
+
+    // Only presses, a key that went down on its own still has to come up
+    if( key.down && isHotkey( event ) ) {
+        return;
+    }
+
+    key.modifiers = translateModifiers( event->modifiers() );
+
+    if( key.down ) {
+        key.keycode = translateKey( event->key(), event->modifiers() );
+        down_keys.insert( physicalKey( event ), key.keycode );
+    } else {
+        // Shift+1 may come back as Key_1, the core has to see the key it got pressed go up.
+        // Keys pressed before the game started were never seen at all.
+        auto it = down_keys.find( physicalKey( event ) );
+
+        if( it == down_keys.end() ) {
+            return;
+        }
+
+        key.keycode = it.value();
+        down_keys.erase( it );
+    }
+
+    // Only presses type something. Input methods may commit several characters at once,
+    // the ones after the first are posted on their own, without a keycode.
+    const QString text = key.down ? event->text() : QString();
+    int i = 0;
+
+    do {
+        key.character = 0;
+
+        if( i < text.size() ) {
+            QChar c = text.at( i++ );
+
+            if( c.isHighSurrogate() && i < text.size() && text.at( i ).isLowSurrogate() ) {
+                key.character = QChar::surrogateToUcs4( c, text.at( i++ ) );
+            } else {
+                key.character = c.unicode();
+            }
+        }
+
+        if( !pushEvent( key ) ) {
+            return;
+        }
+
+        key.keycode = RETROK_UNKNOWN;
+    } while( i < text.size() );
+}
+
+bool KeyboardQueue::pushEvent( const Event &event ) {
+    unsigned h = head.load( std::memory_order_relaxed );
+
+    // Only when the core stopped running frames, nobody types that fast
+    if( h - tail.load( std::memory_order_acquire ) >= event_count ) {
+        qCWarning( phxInput, "KeyboardQueue: full, dropped a key event" );
+        return false;
+    }
+
+    events[h & ( event_count - 1 )] = event;
+    head.store( h + 1, std::memory_order_release );
+    return true;
+}
+
+void KeyboardQueue::start() {
+    tail.store( head.load( std::memory_order_acquire ), std::memory_order_release );
+
+    for( auto &bits : pressed ) {
+        bits = 0;
+    }
+
+    queuing.store( true, std::memory_order_relaxed );
+}
+
+void KeyboardQueue::stop() {
+    queuing.store( false, std::memory_order_relaxed );
+    core_callback.store( false, std::memory_order_relaxed );
+
+    for( auto &bits : pressed ) {
+        bits = 0;
+    }
+}
+
+void KeyboardQueue::deliver( retro_keyboard_event_t callback ) {
+    core_callback.store( callback != nullptr, std::memory_order_relaxed );
+
+    unsigned t = tail.load( std::memory_order_relaxed );
+    unsigned h = head.load( std::memory_order_acquire );
+
+    for( ; t != h; t++ ) {
+        const Event &event = events[t & ( event_count - 1 )];
+
+        if( event.keycode != RETROK_UNKNOWN && event.keycode < RETROK_LAST ) {
+            quint32 bit = 1u << ( event.keycode % 32 );
+
+            if( event.down ) {
+                pressed[event.keycode / 32] |= bit;
+            } else {
+                pressed[event.keycode / 32] &= ~bit;
+            }
+        }
+
+        if( callback ) {
+            callback( event.down, event.keycode, event.character, event.modifiers );
+        }
+    }
+
+    // The slots are only handed back once the core is done with them
+    tail.store( t, std::memory_order_release );
+}
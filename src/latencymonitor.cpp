@@ -0,0 +1,151 @@
+#include <QStringList>
+
+#include <cstring>
+
+#include "latencymonitor.h"
+
+LatencyMonitor::LatencyMonitor() {
+    for( Port &port : ports ) {
+        port.last_event = 0;
+        port.stage = Idle;
+        port.to_latch.clear();
+        port.to_upload.clear();
+        port.to_photon.clear();
+    }
+}
+
+void LatencyMonitor::inputLatched( const InputManager &inputs ) {
+    qint64 now = InputDevice::timestamp();
+    unsigned count = qMin( inputs.portCount(), InputManager::max_ports );
+
+    for( unsigned i = 0; i < count; i++ ) {
+        Port &port = ports[i];
+        qint64 event = inputs.portEventTime( i );
+
+        if( event == port.last_event ) {
+            continue;
+        }
+
+        port.last_event = event;
+
+        if( port.stage == Idle && event ) {
+            port.event = event;
+            port.latched = now;
+            port.stage = Latched;
+            port.device_name = inputs.portDevice( i )->deviceName();
+        }
+    }
+}
+
+void LatencyMonitor::frameUploaded() {
+    qint64 now = InputDevice::timestamp();
+
+    for( Port &port : ports ) {
+        if( port.stage == Latched ) {
+            port.uploaded = now;
+            port.stage = Uploaded;
+        }
+    }
+}
+
+void LatencyMonitor::frameSwapped() {
+    qint64 now = InputDevice::timestamp();
+
+    for( Port &port : ports ) {
+        if( port.stage != Uploaded ) {
+            continue;
+        }
+
+        port.to_latch.add( port.latched - port.event );
+        port.to_upload.add( port.uploaded - port.event );
+        port.to_photon.add( now - port.event );
+        port.stage = Idle;
+    }
+
+    if( !report_timer.isValid() ) {
+        report_timer.start();
+    } else if( report_timer.hasExpired( report_interval ) ) {
+        report();
+        report_timer.start();
+    }
+}
+
+void LatencyMonitor::report() {
+    for( unsigned i = 0; i < InputManager::max_ports; i++ ) {
+        Port &port = ports[i];
+
+        if( !port.to_photon.count ) {
+            continue;
+        }
+
+        qCDebug( phxInput, "Input latency, port %u (%s), %u events:", i, qPrintable( port.device_name ), port.to_photon.count );
+        qCDebug( phxInput, "    to latch  %s", qPrintable( port.to_latch.summary() ) );
+        qCDebug( phxInput, "    to upload %s", qPrintable( port.to_upload.summary() ) );
+        qCDebug( phxInput, "    to photon %s", qPrintable( port.to_photon.summary() ) );
+        qCDebug( phxInput, "    %s", qPrintable( port.to_photon.distribution() ) );
+
+        port.to_latch.clear();
+        port.to_upload.clear();
+        port.to_photon.clear();
+    }
+}
+
+void LatencyMonitor::Histogram::clear() {
+    memset( buckets, 0, sizeof( buckets ) );
+    count = 0;
+    sum = 0;
+    max = 0;
+}
+
+void LatencyMonitor::Histogram::add( qint64 nsecs ) {
+    nsecs = qMax<qint64>( 0, nsecs );
+    buckets[qMin<qint64>( nsecs / bucket_width, bucket_count - 1 )]++;
+    count++;
+    sum += nsecs;
+    max = qMax( max, nsecs );
+}
+
+double LatencyMonitor::Histogram::percentile( double fraction ) const {
+    quint32 target = quint32( count * fraction );
+    quint32 seen = 0;
+
+    for( int i = 0; i < bucket_count; i++ ) {
+        seen += buckets[i];
+
+        if( seen > target ) {
+            // Upper edge of the bucket, never optimistic
+            return ( i + 1 ) * bucket_width / 1000000.0;
+        }
+    }
+
+    return max / 1000000.0;
+}
+
+QString LatencyMonitor::Histogram::summary() const {
+    return QString( "mean %1ms, p50 %2ms, p90 %3ms, p99 %4ms, max %5ms" )
+           .arg( sum / 1000000.0 / qMax( 1u, count ), 0, 'f', 1 )
+           .arg( percentile( 0.5 ), 0, 'f', 1 )
+           .arg( percentile( 0.9 ), 0, 'f', 1 )
+           .arg( percentile( 0.99 ), 0, 'f', 1 )
+           .arg( max / 1000000.0, 0, 'f', 1 );
+}
+
+QString LatencyMonitor::Histogram::distribution() const {
+    // Whole milliseconds are enough to see the shape, and which frame events land on
+    QStringList parts;
+    const int per_ms = 1000000 / bucket_width;
+
+    for( int ms = 0; ms < bucket_count / per_ms; ms++ ) {
+        quint32 events = 0;
+
+        for( int i = 0; i < per_ms; i++ ) {
+            events += buckets[ms * per_ms + i];
+        }
+
+        if( events ) {
+            parts.append( QString( "%1ms: %2" ).arg( ms ).arg( events ) );
+        }
+    }
+
+    return parts.join( ", " );
+}
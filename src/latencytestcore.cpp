@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "latencytestcore.h"
+
+namespace LatencyTestCore {
+
+    const char *const path = "builtin:latency-test";
+
+    static const unsigned width = 320;
+    static const unsigned height = 240;
+    static const double fps = 60.0;
+    static const double sample_rate = 48000.0;
+    static const unsigned ports = 8;
+
+    static retro_environment_t environment_cb;
+    static retro_video_refresh_t video_cb;
+    static retro_audio_sample_batch_t audio_batch_cb;
+    static retro_input_poll_t input_poll_cb;
+    static retro_input_state_t input_state_cb;
+
+    static std::vector<uint32_t> frame;
+    static std::vector<int16_t> silence;
+    static bool was_pressed;
+    static bool white;
+
+    static unsigned apiVersion() {
+        return RETRO_API_VERSION;
+    }
+
+    static void getSystemInfo( retro_system_info *info ) {
+        memset( info, 0, sizeof( *info ) );
+        info->library_name = "Latency Test";
+        info->library_version = "1.0";
+        info->valid_extensions = "";
+        info->need_fullpath = true; // there is no game to read
+        info->block_extract = true;
+    }
+
+    static void getSystemAvInfo( retro_system_av_info *info ) {
+        memset( info, 0, sizeof( *info ) );
+        info->geometry.base_width = width;
+        info->geometry.base_height = height;
+        info->geometry.max_width = width;
+        info->geometry.max_height = height;
+        info->geometry.aspect_ratio = 4.0f / 3.0f;
+        info->timing.fps = fps;
+        info->timing.sample_rate = sample_rate;
+    }
+
+    static void setEnvironment( retro_environment_t cb ) {
+        environment_cb = cb;
+
+        bool no_game = true;
+        environment_cb( RETRO_ENVIRONMENT_SET_SUPPORT_NO_GAME, &no_game );
+    }
+
+    static void init() {
+        frame.assign( width * height, 0 );
+        silence.assign( unsigned( sample_rate / fps ) * 2, 0 );
+        was_pressed = false;
+        white = false;
+    }
+
+    static void deinit() {
+        frame.clear();
+        silence.clear();
+    }
+
+    static bool loadGame( const retro_game_info *game ) {
+        Q_UNUSED( game );
+
+        retro_pixel_format format = RETRO_PIXEL_FORMAT_XRGB8888;
+        return environment_cb( RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &format );
+    }
+
+    static bool anyButtonPressed() {
+        for( unsigned port = 0; port < ports; port++ ) {
+            for( unsigned id = RETRO_DEVICE_ID_JOYPAD_B; id <= RETRO_DEVICE_ID_JOYPAD_R3; id++ ) {
+                if( input_state_cb( port, RETRO_DEVICE_JOYPAD, 0, id ) ) {
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    static void run() {
+        input_poll_cb();
+
+        // Flips on the press only, holding a button doesn't make the screen flicker
+        bool pressed = anyButtonPressed();
+
+        if( pressed && !was_pressed ) {
+            white = !white;
+            std::fill( frame.begin(), frame.end(), white ? 0xffffffu : 0u );
+        }
+
+        was_pressed = pressed;
+
+        video_cb( frame.data(), width, height, width * sizeof( uint32_t ) );
+        audio_batch_cb( silence.data(), silence.size() / 2 );
+    }
+
+    // Nothing to save, nothing to reset
+    static void reset() {}
+    static void unloadGame() {}
+    static void setControllerPortDevice( unsigned port, unsigned device ) {
+        Q_UNUSED( port );
+        Q_UNUSED( device );
+    }
+    static size_t serializeSize() {
+        return 0;
+    }
+    static bool serialize( void *data, size_t size ) {
+        Q_UNUSED( data );
+        Q_UNUSED( size );
+        return false;
+    }
+    static bool unserialize( const void *data, size_t size ) {
+        Q_UNUSED( data );
+        Q_UNUSED( size );
+        return false;
+    }
+    static void cheatReset() {}
+    static void cheatSet( unsigned index, bool enabled, const char *code ) {
+        Q_UNUSED( index );
+        Q_UNUSED( enabled );
+        Q_UNUSED( code );
+    }
+    static bool loadGameSpecial( unsigned type, const retro_game_info *info, size_t count ) {
+        Q_UNUSED( type );
+        Q_UNUSED( info );
+        Q_UNUSED( count );
+        return false;
+    }
+    static unsigned getRegion() {
+        return RETRO_REGION_NTSC;
+    }
+    static void *getMemoryData( unsigned id ) {
+        Q_UNUSED( id );
+        return nullptr;
+    }
+    static size_t getMemorySize( unsigned id ) {
+        Q_UNUSED( id );
+        return 0;
+    }
+
+    static void setVideoRefresh( retro_video_refresh_t cb ) {
+        video_cb = cb;
+    }
+    static void setAudioSample( retro_audio_sample_t cb ) {
+        Q_UNUSED( cb );
+    }
+    static void setAudioSampleBatch( retro_audio_sample_batch_t cb ) {
+        audio_batch_cb = cb;
+    }
+    static void setInputPoll( retro_input_poll_t cb ) {
+        input_poll_cb = cb;
+    }
+    static void setInputState( retro_input_state_t cb ) {
+        input_state_cb = cb;
+    }
+
+    void resolveSymbols( LibretroSymbols *symbols ) {
+        symbols->retro_api_version = apiVersion;
+        symbols->retro_cheat_reset = cheatReset;
+        symbols->retro_cheat_set = cheatSet;
+        symbols->retro_deinit = deinit;
+        symbols->retro_get_memory_data = getMemoryData;
+        symbols->retro_get_memory_size = getMemorySize;
+        symbols->retro_get_region = getRegion;
+        symbols->retro_get_system_av_info = getSystemAvInfo;
+        symbols->retro_get_system_info = getSystemInfo;
+        symbols->retro_init = init;
+        symbols->retro_load_game = loadGame;
+        symbols->retro_load_game_special = loadGameSpecial;
+        symbols->retro_reset = reset;
+        symbols->retro_run = run;
+        symbols->retro_serialize = serialize;
+        symbols->retro_serialize_size = serializeSize;
+        symbols->retro_unload_game = unloadGame;
+        symbols->retro_unserialize = unserialize;
+
+        symbols->retro_set_audio_sample = setAudioSample;
+        symbols->retro_set_audio_sample_batch = setAudioSampleBatch;
+        symbols->retro_set_controller_port_device = setControllerPortDevice;
+        symbols->retro_set_environment = setEnvironment;
+        symbols->retro_set_input_poll = setInputPoll;
+        symbols->retro_set_input_state = setInputState;
+        symbols->retro_set_video_refresh = setVideoRefresh;
+    }
+
+}
@@ -15,6 +15,7 @@ static const QString table_version = QStringLiteral( "schema_version" );
 static const QString database_name = QStringLiteral( "gamelibrary.sqlite" );
 
 const QString LibraryDbManager::table_games = QStringLiteral( "games" );
+const QString LibraryDbManager::connection_name = QStringLiteral( "first" );
 
 QSqlDatabase &LibraryDbManager::handle() {
     if( !db.isValid() ) {
@@ -25,7 +26,7 @@ QSqlDatabase &LibraryDbManager::handle() {
 }
 
 void LibraryDbManager::open() {
-    db = QSqlDatabase::addDatabase( "QSQLITE", "first" );
+    db = QSqlDatabase::addDatabase( "QSQLITE", connection_name );
 
     QString dataPathStr = QStandardPaths::writableLocation( QStandardPaths::GenericDataLocation );
     Q_ASSERT( !dataPathStr.isEmpty() );
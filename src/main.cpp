@@ -4,6 +4,7 @@
 #include <QQuickWindow>
 #include <QtQuick/QQuickView>
 #include <QQmlContext>
+#include <QCommandLineParser>
 
 #ifdef Q_OS_LINUX
 #include <pthread.h>
@@ -42,6 +43,27 @@ int main( int argc, char *argv[] ) {
     //    a.setOrganizationDomain("phoenix-emu.org");
     QSettings settings;
 
+    QCommandLineParser parser;
+    parser.setApplicationDescription( "Phoenix emulator frontend" );
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption nullAudioOption( "null-audio",
+                                        "Render audio to <target> instead of the sound card, as fast as the core runs. "
+                                        "<target> is a WAV file, or \"hash\" to only log a hash of it.",
+                                        "target" );
+    parser.addOption( nullAudioOption );
+    QCommandLineOption inputLatencyOption( "input-latency",
+                                           "Measure how long input takes to show up on screen, and log it per device." );
+    parser.addOption( inputLatencyOption );
+    QCommandLineOption latencyTestOption( "latency-test",
+                                          "Start the built-in latency test core, which flips the screen between black "
+                                          "and white on every button press. Implies --input-latency." );
+    parser.addOption( latencyTestOption );
+    parser.process( a );
+
+    phxGlobals.setNullAudioOutput( parser.value( nullAudioOption ) );
+    phxGlobals.setLatencyTest( parser.isSet( latencyTestOption ) );
+    phxGlobals.setMeasureInputLatency( parser.isSet( inputLatencyOption ) || parser.isSet( latencyTestOption ) );
 
     qmlRegisterType<PhoenixWindow>( "phoenix.window", 1, 0, "PhoenixWindow" );
     qmlRegisterType<CachedImage>( "phoenix.image", 1, 0, "CachedImage" );
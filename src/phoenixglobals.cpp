@@ -5,6 +5,7 @@
 #include <QDebug>
 
 #include "utilities.h"
+#include "latencytestcore.h"
 
 Utilities utilities;
 InputManager input_manager;
@@ -13,7 +14,9 @@ PhoenixLibraryHelper phoenixLibraryHelper;
 UserNotifications userNotifications;
 
 PhoenixGlobals::PhoenixGlobals( QObject *parent )
-    : QObject( parent ) {
+    : QObject( parent ),
+      m_measure_input_latency( false ),
+      m_latency_test( false ) {
 
 }
 
@@ -77,6 +80,30 @@ void PhoenixGlobals::setSelectedCore( const QString &file ) {
     m_selected_core.setFile( file );
 }
 
+void PhoenixGlobals::setNullAudioOutput( const QString &target ) {
+    m_null_audio_output = target;
+}
+
+QString PhoenixGlobals::nullAudioOutput() const {
+    return m_null_audio_output;
+}
+
+void PhoenixGlobals::setMeasureInputLatency( bool measure ) {
+    m_measure_input_latency = measure;
+}
+
+bool PhoenixGlobals::measureInputLatency() const {
+    return m_measure_input_latency;
+}
+
+void PhoenixGlobals::setLatencyTest( bool test ) {
+    m_latency_test = test;
+}
+
+QString PhoenixGlobals::latencyTestCore() const {
+    return m_latency_test ? QString( LatencyTestCore::path ) : QString();
+}
+
 void PhoenixGlobals::setOfflineStoragePath( const QString &path ) {
     m_offline_storage_path = path;
 
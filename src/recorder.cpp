@@ -0,0 +1,379 @@
+#include <QtEndian>
+#include <QFileInfo>
+#include <QDir>
+
+#include <cstring>
+
+#include "recorder.h"
+
+Recorder::Recorder( QObject *parent )
+    : QObject( parent ),
+      frame_head( 0 ),
+      frame_tail( 0 ),
+      audio_queue( new AudioBuffer( 4096 * 4 * 16, AudioBuffer::DropNewest ) ),
+      recording( false ),
+      dropped_frames( 0 ),
+      dropped_audio_frames( 0 ),
+      m_fps( 0.0 ),
+      m_sample_rate( 0.0 ),
+      canvas_width( 0 ),
+      canvas_height( 0 ),
+      frames_written( 0 ),
+      audio_bytes_written( 0 ) {
+
+    for( auto &slot : frame_slots ) {
+        slot.width = 0;
+        slot.height = 0;
+        slot.format = RETRO_PIXEL_FORMAT_UNKNOWN;
+        slot.dupe = false;
+    }
+
+    audio_scratch.resize( 4096 * 4 );
+
+    // Draining every few milliseconds keeps the queues short without waking up the producer
+    drain_timer.setInterval( 5 );
+
+    this->moveToThread( &writer_thread );
+    drain_timer.moveToThread( &writer_thread );
+    connect( &drain_timer, &QTimer::timeout, this, &Recorder::slotDrain );
+    writer_thread.setObjectName( "phoenix-recorder" );
+
+    writer_thread.start( QThread::LowPriority );
+}
+
+Recorder::~Recorder() {
+    if( isRecording() ) {
+        QMetaObject::invokeMethod( this, "slotStop", Qt::BlockingQueuedConnection );
+    }
+
+    writer_thread.quit();
+    writer_thread.wait();
+}
+
+//
+// Producer side
+//
+
+void Recorder::pushVideoFrame( const void *data, unsigned width, unsigned height, size_t pitch, retro_pixel_format format ) {
+    if( !isRecording() ) {
+        return;
+    }
+
+    unsigned head = frame_head.load( std::memory_order_relaxed );
+    unsigned tail = frame_tail.load( std::memory_order_acquire );
+
+    if( head - tail == frame_slot_count ) {
+        // Writer thread is behind, never wait for it
+        dropped_frames.fetch_add( 1, std::memory_order_relaxed );
+        return;
+    }
+
+    FrameSlot &slot = frame_slots[head & ( frame_slot_count - 1 )];
+    size_t row_size = width * ( format == RETRO_PIXEL_FORMAT_XRGB8888 ? 4 : 2 );
+
+    // Capacity was reserved in slotStart(), so this only allocates if the core exceeds its max geometry
+    slot.pixels.resize( row_size * height );
+
+    const char *src = static_cast<const char *>( data );
+    char *dst = slot.pixels.data();
+
+    if( pitch == row_size ) {
+        memcpy( dst, src, row_size * height );
+    } else {
+        for( unsigned y = 0; y < height; y++ ) {
+            memcpy( dst + y * row_size, src + y * pitch, row_size );
+        }
+    }
+
+    slot.width = width;
+    slot.height = height;
+    slot.format = format;
+    slot.dupe = false;
+
+    frame_head.store( head + 1, std::memory_order_release );
+}
+
+void Recorder::pushDupeFrame() {
+    if( !isRecording() ) {
+        return;
+    }
+
+    unsigned head = frame_head.load( std::memory_order_relaxed );
+    unsigned tail = frame_tail.load( std::memory_order_acquire );
+
+    if( head - tail == frame_slot_count ) {
+        dropped_frames.fetch_add( 1, std::memory_order_relaxed );
+        return;
+    }
+
+    frame_slots[head & ( frame_slot_count - 1 )].dupe = true;
+    frame_head.store( head + 1, std::memory_order_release );
+}
+
+void Recorder::pushAudio( const int16_t *data, size_t frames ) {
+    if( !isRecording() ) {
+        return;
+    }
+
+    size_t bytes = frames * sizeof( int16_t ) * 2;
+
+    if( audio_queue->capacity() - audio_queue->size() < bytes ) {
+        dropped_audio_frames.fetch_add( frames, std::memory_order_relaxed );
+        return;
+    }
+
+    audio_queue->write( reinterpret_cast<const char *>( data ), bytes );
+}
+
+//
+// Writer side
+//
+
+void Recorder::slotStart( QString base_path, double fps, double sample_rate, unsigned max_width, unsigned max_height ) {
+    if( isRecording() ) {
+        return;
+    }
+
+    QDir().mkpath( QFileInfo( base_path ).absolutePath() );
+
+    video_file.setFileName( base_path + ".y4m" );
+    audio_file.setFileName( base_path + ".wav" );
+
+    if( !video_file.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) {
+        qCWarning( phxVideo ) << "Recorder: unable to open" << video_file.fileName() << video_file.errorString();
+        return;
+    }
+
+    if( !audio_file.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) {
+        qCWarning( phxAudio ) << "Recorder: unable to open" << audio_file.fileName() << audio_file.errorString();
+        video_file.close();
+        return;
+    }
+
+    m_base_path = base_path;
+    m_fps = fps;
+    m_sample_rate = sample_rate;
+    canvas_width = 0;
+    canvas_height = 0;
+    frames_written = 0;
+    audio_bytes_written = 0;
+    dropped_frames = 0;
+    dropped_audio_frames = 0;
+
+    // Preallocate every slot for the largest frame the core announced
+    for( auto &slot : frame_slots ) {
+        slot.pixels.reserve( max_width * max_height * 4 );
+    }
+
+    yuv_frame.clear();
+    yuv_frame.reserve( max_width * max_height * 3 );
+
+    discardQueued();
+
+    // Placeholder header, sizes are patched in slotStop()
+    writeWavHeader();
+
+    recording.store( true, std::memory_order_release );
+    drain_timer.start();
+
+    qCDebug( phxVideo ) << "Recording started:" << m_base_path;
+    emit recordingChanged( true );
+}
+
+void Recorder::slotStop() {
+    if( !isRecording() ) {
+        return;
+    }
+
+    recording.store( false, std::memory_order_release );
+    drain_timer.stop();
+
+    // Flush whatever was queued before the flag flipped
+    slotDrain();
+
+    if( audio_file.isOpen() ) {
+        audio_file.seek( 0 );
+        writeWavHeader();
+        audio_file.close();
+    }
+
+    video_file.close();
+
+    qCDebug( phxVideo, "Recording finished: %llu frames written, %llu frames dropped, %llu audio frames dropped",
+             frames_written, droppedFrames(), droppedAudioFrames() );
+
+    emit recordingChanged( false );
+    emit recordingFinished( m_base_path, droppedFrames(), droppedAudioFrames() );
+}
+
+void Recorder::slotDrain() {
+    unsigned tail = frame_tail.load( std::memory_order_relaxed );
+    unsigned head = frame_head.load( std::memory_order_acquire );
+
+    while( tail != head ) {
+        if( video_file.isOpen() ) {
+            writeFrame( frame_slots[tail & ( frame_slot_count - 1 )] );
+        }
+
+        frame_tail.store( ++tail, std::memory_order_release );
+    }
+
+    size_t read;
+
+    while( ( read = audio_queue->read( audio_scratch.data(), audio_scratch.size() ) ) > 0 ) {
+        if( !audio_file.isOpen() ) {
+            continue;
+        }
+
+        if( audio_file.write( audio_scratch.data(), read ) != static_cast<qint64>( read ) ) {
+            failWrite( audio_file );
+            continue;
+        }
+
+        audio_bytes_written += read;
+    }
+}
+
+void Recorder::writeFrame( const FrameSlot &slot ) {
+    if( slot.dupe ) {
+        if( !canvas_width ) {
+            // Nothing to duplicate yet
+            return;
+        }
+    } else {
+        if( !canvas_width ) {
+            // The first real frame decides the stream's geometry
+            canvas_width = slot.width;
+            canvas_height = slot.height;
+            writeY4MHeader();
+        }
+
+        convertToYUV444( slot );
+    }
+
+    static const char frame_header[] = "FRAME\n";
+
+    if( video_file.write( frame_header, sizeof( frame_header ) - 1 ) < 0
+        || video_file.write( reinterpret_cast<const char *>( yuv_frame.data() ), yuv_frame.size() ) != static_cast<qint64>( yuv_frame.size() ) ) {
+        failWrite( video_file );
+        return;
+    }
+
+    frames_written++;
+}
+
+void Recorder::writeY4MHeader() {
+    // 4:4:4 keeps the capture lossless with regard to chroma
+    QByteArray header = QString( "YUV4MPEG2 W%1 H%2 F%3:1000 Ip A1:1 C444\n" )
+                        .arg( canvas_width ).arg( canvas_height )
+                        .arg( qRound( m_fps * 1000.0 ) ).toLatin1();
+
+    if( video_file.write( header ) != header.size() ) {
+        failWrite( video_file );
+    }
+}
+
+void Recorder::writeWavHeader() {
+    const quint16 channels = 2;
+    const quint16 bits = 16;
+    const quint32 rate = static_cast<quint32>( qRound( m_sample_rate ) );
+    const quint32 data_size = static_cast<quint32>( audio_bytes_written );
+
+    uchar header[44];
+    memcpy( header, "RIFF", 4 );
+    qToLittleEndian<quint32>( 36 + data_size, header + 4 );
+    memcpy( header + 8, "WAVEfmt ", 8 );
+    qToLittleEndian<quint32>( 16, header + 16 );
+    qToLittleEndian<quint16>( 1, header + 20 ); // PCM
+    qToLittleEndian<quint16>( channels, header + 22 );
+    qToLittleEndian<quint32>( rate, header + 24 );
+    qToLittleEndian<quint32>( rate * channels * bits / 8, header + 28 );
+    qToLittleEndian<quint16>( channels * bits / 8, header + 32 );
+    qToLittleEndian<quint16>( bits, header + 34 );
+    memcpy( header + 36, "data", 4 );
+    qToLittleEndian<quint32>( data_size, header + 40 );
+
+    if( audio_file.write( reinterpret_cast<const char *>( header ), sizeof( header ) ) != sizeof( header ) ) {
+        failWrite( audio_file );
+    }
+}
+
+void Recorder::convertToYUV444( const FrameSlot &slot ) {
+    const size_t plane_size = canvas_width * canvas_height;
+    yuv_frame.resize( plane_size * 3 );
+
+    uchar *y_plane = yuv_frame.data();
+    uchar *u_plane = y_plane + plane_size;
+    uchar *v_plane = u_plane + plane_size;
+
+    // Frames that don't match the canvas are cropped/padded from the top-left corner
+    if( slot.width != canvas_width || slot.height != canvas_height ) {
+        memset( y_plane, 16, plane_size );
+        memset( u_plane, 128, plane_size * 2 );
+    }
+
+    const unsigned width = qMin( slot.width, canvas_width );
+    const unsigned height = qMin( slot.height, canvas_height );
+
+    for( unsigned y = 0; y < height; y++ ) {
+        const size_t out = y * canvas_width;
+
+        for( unsigned x = 0; x < width; x++ ) {
+            int r, g, b;
+
+            if( slot.format == RETRO_PIXEL_FORMAT_XRGB8888 ) {
+                quint32 p = reinterpret_cast<const quint32 *>( slot.pixels.data() )[y * slot.width + x];
+                r = ( p >> 16 ) & 0xff;
+                g = ( p >> 8 ) & 0xff;
+                b = p & 0xff;
+            } else {
+                quint16 p = reinterpret_cast<const quint16 *>( slot.pixels.data() )[y * slot.width + x];
+
+                if( slot.format == RETRO_PIXEL_FORMAT_RGB565 ) {
+                    r = ( ( p >> 11 ) & 0x1f ) << 3;
+                    g = ( ( p >> 5 ) & 0x3f ) << 2;
+                    b = ( p & 0x1f ) << 3;
+                } else {
+                    r = ( ( p >> 10 ) & 0x1f ) << 3;
+                    g = ( ( p >> 5 ) & 0x1f ) << 3;
+                    b = ( p & 0x1f ) << 3;
+                }
+            }
+
+            // BT.601, studio range
+            y_plane[out + x] = static_cast<uchar>( ( ( 66 * r + 129 * g + 25 * b + 128 ) >> 8 ) + 16 );
+            u_plane[out + x] = static_cast<uchar>( ( ( -38 * r - 74 * g + 112 * b + 128 ) >> 8 ) + 128 );
+            v_plane[out + x] = static_cast<uchar>( ( ( 112 * r - 94 * g - 18 * b + 128 ) >> 8 ) + 128 );
+        }
+    }
+}
+
+void Recorder::discardQueued() {
+    // Only the consumer side is touched here, the producer may still be running
+    frame_tail.store( frame_head.load( std::memory_order_acquire ), std::memory_order_release );
+
+    while( audio_queue->read( audio_scratch.data(), audio_scratch.size() ) > 0 ) {
+    }
+}
+
+void Recorder::failWrite( const QFile &file ) {
+    // Most likely out of disk space. Stop recording, and let the producer drop everything from now on.
+    if( !isRecording() ) {
+        return;
+    }
+
+    qCWarning( phxVideo ) << "Recorder: write to" << file.fileName() << "failed:" << file.errorString()
+                          << "; recording stopped";
+    recording.store( false, std::memory_order_release );
+    drain_timer.stop();
+    video_file.close();
+
+    if( audio_file.isOpen() ) {
+        audio_file.seek( 0 );
+        writeWavHeader();
+        audio_file.close();
+    }
+
+    emit recordingChanged( false );
+    emit recordingFinished( m_base_path, droppedFrames(), droppedAudioFrames() );
+}
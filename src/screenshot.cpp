@@ -0,0 +1,139 @@
+#include <QRunnable>
+#include <QImage>
+#include <QImageWriter>
+#include <QFileInfo>
+#include <QDir>
+
+#include <cstring>
+
+#include "screenshot.h"
+
+// Encodes one captured frame, then hands its buffer back to the pool
+class ScreenshotTask : public QRunnable {
+    public:
+        ScreenshotTask( Screenshot *owner, std::vector<char> &&pixels, unsigned width, unsigned height,
+                        retro_pixel_format format, Screenshot::Purpose purpose, QString path, QString game )
+            : owner( owner ),
+              pixels( std::move( pixels ) ),
+              width( width ),
+              height( height ),
+              format( format ),
+              purpose( purpose ),
+              path( path ),
+              game( game ) {
+        }
+
+        void run() override {
+            QImage::Format qformat = QImage::Format_RGB32;
+            int bpp = 4;
+
+            if( format == RETRO_PIXEL_FORMAT_RGB565 ) {
+                qformat = QImage::Format_RGB16;
+                bpp = 2;
+            } else if( format == RETRO_PIXEL_FORMAT_0RGB1555 ) {
+                qformat = QImage::Format_RGB555;
+                bpp = 2;
+            }
+
+            QImage image( reinterpret_cast<const uchar *>( pixels.data() ), width, height, width * bpp, qformat );
+
+            QDir().mkpath( QFileInfo( path ).absolutePath() );
+            QImageWriter writer( path );
+
+            if( !writer.write( image ) ) {
+                qCWarning( phxVideo ) << "Unable to save screenshot" << path << writer.errorString();
+            } else {
+                emit owner->saved( path, purpose, game );
+            }
+
+            owner->releaseBuffer( std::move( pixels ) );
+        }
+
+    private:
+        Screenshot *owner;
+        std::vector<char> pixels;
+        unsigned width;
+        unsigned height;
+        retro_pixel_format format;
+        Screenshot::Purpose purpose;
+        QString path;
+        QString game;
+};
+
+Screenshot::Screenshot( QObject *parent )
+    : QObject( parent ),
+      has_requests( false ) {
+
+    // A single worker is plenty, captures are rare and must not compete with the core for CPU
+    encoder_pool.setMaxThreadCount( 1 );
+}
+
+Screenshot::~Screenshot() {
+    // Tasks reference this object, let them finish first
+    encoder_pool.waitForDone();
+}
+
+void Screenshot::request( Purpose purpose, QString path, QString game ) {
+    QMutexLocker lock( &requests_mutex );
+
+    // WebP is much smaller, use it for user screenshots when the image plugin is there
+    if( purpose == UserScreenshot && QFileInfo( path ).suffix().isEmpty() ) {
+        bool webp = QImageWriter::supportedImageFormats().contains( "webp" );
+        path += webp ? ".webp" : ".png";
+    }
+
+    requests.append( Request{ purpose, path, game } );
+    has_requests.store( true, std::memory_order_release );
+}
+
+void Screenshot::capture( const void *data, unsigned width, unsigned height, size_t pitch, retro_pixel_format format ) {
+    if( !data || !width || !height ) {
+        return;
+    }
+
+    QList<Request> pending;
+    {
+        QMutexLocker lock( &requests_mutex );
+        pending.swap( requests );
+        has_requests.store( false, std::memory_order_release );
+    }
+
+    size_t row_size = width * ( format == RETRO_PIXEL_FORMAT_XRGB8888 ? 4 : 2 );
+
+    for( const auto &req : pending ) {
+        // The only copy made on the core's thread
+        std::vector<char> pixels = acquireBuffer( row_size * height );
+        const char *src = static_cast<const char *>( data );
+
+        for( unsigned y = 0; y < height; y++ ) {
+            memcpy( pixels.data() + y * row_size, src + y * pitch, row_size );
+        }
+
+        encoder_pool.start( new ScreenshotTask( this, std::move( pixels ), width, height, format,
+                                                   req.purpose, req.path, req.game ) );
+    }
+}
+
+std::vector<char> Screenshot::acquireBuffer( size_t size ) {
+    std::vector<char> buffer;
+    {
+        QMutexLocker lock( &pool_mutex );
+
+        if( !free_buffers.empty() ) {
+            buffer = std::move( free_buffers.back() );
+            free_buffers.pop_back();
+        }
+    }
+
+    // Keeps its capacity when reused, so this only allocates the first time
+    buffer.resize( size );
+    return buffer;
+}
+
+void Screenshot::releaseBuffer( std::vector<char> &&buffer ) {
+    QMutexLocker lock( &pool_mutex );
+
+    if( free_buffers.size() < 4 ) {
+        free_buffers.push_back( std::move( buffer ) );
+    }
+}
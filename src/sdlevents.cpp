@@ -9,7 +9,11 @@
 #endif
 
 
-SDLEvents::SDLEvents() {
+SDLEvents::SDLEvents()
+    : running( true ),
+      wake_event_type( 0 ),
+      rumble_event_type( 0 ),
+      lock_requests( 0 ) {
     // Initialize the GameController database with the most recent file
     // from https://github.com/gabomdq/SDL_GameControllerDB
     // TODO: Instead of storing the file as a ressource, have it in some
@@ -19,10 +23,7 @@ SDLEvents::SDLEvents() {
     f.open( QIODevice::ReadOnly );
     SDL_SetHint( SDL_HINT_GAMECONTROLLERCONFIG, f.readAll().constData() );
 
-    event_list = new SDL_Event[10]();
-
     this->moveToThread( &thread );
-    polltimer.moveToThread( &thread );
     connect( &thread, SIGNAL( started() ), SLOT( threadStarted() ) );
     connect( &thread, SIGNAL( finished() ), SLOT( threadFinished() ) );
     thread.setObjectName( "phoenix-SDLEvents" );
@@ -31,11 +32,19 @@ SDLEvents::SDLEvents() {
 }
 
 SDLEvents::~SDLEvents() {
-    moveToThread( &thread );
-    polltimer.stop();
+    running = false;
+
+    Uint32 wake_type = wake_event_type;
+
+    if( wake_type ) {
+        SDL_Event wake;
+        SDL_zero( wake );
+        wake.type = wake_type;
+        SDL_PushEvent( &wake );
+    }
+
     thread.quit();
     thread.wait();
-    delete[] event_list;
 
     for( int i = 0; i < event_callbacks.length(); ++i ) {
         delete event_callbacks.at( i );
@@ -50,9 +59,10 @@ void SDLEvents::threadStarted() {
     sigaction( SIGINT, NULL, &action );
 #endif
 
-    // this will also implicitly initialize the event loop
+    // this will also implicitly initialize the event loop.
+    // Timers keep long rumbles going, see Joystick::applyRumble()
 
-    if( SDL_Init( SDL_INIT_JOYSTICK | SDL_INIT_GAMECONTROLLER ) < 0 ) {
+    if( SDL_Init( SDL_INIT_JOYSTICK | SDL_INIT_GAMECONTROLLER | SDL_INIT_TIMER ) < 0 ) {
         qFatal( "Fatal: Unable to initialize SDL2: %s", SDL_GetError() );
     }
 
@@ -62,10 +72,20 @@ void SDLEvents::threadStarted() {
     sigaction( SIGINT, &action, NULL );
 #endif
 
-    connect( &polltimer, SIGNAL( timeout() ), this, SLOT( pollSDL() ) );
+    // Rumble isn't worth failing over
+    if( SDL_InitSubSystem( SDL_INIT_HAPTIC ) < 0 ) {
+        qCWarning( phxInput, "SDLEvents: unable to initialize haptics: %s", SDL_GetError() );
+    }
+
+    Uint32 event_types = SDL_RegisterEvents( 2 );
 
-    // TODO: use retro_input_poll_t for polling instead of a timer ??
-    polltimer.start( 10 );
+    if( event_types != static_cast<Uint32>( -1 ) ) {
+        wake_event_type = event_types;
+        rumble_event_type = event_types + 1;
+    }
+
+    // Doesn't return until shutdown, the thread's Qt event loop isn't needed
+    run();
 }
 
 void SDLEvents::threadFinished() {
@@ -74,35 +94,136 @@ void SDLEvents::threadFinished() {
     }
 }
 
+void SDLEvents::run() {
+    while( running ) {
+        // The mutex isn't fair, this thread would take it right back
+        if( lock_requests.load() ) {
+            QThread::yieldCurrentThread();
+            continue;
+        }
+
+        QMutexLocker l( &sdl_mutex );
+
+        // Sleeps until there's something in the queue, without taking it out.
+        // It also pumps the devices, which must not race with closing them in lockSDL() holders.
+        if( !SDL_WaitEventTimeout( nullptr, wait_timeout ) ) {
+            continue;
+        }
+
+        int ret;
+
+        // Drain the queue, there may be more than one batch after a burst
+        while( ( ret = SDL_PeepEvents( event_list, batch_size, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT ) ) > 0 ) {
+            qint64 timestamp = InputDevice::timestamp();
+
+            for( int i = 0; i < ret; i++ ) {
+                dispatch( &event_list[i], timestamp );
+            }
+        }
+
+        if( ret < 0 ) {
+            qCCritical( phxInput, "SDLEvents: unable to retrieve events: %s", SDL_GetError() );
+        }
+    }
+}
+
+bool SDLEvents::postRumble( SDL_JoystickID instance ) {
+    Uint32 rumble_type = rumble_event_type;
 
-void SDLEvents::pollSDL() {
-    QMutexLocker l( &sdl_mutex );
-    // consume moar events
-    SDL_PumpEvents();
-    int ret = SDL_PeepEvents( event_list, 10, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT );
-    
-    if( ret < 0 ) {
-        qCCritical( phxInput, "SDLEvents: unable to retrieve events: %s", SDL_GetError() );
+    if( !rumble_type ) {
+        return false;
     }
 
-    if( ret == 0 ) {
+    SDL_Event event;
+    SDL_zero( event );
+    event.type = rumble_type;
+    event.user.code = instance;
+    return SDL_PushEvent( &event ) == 1;
+}
+
+void SDLEvents::dispatch( const SDL_Event *event, qint64 timestamp ) {
+    if( event->type == wake_event_type ) {
         return;
     }
 
-    event_callbacks_mutex.lock();
-    SDL_Event *event = event_list;
+    SDL_JoystickID instance;
+
+    if( eventInstance( event, &instance ) ) {
+        QVarLengthArray<EventCallback *, max_instance_callbacks> callbacks;
+        {
+            QMutexLocker lock( &event_callbacks_mutex );
+            auto it = instance_callbacks.constFind( instance );
 
-    for( int i = 0; i < ret; i++ ) {
-        foreach( auto cb, event_callbacks ) {
-            if( ( *cb )( event ) ) {
-                // callback handled the event, stop the loop
-                break;
+            for( ; it != instance_callbacks.constEnd() && it.key() == instance; ++it ) {
+                callbacks.append( it.value() );
             }
         }
 
-        event++;
+        // Called without the lock, their owners can't go away meanwhile, destroying a joystick takes sdl_mutex
+        for( auto cb : callbacks ) {
+            ( *cb )( event, timestamp );
+        }
+
+        return;
     }
 
+    // Only bumps a reference count, callbacks may register themselves while handling the event
+    event_callbacks_mutex.lock();
+    const QList<EventCallback *> callbacks = event_callbacks;
     event_callbacks_mutex.unlock();
+
+    foreach( auto cb, callbacks ) {
+        if( ( *cb )( event, timestamp ) ) {
+            // callback handled the event, stop the loop
+            break;
+        }
+    }
 }
 
+bool SDLEvents::eventInstance( const SDL_Event *event, SDL_JoystickID *instance ) const {
+    if( event->type == rumble_event_type ) {
+        *instance = event->user.code;
+        return true;
+    }
+
+    switch( event->type ) {
+        case SDL_JOYAXISMOTION:
+            *instance = event->jaxis.which;
+            return true;
+
+        case SDL_JOYBALLMOTION:
+            *instance = event->jball.which;
+            return true;
+
+        case SDL_JOYHATMOTION:
+            *instance = event->jhat.which;
+            return true;
+
+        case SDL_JOYBUTTONDOWN:
+        case SDL_JOYBUTTONUP:
+            *instance = event->jbutton.which;
+            return true;
+
+        case SDL_JOYDEVICEREMOVED:
+            *instance = event->jdevice.which;
+            return true;
+
+        case SDL_CONTROLLERAXISMOTION:
+            *instance = event->caxis.which;
+            return true;
+
+        case SDL_CONTROLLERBUTTONDOWN:
+        case SDL_CONTROLLERBUTTONUP:
+            *instance = event->cbutton.which;
+            return true;
+
+        case SDL_CONTROLLERDEVICEREMOVED:
+        case SDL_CONTROLLERDEVICEREMAPPED:
+            *instance = event->cdevice.which;
+            return true;
+
+        // Added events carry a device index, not an instance ID
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,446 @@
+#include <QOpenGLContext>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QDir>
+
+#include <cstring>
+
+#include "shaderchain.h"
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// Fixed, so they survive a round trip through the binary cache
+static const GLuint vertex_coord_location = 0;
+static const GLuint tex_coord_location = 1;
+
+// Desktop GLSL before 1.30 rejects precision qualifiers
+static const char fragment_prelude[] =
+    "#ifdef GL_ES\n"
+    "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+    "precision highp float;\n"
+    "#else\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "#endif\n";
+
+ShaderChain::ShaderChain()
+    : initialized( false ),
+      m_preset( "none" ),
+      quad( QOpenGLBuffer::VertexBuffer ),
+      frame_count( 0 ),
+      getProgramBinary( nullptr ),
+      programBinary( nullptr ),
+      programParameteri( nullptr ) {
+}
+
+ShaderChain::~ShaderChain() {
+    // GL resources must have been freed by release() while the context was still around
+}
+
+QStringList ShaderChain::presetNames() {
+    return QStringList() << "none" << "sharp-bilinear" << "crt" << "ntsc" << "ntsc-crt";
+}
+
+std::vector<ShaderChain::Pass> ShaderChain::presetPasses( const QString &name ) {
+    const Pass ntsc_encode = { "ntsc-encode.frag", Pass::ScaleSource, 4.0f, 1.0f, false };
+    const Pass ntsc_decode = { "ntsc-decode.frag", Pass::ScaleSource, 1.0f, 1.0f, false };
+
+    std::vector<Pass> result;
+
+    if( name == "sharp-bilinear" ) {
+        result.push_back( { "sharp-bilinear.frag", Pass::ScaleViewport, 1.0f, 1.0f, true } );
+    } else if( name == "crt" ) {
+        result.push_back( { "crt.frag", Pass::ScaleViewport, 1.0f, 1.0f, true } );
+    } else if( name == "ntsc" ) {
+        result.push_back( ntsc_encode );
+        result.push_back( ntsc_decode );
+        result.push_back( { "sharp-bilinear.frag", Pass::ScaleViewport, 1.0f, 1.0f, true } );
+    } else if( name == "ntsc-crt" ) {
+        result.push_back( ntsc_encode );
+        result.push_back( ntsc_decode );
+        result.push_back( { "crt.frag", Pass::ScaleViewport, 1.0f, 1.0f, true } );
+    }
+
+    return result;
+}
+
+void ShaderChain::initialize( const QString &cache_path ) {
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    Q_ASSERT( context );
+
+    initializeOpenGLFunctions();
+
+    // Two triangles covering the whole target, interleaved position and texture coordinates
+    static const GLfloat vertices[] = {
+        -1.0f, -1.0f, 0.0f, 0.0f,
+         1.0f, -1.0f, 1.0f, 0.0f,
+        -1.0f,  1.0f, 0.0f, 1.0f,
+         1.0f,  1.0f, 1.0f, 1.0f,
+    };
+
+    quad.create();
+    quad.bind();
+    quad.allocate( vertices, sizeof( vertices ) );
+    quad.release();
+
+    // Program binaries are core in GL 4.1 and GLES 3.0, extensions before that
+    QPair<int, int> version = context->format().version();
+    bool binaries_supported = context->isOpenGLES()
+                              ? ( version.first >= 3 || context->hasExtension( "GL_OES_get_program_binary" ) )
+                              : ( version >= qMakePair( 4, 1 ) || context->hasExtension( "GL_ARB_get_program_binary" ) );
+
+    if( binaries_supported ) {
+        const char *suffix = ( context->isOpenGLES() && version.first < 3 ) ? "OES" : "";
+        getProgramBinary = reinterpret_cast<GetProgramBinaryFn>(
+                               context->getProcAddress( QByteArray( "glGetProgramBinary" ) + suffix ) );
+        programBinary = reinterpret_cast<ProgramBinaryFn>(
+                            context->getProcAddress( QByteArray( "glProgramBinary" ) + suffix ) );
+        programParameteri = reinterpret_cast<ProgramParameteriFn>(
+                                context->getProcAddress( "glProgramParameteri" ) );
+    }
+
+    // Some drivers expose the entry points but no binary format at all
+    GLint format_count = 0;
+
+    if( getProgramBinary && programBinary ) {
+        glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &format_count );
+    }
+
+    if( format_count > 0 ) {
+        this->cache_path = cache_path;
+        QDir().mkpath( cache_path );
+
+        driver_key = QByteArray( reinterpret_cast<const char *>( glGetString( GL_VENDOR ) ) ) + '\n'
+                     + reinterpret_cast<const char *>( glGetString( GL_RENDERER ) ) + '\n'
+                     + reinterpret_cast<const char *>( glGetString( GL_VERSION ) ) + '\n';
+    } else {
+        qCDebug( phxVideo ) << "Program binaries not supported, shaders will be compiled on every launch";
+    }
+
+    initialized = true;
+}
+
+void ShaderChain::release() {
+    if( !initialized ) {
+        return;
+    }
+
+    clearPasses();
+    quad.destroy();
+    m_preset = "none";
+    initialized = false;
+}
+
+void ShaderChain::clearPasses() {
+    for( const Program &program : programs ) {
+        glDeleteProgram( program.id );
+    }
+
+    programs.clear();
+    fbos.clear();
+    passes.clear();
+}
+
+bool ShaderChain::setPreset( const QString &name ) {
+    if( !initialized ) {
+        return false;
+    }
+
+    clearPasses();
+    m_preset = "none";
+
+    std::vector<Pass> new_passes = presetPasses( name );
+
+    if( new_passes.empty() ) {
+        if( name != "none" ) {
+            qCWarning( phxVideo ) << "Unknown shader preset" << name;
+        }
+
+        return name == "none";
+    }
+
+    for( const Pass &pass : new_passes ) {
+        Program program;
+
+        if( !buildProgram( pass.fragment, program ) ) {
+            clearPasses();
+            return false;
+        }
+
+        programs.push_back( program );
+    }
+
+    passes = new_passes;
+    fbos.resize( passes.size() );
+    m_preset = name;
+    frame_count = 0;
+
+    qCDebug( phxVideo ) << "Shader preset" << name << "loaded," << passes.size() << "passes";
+    return true;
+}
+
+bool ShaderChain::buildProgram( const QString &fragment_file, Program &program ) {
+    QFile vertex_file( ":/shaders/stock.vert" );
+    QFile frag_file( ":/shaders/" + fragment_file );
+
+    if( !vertex_file.open( QIODevice::ReadOnly ) || !frag_file.open( QIODevice::ReadOnly ) ) {
+        qCWarning( phxVideo ) << "Unable to read shader" << fragment_file;
+        return false;
+    }
+
+    QByteArray vertex = vertex_file.readAll();
+    QByteArray fragment = fragment_prelude + frag_file.readAll();
+
+    GLuint id = 0;
+    QString cache_file;
+
+    if( !cache_path.isEmpty() ) {
+        QCryptographicHash hash( QCryptographicHash::Sha1 );
+        hash.addData( driver_key );
+        hash.addData( vertex );
+        hash.addData( fragment );
+        cache_file = cache_path + hash.result().toHex() + ".bin";
+
+        id = linkFromCache( cache_file );
+    }
+
+    if( !id ) {
+        id = linkFromSource( vertex, fragment );
+
+        if( !id ) {
+            qCWarning( phxVideo ) << "Unable to build shader" << fragment_file;
+            return false;
+        }
+
+        if( !cache_file.isEmpty() ) {
+            storeInCache( id, cache_file );
+        }
+    }
+
+    program.id = id;
+    program.source = glGetUniformLocation( id, "Source" );
+    program.source_size = glGetUniformLocation( id, "SourceSize" );
+    program.output_size = glGetUniformLocation( id, "OutputSize" );
+    program.original_size = glGetUniformLocation( id, "OriginalSize" );
+    program.frame_count = glGetUniformLocation( id, "FrameCount" );
+
+    return true;
+}
+
+GLuint ShaderChain::linkFromCache( const QString &file ) {
+    QFile cache( file );
+
+    if( !cache.open( QIODevice::ReadOnly ) || cache.size() <= qint64( sizeof( GLenum ) ) ) {
+        return 0;
+    }
+
+    QByteArray data = cache.readAll();
+    GLenum format;
+    memcpy( &format, data.constData(), sizeof( format ) );
+
+    GLuint program = glCreateProgram();
+    programBinary( program, format, data.constData() + sizeof( format ), data.size() - sizeof( format ) );
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv( program, GL_LINK_STATUS, &linked );
+
+    if( !linked ) {
+        // Stale entry (driver update, ...), it'll be replaced
+        glDeleteProgram( program );
+        cache.remove();
+        return 0;
+    }
+
+    return program;
+}
+
+void ShaderChain::storeInCache( GLuint program, const QString &file ) {
+    GLint length = 0;
+    glGetProgramiv( program, GL_PROGRAM_BINARY_LENGTH, &length );
+
+    if( length <= 0 ) {
+        return;
+    }
+
+    QByteArray data( int( sizeof( GLenum ) ) + length, Qt::Uninitialized );
+    GLenum format = 0;
+    getProgramBinary( program, length, &length, &format, data.data() + sizeof( GLenum ) );
+    memcpy( data.data(), &format, sizeof( format ) );
+    data.resize( int( sizeof( GLenum ) ) + length );
+
+    QFile cache( file );
+
+    if( !cache.open( QIODevice::WriteOnly ) || cache.write( data ) != data.size() ) {
+        qCWarning( phxVideo ) << "Unable to write shader cache" << file;
+        cache.remove();
+    }
+}
+
+GLuint ShaderChain::linkFromSource( const QByteArray &vertex, const QByteArray &fragment ) {
+    GLuint vertex_shader = compileShader( GL_VERTEX_SHADER, vertex );
+    GLuint fragment_shader = compileShader( GL_FRAGMENT_SHADER, fragment );
+
+    if( !vertex_shader || !fragment_shader ) {
+        glDeleteShader( vertex_shader );
+        glDeleteShader( fragment_shader );
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader( program, vertex_shader );
+    glAttachShader( program, fragment_shader );
+    glBindAttribLocation( program, vertex_coord_location, "VertexCoord" );
+    glBindAttribLocation( program, tex_coord_location, "TexCoord" );
+
+    if( programParameteri && !cache_path.isEmpty() ) {
+        programParameteri( program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+    }
+
+    glLinkProgram( program );
+
+    // Flagged for deletion, they go away with the program
+    glDeleteShader( vertex_shader );
+    glDeleteShader( fragment_shader );
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv( program, GL_LINK_STATUS, &linked );
+
+    if( !linked ) {
+        char log[1024];
+        glGetProgramInfoLog( program, sizeof( log ), nullptr, log );
+        qCWarning( phxVideo ) << "Shader link failed:" << log;
+        glDeleteProgram( program );
+        return 0;
+    }
+
+    return program;
+}
+
+GLuint ShaderChain::compileShader( GLenum type, const QByteArray &source ) {
+    GLuint shader = glCreateShader( type );
+    const char *data = source.constData();
+    glShaderSource( shader, 1, &data, nullptr );
+    glCompileShader( shader );
+
+    GLint compiled = GL_FALSE;
+    glGetShaderiv( shader, GL_COMPILE_STATUS, &compiled );
+
+    if( !compiled ) {
+        char log[1024];
+        glGetShaderInfoLog( shader, sizeof( log ), nullptr, log );
+        qCWarning( phxVideo ) << "Shader compilation failed:" << log;
+        glDeleteShader( shader );
+        return 0;
+    }
+
+    return shader;
+}
+
+void ShaderChain::resizeTargets( const QSize &input_size, const QSize &output_size ) {
+    QSize size = input_size;
+
+    for( size_t i = 0; i < passes.size(); i++ ) {
+        const Pass &pass = passes[i];
+
+        if( i == passes.size() - 1 ) {
+            size = output_size;
+        } else {
+            const QSize &base = pass.scale_type == Pass::ScaleViewport ? output_size : size;
+            size = QSize( qMax( 1, qRound( base.width() * pass.scale_x ) ),
+                          qMax( 1, qRound( base.height() * pass.scale_y ) ) );
+        }
+
+        // Only reallocated when the core or the window changes size
+        if( !fbos[i] || fbos[i]->size() != size ) {
+            fbos[i].reset( new QOpenGLFramebufferObject( size ) );
+        }
+    }
+}
+
+GLuint ShaderChain::render( GLuint input_texture, const QSize &input_size, const QSize &output_size ) {
+    if( !isEnabled() || input_size.isEmpty() || output_size.isEmpty() ) {
+        return input_texture;
+    }
+
+    resizeTargets( input_size, output_size );
+
+    GLint previous_fbo = 0;
+    glGetIntegerv( GL_FRAMEBUFFER_BINDING, &previous_fbo );
+
+    glDisable( GL_BLEND );
+    glDisable( GL_DEPTH_TEST );
+    glDisable( GL_SCISSOR_TEST );
+    glDisable( GL_STENCIL_TEST );
+
+    quad.bind();
+    glEnableVertexAttribArray( vertex_coord_location );
+    glEnableVertexAttribArray( tex_coord_location );
+    glVertexAttribPointer( vertex_coord_location, 2, GL_FLOAT, GL_FALSE, 4 * sizeof( GLfloat ), nullptr );
+    glVertexAttribPointer( tex_coord_location, 2, GL_FLOAT, GL_FALSE, 4 * sizeof( GLfloat ),
+                           reinterpret_cast<const void *>( 2 * sizeof( GLfloat ) ) );
+
+    GLuint source = input_texture;
+    QSize source_size = input_size;
+
+    for( size_t i = 0; i < passes.size(); i++ ) {
+        const Program &program = programs[i];
+        QOpenGLFramebufferObject *target = fbos[i].get();
+        QSize target_size = target->size();
+
+        target->bind();
+        glViewport( 0, 0, target_size.width(), target_size.height() );
+
+        GLint filter = passes[i].filter_linear ? GL_LINEAR : GL_NEAREST;
+        glActiveTexture( GL_TEXTURE0 );
+        glBindTexture( GL_TEXTURE_2D, source );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+        glUseProgram( program.id );
+        glUniform1i( program.source, 0 );
+
+        if( program.source_size >= 0 ) {
+            glUniform4f( program.source_size, source_size.width(), source_size.height(),
+                         1.0f / source_size.width(), 1.0f / source_size.height() );
+        }
+
+        if( program.output_size >= 0 ) {
+            glUniform4f( program.output_size, target_size.width(), target_size.height(),
+                         1.0f / target_size.width(), 1.0f / target_size.height() );
+        }
+
+        if( program.original_size >= 0 ) {
+            glUniform4f( program.original_size, input_size.width(), input_size.height(),
+                         1.0f / input_size.width(), 1.0f / input_size.height() );
+        }
+
+        if( program.frame_count >= 0 ) {
+            glUniform1i( program.frame_count, frame_count );
+        }
+
+        glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+
+        source = target->texture();
+        source_size = target_size;
+    }
+
+    glDisableVertexAttribArray( vertex_coord_location );
+    glDisableVertexAttribArray( tex_coord_location );
+    quad.release();
+    glBindFramebuffer( GL_FRAMEBUFFER, previous_fbo );
+
+    frame_count++;
+    return source;
+}
@@ -0,0 +1,410 @@
+#include <QtConcurrent>
+#include <QElapsedTimer>
+#include <QThread>
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "videofilter.h"
+
+//
+// Row helpers
+//
+
+// Duplicates every pixel of a row factor times
+static inline void expandRow( const quint32 *in, unsigned width, quint32 *out, unsigned factor ) {
+    unsigned x = 0;
+
+    if( factor == 2 ) {
+#ifdef __SSE2__
+
+        for( ; x + 4 <= width; x += 4 ) {
+            __m128i p = _mm_loadu_si128( reinterpret_cast<const __m128i *>( in + x ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i *>( out + x * 2 ), _mm_unpacklo_epi32( p, p ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i *>( out + x * 2 + 4 ), _mm_unpackhi_epi32( p, p ) );
+        }
+
+#endif
+
+        for( ; x < width; x++ ) {
+            out[x * 2] = out[x * 2 + 1] = in[x];
+        }
+
+        return;
+    }
+
+    for( ; x < width; x++ ) {
+        for( unsigned i = 0; i < factor; i++ ) {
+            out[x * factor + i] = in[x];
+        }
+    }
+}
+
+// Copies a row at 75% brightness
+static inline void darkenRow( const quint32 *in, quint32 *out, size_t count ) {
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i half_mask = _mm_set1_epi32( 0x7f7f7f7f );
+    const __m128i quarter_mask = _mm_set1_epi32( 0x3f3f3f3f );
+
+    for( ; i + 4 <= count; i += 4 ) {
+        __m128i p = _mm_loadu_si128( reinterpret_cast<const __m128i *>( in + i ) );
+        __m128i half = _mm_and_si128( _mm_srli_epi32( p, 1 ), half_mask );
+        __m128i quarter = _mm_and_si128( _mm_srli_epi32( p, 2 ), quarter_mask );
+        _mm_storeu_si128( reinterpret_cast<__m128i *>( out + i ), _mm_add_epi32( half, quarter ) );
+    }
+
+#endif
+
+    for( ; i < count; i++ ) {
+        out[i] = ( ( in[i] >> 1 ) & 0x7f7f7f7f ) + ( ( in[i] >> 2 ) & 0x3f3f3f3f );
+    }
+}
+
+//
+// NearestFilter
+//
+
+void NearestFilter::process( const quint32 *src, size_t src_pitch, unsigned width, unsigned height,
+                             quint32 *dst, size_t dst_pitch, unsigned first_row, unsigned last_row ) const {
+    Q_UNUSED( height );
+
+    for( unsigned y = first_row; y < last_row; y++ ) {
+        quint32 *out = dst + y * factor * dst_pitch;
+        expandRow( src + y * src_pitch, width, out, factor );
+
+        for( unsigned i = 1; i < factor; i++ ) {
+            memcpy( out + i * dst_pitch, out, width * factor * sizeof( quint32 ) );
+        }
+    }
+}
+
+//
+// Scale2xFilter
+//
+
+// B
+// D E F
+// H
+static inline void scale2xPixel( const quint32 *row_b, const quint32 *row_e, const quint32 *row_h,
+                                 unsigned x, unsigned width, quint32 *out0, quint32 *out1 ) {
+    quint32 b = row_b[x];
+    quint32 e = row_e[x];
+    quint32 h = row_h[x];
+    quint32 d = x > 0 ? row_e[x - 1] : e;
+    quint32 f = x + 1 < width ? row_e[x + 1] : e;
+
+    if( b != h && d != f ) {
+        out0[x * 2] = d == b ? d : e;
+        out0[x * 2 + 1] = b == f ? f : e;
+        out1[x * 2] = d == h ? d : e;
+        out1[x * 2 + 1] = h == f ? f : e;
+    } else {
+        out0[x * 2] = out0[x * 2 + 1] = e;
+        out1[x * 2] = out1[x * 2 + 1] = e;
+    }
+}
+
+#ifdef __SSE2__
+static inline __m128i blend( __m128i mask, __m128i a, __m128i b ) {
+    return _mm_or_si128( _mm_and_si128( mask, a ), _mm_andnot_si128( mask, b ) );
+}
+#endif
+
+void Scale2xFilter::process( const quint32 *src, size_t src_pitch, unsigned width, unsigned height,
+                             quint32 *dst, size_t dst_pitch, unsigned first_row, unsigned last_row ) const {
+    for( unsigned y = first_row; y < last_row; y++ ) {
+        const quint32 *row_b = src + ( y > 0 ? y - 1 : y ) * src_pitch;
+        const quint32 *row_e = src + y * src_pitch;
+        const quint32 *row_h = src + ( y + 1 < height ? y + 1 : y ) * src_pitch;
+        quint32 *out0 = dst + y * 2 * dst_pitch;
+        quint32 *out1 = out0 + dst_pitch;
+
+        scale2xPixel( row_b, row_e, row_h, 0, width, out0, out1 );
+        unsigned x = 1;
+
+#ifdef __SSE2__
+
+        // Four pixels at a time, D and F are the same row shifted by one pixel
+        for( ; x + 4 < width; x += 4 ) {
+            __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i *>( row_b + x ) );
+            __m128i e = _mm_loadu_si128( reinterpret_cast<const __m128i *>( row_e + x ) );
+            __m128i h = _mm_loadu_si128( reinterpret_cast<const __m128i *>( row_h + x ) );
+            __m128i d = _mm_loadu_si128( reinterpret_cast<const __m128i *>( row_e + x - 1 ) );
+            __m128i f = _mm_loadu_si128( reinterpret_cast<const __m128i *>( row_e + x + 1 ) );
+
+            __m128i eq_db = _mm_cmpeq_epi32( d, b );
+            __m128i eq_bf = _mm_cmpeq_epi32( b, f );
+            __m128i eq_dh = _mm_cmpeq_epi32( d, h );
+            __m128i eq_fh = _mm_cmpeq_epi32( f, h );
+
+            // Same rules as scale2xPixel(), expanded so each output only needs one mask
+            __m128i e0 = blend( _mm_andnot_si128( eq_dh, _mm_andnot_si128( eq_bf, eq_db ) ), d, e );
+            __m128i e1 = blend( _mm_andnot_si128( eq_fh, _mm_andnot_si128( eq_db, eq_bf ) ), f, e );
+            __m128i e2 = blend( _mm_andnot_si128( eq_fh, _mm_andnot_si128( eq_db, eq_dh ) ), d, e );
+            __m128i e3 = blend( _mm_andnot_si128( eq_bf, _mm_andnot_si128( eq_dh, eq_fh ) ), f, e );
+
+            _mm_storeu_si128( reinterpret_cast<__m128i *>( out0 + x * 2 ), _mm_unpacklo_epi32( e0, e1 ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i *>( out0 + x * 2 + 4 ), _mm_unpackhi_epi32( e0, e1 ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i *>( out1 + x * 2 ), _mm_unpacklo_epi32( e2, e3 ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i *>( out1 + x * 2 + 4 ), _mm_unpackhi_epi32( e2, e3 ) );
+        }
+
+#endif
+
+        for( ; x < width; x++ ) {
+            scale2xPixel( row_b, row_e, row_h, x, width, out0, out1 );
+        }
+    }
+}
+
+//
+// Scale3xFilter
+//
+
+void Scale3xFilter::process( const quint32 *src, size_t src_pitch, unsigned width, unsigned height,
+                             quint32 *dst, size_t dst_pitch, unsigned first_row, unsigned last_row ) const {
+    for( unsigned y = first_row; y < last_row; y++ ) {
+        const quint32 *row_b = src + ( y > 0 ? y - 1 : y ) * src_pitch;
+        const quint32 *row_e = src + y * src_pitch;
+        const quint32 *row_h = src + ( y + 1 < height ? y + 1 : y ) * src_pitch;
+        quint32 *out0 = dst + y * 3 * dst_pitch;
+        quint32 *out1 = out0 + dst_pitch;
+        quint32 *out2 = out1 + dst_pitch;
+
+        for( unsigned x = 0; x < width; x++ ) {
+            // A B C
+            // D E F
+            // G H I
+            unsigned xl = x > 0 ? x - 1 : x;
+            unsigned xr = x + 1 < width ? x + 1 : x;
+            quint32 a = row_b[xl], b = row_b[x], c = row_b[xr];
+            quint32 d = row_e[xl], e = row_e[x], f = row_e[xr];
+            quint32 g = row_h[xl], h = row_h[x], i = row_h[xr];
+
+            quint32 *o0 = out0 + x * 3;
+            quint32 *o1 = out1 + x * 3;
+            quint32 *o2 = out2 + x * 3;
+
+            if( b != h && d != f ) {
+                o0[0] = d == b ? d : e;
+                o0[1] = ( d == b && e != c ) || ( b == f && e != a ) ? b : e;
+                o0[2] = b == f ? f : e;
+                o1[0] = ( d == b && e != g ) || ( d == h && e != a ) ? d : e;
+                o1[1] = e;
+                o1[2] = ( b == f && e != i ) || ( h == f && e != c ) ? f : e;
+                o2[0] = d == h ? d : e;
+                o2[1] = ( d == h && e != i ) || ( h == f && e != g ) ? h : e;
+                o2[2] = h == f ? f : e;
+            } else {
+                o0[0] = o0[1] = o0[2] = e;
+                o1[0] = o1[1] = o1[2] = e;
+                o2[0] = o2[1] = o2[2] = e;
+            }
+        }
+    }
+}
+
+//
+// ScanlinesFilter
+//
+
+void ScanlinesFilter::process( const quint32 *src, size_t src_pitch, unsigned width, unsigned height,
+                               quint32 *dst, size_t dst_pitch, unsigned first_row, unsigned last_row ) const {
+    Q_UNUSED( height );
+
+    const size_t out_width = width * factor;
+
+    for( unsigned y = first_row; y < last_row; y++ ) {
+        quint32 *out = dst + y * factor * dst_pitch;
+        expandRow( src + y * src_pitch, width, out, factor );
+
+        for( unsigned i = 1; i + 1 < factor; i++ ) {
+            memcpy( out + i * dst_pitch, out, out_width * sizeof( quint32 ) );
+        }
+
+        darkenRow( out, out + ( factor - 1 ) * dst_pitch, out_width );
+    }
+}
+
+//
+// VideoFilterPipeline
+//
+
+VideoFilterPipeline::VideoFilterPipeline()
+    : m_filter( "none" ),
+      total_nsecs( 0 ),
+      frame_count( 0 ),
+      stage_count( 0 ) {
+
+    for( auto &nsecs : stage_nsecs ) {
+        nsecs = 0;
+    }
+}
+
+VideoFilterPipeline::~VideoFilterPipeline() {
+}
+
+QStringList VideoFilterPipeline::filterNames() {
+    return {
+        "none",
+        "nearest2x", "nearest3x", "nearest4x",
+        "scale2x", "scale3x", "scale4x",
+        "scanlines2x", "scanlines3x",
+    };
+}
+
+bool VideoFilterPipeline::setFilter( const QString &name ) {
+    std::vector<std::unique_ptr<VideoFilter>> chain;
+
+    if( name == "nearest2x" ) {
+        chain.emplace_back( new NearestFilter( 2 ) );
+    } else if( name == "nearest3x" ) {
+        chain.emplace_back( new NearestFilter( 3 ) );
+    } else if( name == "nearest4x" ) {
+        chain.emplace_back( new NearestFilter( 4 ) );
+    } else if( name == "scale2x" ) {
+        chain.emplace_back( new Scale2xFilter );
+    } else if( name == "scale3x" ) {
+        chain.emplace_back( new Scale3xFilter );
+    } else if( name == "scale4x" ) {
+        // Scale4x is defined as Scale2x applied twice
+        chain.emplace_back( new Scale2xFilter );
+        chain.emplace_back( new Scale2xFilter );
+    } else if( name == "scanlines2x" ) {
+        chain.emplace_back( new ScanlinesFilter( 2 ) );
+    } else if( name == "scanlines3x" ) {
+        chain.emplace_back( new ScanlinesFilter( 3 ) );
+    } else if( name != "none" && !name.isEmpty() ) {
+        return false;
+    }
+
+    Q_ASSERT( chain.size() <= max_stages );
+
+    stages.swap( chain );
+    buffers.resize( stages.size() + 1 );
+    m_filter = name.isEmpty() ? QString( "none" ) : name;
+    stage_count = stages.size();
+    takeAverageCost();
+
+    return true;
+}
+
+QImage VideoFilterPipeline::process( const void *data, unsigned width, unsigned height, size_t pitch, retro_pixel_format format ) {
+    QElapsedTimer timer;
+    timer.start();
+
+    convert( data, width, height, pitch, format );
+
+    qint64 last = timer.nsecsElapsed();
+    stage_nsecs[0] += last;
+
+    unsigned w = width;
+    unsigned h = height;
+
+    for( size_t i = 0; i < stages.size(); i++ ) {
+        const VideoFilter *filter = stages[i].get();
+        const unsigned s = filter->scale();
+
+        buffers[i + 1].resize( w * s * h * s );
+        const quint32 *src = buffers[i].data();
+        quint32 *dst = buffers[i + 1].data();
+
+        splitBands( h );
+        QtConcurrent::blockingMap( bands, [ = ]( Band & band ) {
+            filter->process( src, w, w, h, dst, w * s, band.first_row, band.last_row );
+        } );
+
+        w *= s;
+        h *= s;
+
+        qint64 now = timer.nsecsElapsed();
+        stage_nsecs[i + 1] += now - last;
+        last = now;
+    }
+
+    total_nsecs += last;
+    frame_count++;
+
+    return QImage( reinterpret_cast<const uchar *>( buffers.back().data() ), w, h, w * sizeof( quint32 ), QImage::Format_RGB32 );
+}
+
+qreal VideoFilterPipeline::takeAverageCost( QString *report ) {
+    qint64 frames = frame_count.exchange( 0 );
+    qint64 total = total_nsecs.exchange( 0 );
+
+    if( report ) {
+        report->clear();
+    }
+
+    for( size_t i = 0; i <= max_stages; i++ ) {
+        qint64 nsecs = stage_nsecs[i].exchange( 0 );
+
+        if( report && frames && i <= stage_count ) {
+            *report += QString( "%1%2 %3us" ).arg( i ? ", " : "" )
+                       .arg( i ? QString( "stage %1" ).arg( i ) : QString( "convert" ) )
+                       .arg( nsecs / frames / 1000.0, 0, 'f', 1 );
+        }
+    }
+
+    if( !frames ) {
+        return 0.0;
+    }
+
+    return total / frames / 1000.0;
+}
+
+void VideoFilterPipeline::splitBands( unsigned height ) {
+    // Bands smaller than this cost more in scheduling than they save
+    const unsigned min_band_rows = 16;
+
+    unsigned count = qBound( 1u, height / min_band_rows, static_cast<unsigned>( qMax( 1, QThread::idealThreadCount() ) ) );
+    bands.resize( count );
+
+    for( unsigned i = 0; i < count; i++ ) {
+        bands[i].first_row = height * i / count;
+        bands[i].last_row = height * ( i + 1 ) / count;
+    }
+}
+
+void VideoFilterPipeline::convert( const void *data, unsigned width, unsigned height, size_t pitch, retro_pixel_format format ) {
+    std::vector<quint32> &out = buffers[0];
+    out.resize( width * height );
+
+    for( unsigned y = 0; y < height; y++ ) {
+        const uchar *row = static_cast<const uchar *>( data ) + y * pitch;
+        quint32 *dst = out.data() + y * width;
+
+        if( format == RETRO_PIXEL_FORMAT_XRGB8888 ) {
+            // The X byte is undefined, force it so the edge detection compares colors only
+            const quint32 *src = reinterpret_cast<const quint32 *>( row );
+
+            for( unsigned x = 0; x < width; x++ ) {
+                dst[x] = src[x] | 0xff000000;
+            }
+        } else if( format == RETRO_PIXEL_FORMAT_RGB565 ) {
+            const quint16 *src = reinterpret_cast<const quint16 *>( row );
+
+            for( unsigned x = 0; x < width; x++ ) {
+                quint32 p = src[x];
+                quint32 r = ( p >> 11 ) & 0x1f;
+                quint32 g = ( p >> 5 ) & 0x3f;
+                quint32 b = p & 0x1f;
+                dst[x] = 0xff000000 | ( ( r << 3 | r >> 2 ) << 16 ) | ( ( g << 2 | g >> 4 ) << 8 ) | ( b << 3 | b >> 2 );
+            }
+        } else {
+            const quint16 *src = reinterpret_cast<const quint16 *>( row );
+
+            for( unsigned x = 0; x < width; x++ ) {
+                quint32 p = src[x];
+                quint32 r = ( p >> 10 ) & 0x1f;
+                quint32 g = ( p >> 5 ) & 0x1f;
+                quint32 b = p & 0x1f;
+                dst[x] = 0xff000000 | ( ( r << 3 | r >> 2 ) << 16 ) | ( ( g << 3 | g >> 2 ) << 8 ) | ( b << 3 | b >> 2 );
+            }
+        }
+    }
+}
@@ -1,33 +1,83 @@
 
+#include <QtMath>
+#include <QRunnable>
+
 #include "videoitem.h"
 #include "phoenixglobals.h"
 
+// Deletes the frame's textures once the rendering thread gets to it, with the scene graph's context current
+class TextureCleanup : public QRunnable {
+    public:
+        TextureCleanup( QSGTexture *texture, QSGTexture *shader_texture, QOpenGLTexture *frame_texture )
+            : texture( texture ), shader_texture( shader_texture ), frame_texture( frame_texture ) {
+        }
+
+        void run() override {
+            delete shader_texture;
+            delete texture;
+            delete frame_texture;
+        }
+
+    private:
+        QSGTexture *texture;
+        QSGTexture *shader_texture;
+        QOpenGLTexture *frame_texture;
+};
+
 VideoItem::VideoItem() {
 
-    // Set up the audio output thread and its update timer
+    // Set up the audio output thread, the sound card pulls data from it as needed
     audioThread.setObjectName( "phoenix-audio" );
     audio.moveToThread( &audioThread );
-    audioTimer.moveToThread( &audioThread );
-    audioTimer.setInterval( 16 );
 
     connect( &audioThread, &QThread::started, &audio, &Audio::slotThreadStarted );
-    connect( &audioTimer, &QTimer::timeout, &audio, &Audio::slotHandlePeriodTimer );
 
-    connect( &audio, &Audio::signalStartTimer, &audioTimer, static_cast<void ( QTimer::* )( void )> ( &QTimer::start ) );
-    connect( &audio, &Audio::signalStopTimer, &audioTimer, &QTimer::stop );
+    if( !phxGlobals.nullAudioOutput().isEmpty() ) {
+        QMetaObject::invokeMethod( &audio, "slotSetNullOutput", Qt::QueuedConnection,
+                                   Q_ARG( QString, phxGlobals.nullAudioOutput() ) );
+    }
 
     audioThread.start();
 
     // This operation is not thread-safe, but audioBuf never changes throughout the life of audio, so I suppose it doesn't matter?
     core.audio_buf = audio.getAudioBuf();
+    core.recorder = &recorder;
+
+    if( phxGlobals.measureInputLatency() ) {
+        core.latency_monitor = &latency_monitor;
+    }
+
+    connect( &recorder, &Recorder::recordingChanged, this, &VideoItem::recordingChanged );
+    connect( &screenshot, &Screenshot::saved, this, &VideoItem::handleScreenshotSaved );
 
     texture = nullptr;
+    frame_texture = nullptr;
+    frame_texture_format = RETRO_PIXEL_FORMAT_UNKNOWN;
+    shader_texture = nullptr;
+    viewport_dirty = true;
+    viewport_pixel_ratio = 1.0;
     m_libcore = "";
     m_stretch_video = false;
+    m_integer_scaling = false;
     m_filtering = 2;
     m_aspect_ratio = 0.0;
+    m_video_filter = "none";
+    m_video_filter_cost = 0.0;
+    m_shader_preset = "none";
+    loaded_shader_preset = "none";
     m_fps = 0;
     m_volume = 1.0;
+    m_resampler_quality = "sinc-medium";
+    m_resampler_cost = 0.0;
+    logged_resampler_cost = 0.0;
+    m_sync_mode = "video";
+    m_audio_buffer_fill = 0.0;
+    audio_fill_sum = 0.0;
+    audio_fill_min = 0.0;
+    audio_fill_max = 0.0;
+    audio_fill_samples = 0;
+    repeated_frames = 0;
+    logged_audio_fill = 0.0;
 
     connect( &fps_timer, &QTimer::timeout, this, &VideoItem::updateFps );
     frame_timer.invalidate();
@@ -36,17 +86,37 @@ VideoItem::VideoItem() {
 
     connect( this, &VideoItem::runChanged, &audio, &Audio::slotRunChanged );
     connect( this, &VideoItem::volumeChanged, &audio, &Audio::slotSetVolume );
+    connect( this, &VideoItem::resamplerQualityChanged, &audio, &Audio::slotSetResamplerQuality );
     connect( this, &VideoItem::windowChanged, this, &VideoItem::handleWindowChanged );
 }
 
 VideoItem::~VideoItem() {
 
     audioThread.exit();
+
+    // The audio output gets destroyed right after, a null output finishes its file then
+    audioThread.wait();
     fps_timer.stop();
 
-    if( texture ) {
-        texture->deleteLater();
+    // QQuickItem's destructor only calls its own releaseResources()
+    scheduleTextureCleanup();
+}
+
+void VideoItem::releaseResources() {
+    scheduleTextureCleanup();
+}
+
+void VideoItem::scheduleTextureCleanup() {
+    // Without a window the scene graph is gone, and handleSceneGraphInvalidated() freed them already
+    if( !window() || ( !texture && !shader_texture && !frame_texture ) ) {
+        return;
     }
+
+    window()->scheduleRenderJob( new TextureCleanup( texture, shader_texture, frame_texture ),
+                                 QQuickWindow::BeforeSynchronizingStage );
+    texture = nullptr;
+    shader_texture = nullptr;
+    frame_texture = nullptr;
 }
 
 void VideoItem::handleWindowChanged( QQuickWindow *win ) {
@@ -56,9 +126,19 @@ void VideoItem::handleWindowChanged( QQuickWindow *win ) {
         // a Qt::DirectConnection
         setFlag( QQuickItem::ItemHasContents, true );
         connect( win, &QQuickWindow::frameSwapped, this, &VideoItem::update );
+
+        // Right when it happens, on the rendering thread, which is where the rest of the measurements come from
+        if( core.latency_monitor ) {
+            connect( win, &QQuickWindow::frameSwapped, this, [this] {
+                latency_monitor.frameSwapped();
+            }, Qt::DirectConnection );
+        }
         connect( win, &QQuickWindow::widthChanged, this, &VideoItem::handleGeometryChanged );
         connect( win, &QQuickWindow::heightChanged, this, &VideoItem::handleGeometryChanged );
         connect( win, &QQuickWindow::sceneGraphInitialized, this, &VideoItem::handleSceneGraphInitialized );
+        // GL resources must be freed on the rendering thread, while the context is still current
+        connect( win, &QQuickWindow::sceneGraphInvalidated, this, &VideoItem::handleSceneGraphInvalidated,
+                 Qt::DirectConnection );
 
         // If we allow QML to do the clearing, they would clear what we paint
         // and nothing would show.
@@ -67,23 +147,86 @@ void VideoItem::handleWindowChanged( QQuickWindow *win ) {
     }
 }
 
+void VideoItem::geometryChanged( const QRectF &new_geometry, const QRectF &old_geometry ) {
+    QQuickItem::geometryChanged( new_geometry, old_geometry );
+    viewport_dirty = true;
+    update();
+}
+
 void VideoItem::refreshItemGeometry() {
-    qreal pixel_ratio = window()->devicePixelRatio();
-    item_w = int( pixel_ratio * width() );
-    item_h = int( pixel_ratio * height() );
-    item_aspect = ( qreal )item_w / item_h;
-    viewportXY = mapToScene( QPointF( x(), height() + y() ) ).toPoint();
-    viewportXY.setY( window()->height() - viewportXY.y() );
+    viewport_pixel_ratio = window()->devicePixelRatio();
+    viewport_base_size = QSize( core.getBaseWidth(), core.getBaseHeight() );
+    viewport_dirty = false;
+
+    // Everything is worked out in device pixels, so the result can be snapped to whole pixels
+    QSizeF item_size = QSizeF( width(), height() ) * viewport_pixel_ratio;
+    QSizeF size = item_size;
+    int base_w = viewport_base_size.width();
+    int base_h = viewport_base_size.height();
+
+    if( !stretchVideo() && base_w && base_h && !item_size.isEmpty() ) {
+        qreal aspect = aspectRatio() > 0.0 ? aspectRatio() : qreal( base_w ) / base_h;
+
+        // Largest rectangle with the right aspect ratio that fits
+        size = QSizeF( item_size.height() * aspect, item_size.height() );
+
+        if( size.width() > item_size.width() ) {
+            size = QSizeF( item_size.width(), item_size.width() / aspect );
+        }
+
+        // Whole multiple of the core's height, width follows the aspect ratio.
+        // Windows smaller than the native resolution fall back to the plain fit.
+        if( integerScaling() ) {
+            int scale = int( size.height() / base_h );
+
+            if( scale >= 1 ) {
+                size = QSizeF( qRound( base_h * scale * aspect ), base_h * scale );
+            }
+        }
+    }
+
+    viewport_pixel_size = QSize( qRound( size.width() ), qRound( size.height() ) );
+    QPointF origin( qFloor( ( item_size.width() - viewport_pixel_size.width() ) / 2.0 ),
+                    qFloor( ( item_size.height() - viewport_pixel_size.height() ) / 2.0 ) );
+    viewport_rect = QRectF( origin / viewport_pixel_ratio, QSizeF( viewport_pixel_size ) / viewport_pixel_ratio );
+
+    qCDebug( phxVideo ) << "Viewport:" << viewport_rect << viewport_pixel_size << "for a"
+                        << viewport_base_size << "frame";
 }
 
 void VideoItem::handleSceneGraphInitialized() {
-    refreshItemGeometry();
     // initialize texture_node with an empty 1x1 black image
     QImage emptyImage( 1, 1, QImage::Format_RGB32 );
     emptyImage.fill( Qt::black );
     texture = window()->createTextureFromImage( emptyImage );
 }
 
+void VideoItem::handleSceneGraphInvalidated() {
+    delete shader_texture;
+    shader_texture = nullptr;
+    delete texture;
+    texture = nullptr;
+    delete frame_texture;
+    frame_texture = nullptr;
+    shader_chain.release();
+    loaded_shader_preset = "none";
+}
+
+void VideoItem::initGL() {
+    shader_chain.initialize( phxGlobals.configPath() + "ShaderCache/" );
+}
+
+void VideoItem::initShader() {
+    delete shader_texture;
+    shader_texture = nullptr;
+
+    if( !shader_chain.setPreset( m_shader_preset ) ) {
+        qCWarning( phxVideo ) << "Unable to load shader preset" << m_shader_preset << ", drawing without shaders";
+    }
+
+    loaded_shader_preset = m_shader_preset;
+}
+
 void VideoItem::setWindowed( bool windowVisibility ) {
 
     m_set_windowed = windowVisibility;
@@ -105,15 +248,125 @@ void VideoItem::setSystemDirectory( QString systemDirectory ) {
 
 void VideoItem::setAspectRatio( qreal aspectRatio ) {
     m_aspect_ratio = aspectRatio;
+    viewport_dirty = true;
     emit aspectRatioChanged();
 }
 
+void VideoItem::setIntegerScaling( bool integerScaling ) {
+    m_integer_scaling = integerScaling;
+    viewport_dirty = true;
+    update();
+    emit integerScalingChanged();
+}
+
+
+void VideoItem::setVideoFilter( QString videoFilter ) {
+    if( !VideoFilterPipeline::filterNames().contains( videoFilter ) ) {
+        qCWarning( phxVideo ) << "Unknown video filter" << videoFilter;
+        return;
+    }
+
+    // Picked up by the rendering thread on the next updatePaintNode()
+    m_video_filter = videoFilter;
+    emit videoFilterChanged();
+}
+
+void VideoItem::setShaderPreset( QString shaderPreset ) {
+    if( !ShaderChain::presetNames().contains( shaderPreset ) ) {
+        qCWarning( phxVideo ) << "Unknown shader preset" << shaderPreset;
+        return;
+    }
+
+    // Loaded by the rendering thread on the next updatePaintNode()
+    m_shader_preset = shaderPreset;
+    emit shaderPresetChanged();
+}
+
+void VideoItem::setResamplerQuality( QString resamplerQuality ) {
+    if( !AudioResampler::qualityNames().contains( resamplerQuality ) ) {
+        qCWarning( phxAudio ) << "Unknown resampler quality" << resamplerQuality;
+        return;
+    }
+
+    // Applied on the audio thread
+    m_resampler_quality = resamplerQuality;
+    emit resamplerQualityChanged( resamplerQuality );
+}
+
+void VideoItem::setAudioDevice( QString audioDevice ) {
+    if( audioDevice == m_audio_device ) {
+        return;
+    }
+
+    // Switched on the audio thread, the core keeps running
+    m_audio_device = audioDevice;
+    QMetaObject::invokeMethod( &audio, "slotSetDevice", Qt::QueuedConnection, Q_ARG( QString, audioDevice ) );
+    emit audioDeviceChanged();
+}
+
+void VideoItem::setSyncMode( QString syncMode ) {
+    if( !getSyncModes().contains( syncMode ) ) {
+        qCWarning( phxVideo ) << "Unknown sync mode" << syncMode;
+        return;
+    }
+
+    // Read by the rendering thread on the next updatePaintNode()
+    m_sync_mode = syncMode;
+    QMetaObject::invokeMethod( &audio, "slotSetAudioMaster", Qt::QueuedConnection,
+                               Q_ARG( bool, syncMode == "audio" ) );
+    emit syncModeChanged();
+}
+
+void VideoItem::updateFps() {
+    m_fps = fps_count * ( 1000.0 / fps_timer.interval() );
+    fps_count = 0;
+    emit fpsChanged( m_fps );
+
+    if( m_video_filter != "none" ) {
+        QString report;
+        m_video_filter_cost = filter_pipeline.takeAverageCost( &report );
+        qCDebug( phxVideo ) << "Filter" << m_video_filter << "cost per frame:" << report;
+        emit videoFilterCostChanged();
+    }
+
+    if( audio_fill_samples ) {
+        m_audio_buffer_fill = audio_fill_sum / audio_fill_samples;
+
+        // Only audio sync steers by the fill level, it's worth a line when it drifted
+        if( m_sync_mode == "audio" && qAbs( m_audio_buffer_fill - logged_audio_fill ) > 2.0 ) {
+            qCDebug( phxAudio, "Sync %s: buffered %.1fms (%.1f-%.1f), %d frames run, %d repeated",
+                     qPrintable( m_sync_mode ), m_audio_buffer_fill, audio_fill_min, audio_fill_max, m_fps, repeated_frames );
+            logged_audio_fill = m_audio_buffer_fill;
+        }
+
+        audio_fill_sum = 0.0;
+        audio_fill_samples = 0;
+        repeated_frames = 0;
+        emit audioBufferFillChanged();
+    }
+
+    if( m_run ) {
+        m_resampler_cost = audio.takeResamplerCost();
+
+        if( qAbs( m_resampler_cost - logged_resampler_cost ) > qMax( 0.1, logged_resampler_cost * 0.2 ) ) {
+            qCDebug( phxAudio, "Resampler %s cost: %.2fms per second of audio", qPrintable( m_resampler_quality ), m_resampler_cost );
+            logged_resampler_cost = m_resampler_cost;
+        }
+
+        emit resamplerCostChanged();
+    }
+}
 
 void VideoItem::saveGameState() {
     QFileInfo info( m_game );
 
     if( m_game != "" && m_libcore != "" ) {
-        core.saveGameState( phxGlobals.savePath(), info.baseName() );
+        if( core.saveGameState( phxGlobals.savePath(), info.baseName() ) ) {
+            // Thumbnail sits next to the state file
+            screenshot.request( Screenshot::StateThumbnail,
+                                phxGlobals.savePath() + phxGlobals.selectedGame().baseName() + "_STATE.png",
+                                QFileInfo( m_game ).canonicalFilePath() );
+        }
     }
 
 }
@@ -152,6 +405,11 @@ void VideoItem::setGame( QString game ) {
     m_game = game;
     qCDebug( phxVideo ) << "Loading game:" << game;
 
+    // The core declares its options while loading, saved values have to be known by then
+    QString core_name = QFileInfo( m_libcore ).baseName();
+    QString game_name = QFileInfo( game ).baseName();
+    core.getVariables().setOverrides( CoreOptionsModel::savedValues( core_name, game_name ) );
+
     if( !core.loadGame( game.toStdString().c_str() ) ) {
         qCCritical( phxVideo, "Couldn't load game !" );
         //        exit(EXIT_FAILURE);
@@ -160,6 +418,7 @@ void VideoItem::setGame( QString game ) {
 
     qCDebug( phxVideo, "Loaded game at %ix%i @ %.2ffps", core.getBaseWidth(),
              core.getBaseHeight(), core.getFps() );
+    core_options.reload( &core.getVariables(), core_name, game_name );
     updateAudioFormat();
     emit gameChanged( game );
 }
@@ -167,6 +426,7 @@ void VideoItem::setGame( QString game ) {
 
 void VideoItem::setRun( bool run ) {
     m_run = run;
+    input_manager.keyboardQueue().setPaused( !run );
 
     if( run ) {
         qCDebug( phxVideo, "Core started" );
@@ -185,6 +445,8 @@ void VideoItem::setFiltering( int filtering ) {
 
 void VideoItem::setStretchVideo( bool stretchVideo ) {
     m_stretch_video = stretchVideo;
+    viewport_dirty = true;
+    update();
     emit stretchVideoChanged();
 }
 
@@ -198,6 +460,48 @@ QStringList VideoItem::getAudioDevices() {
     return list;
 }
 
+void VideoItem::startRecording( QString path ) {
+    if( m_game == "" || recorder.isRecording() ) {
+        return;
+    }
+
+    if( path == "" ) {
+        path = phxGlobals.savePath() + "Recordings/" + QFileInfo( m_game ).baseName()
+               + QDateTime::currentDateTime().toString( "_yyyyMMdd_hhmmss" );
+    }
+
+    QMetaObject::invokeMethod( &recorder, "slotStart", Qt::QueuedConnection,
+                               Q_ARG( QString, path ),
+                               Q_ARG( double, core.getFps() ),
+                               Q_ARG( double, core.getNativeSampleRate() ),
+                               Q_ARG( unsigned, core.getMaxWidth() ),
+                               Q_ARG( unsigned, core.getMaxHeight() ) );
+}
+
+void VideoItem::stopRecording() {
+    QMetaObject::invokeMethod( &recorder, "slotStop", Qt::QueuedConnection );
+}
+
+void VideoItem::takeScreenshot() {
+    if( m_game == "" ) {
+        return;
+    }
+
+    screenshot.request( Screenshot::UserScreenshot, phxGlobals.savePath() + "Screenshots/"
+                        + QFileInfo( m_game ).baseName()
+                        + QDateTime::currentDateTime().toString( "_yyyyMMdd_hhmmss_zzz" ),
+                        QFileInfo( m_game ).canonicalFilePath() );
+}
+
+void VideoItem::handleScreenshotSaved( QString path, int purpose, QString game ) {
+    qCDebug( phxVideo ) << "Screenshot saved to" << path << "(purpose" << purpose << ")";
+
+    // Savestate thumbnails aren't meant to be seen in the library
+    if( purpose == Screenshot::UserScreenshot ) {
+        emit screenshotSaved( game, "file:///" + path );
+    }
+}
+
 void VideoItem::updateAudioFormat() {
     QAudioFormat format;
     format.setSampleSize( 16 );
@@ -211,6 +515,11 @@ void VideoItem::updateAudioFormat() {
 }
 
 void VideoItem::keyEvent( QKeyEvent *event ) {
+    // Cores that take key events get the plain keys, hotkeys need Ctrl then
+    if( !input_manager.keyboardQueue().isHotkey( event ) ) {
+        return;
+    }
+
     bool is_pressed = ( event->type() == QEvent::KeyPress ) ? true : false;
 
     switch( event->key() ) {
@@ -228,24 +537,76 @@ void VideoItem::keyEvent( QKeyEvent *event ) {
                 event->accept();
             }
 
+            break;
+
+        case Qt::Key_F12:
+            if( is_pressed ) {
+                takeScreenshot();
+                event->accept();
+            }
+
             break;
     }
 }
 
 void VideoItem::setTexture() {
-    QImage::Format frame_format = retroToQImageFormat( core.getPixelFormat() );
+    if( filter_pipeline.isEnabled() ) {
+        // Wraps the pipeline's buffer, has to stay in scope until the upload is done
+        QImage filtered = filter_pipeline.process( core.getImageData(), core.getBaseWidth(), core.getBaseHeight(),
+                          core.getPitch(), core.getPixelFormat() );
+        uploadFrame( filtered.constBits(), filtered.width(), filtered.height(), filtered.bytesPerLine(),
+                     RETRO_PIXEL_FORMAT_XRGB8888 );
+        return;
+    }
 
-    if( texture ) {
-        texture->deleteLater();
+    uploadFrame( core.getImageData(), core.getBaseWidth(), core.getBaseHeight(), core.getPitch(), core.getPixelFormat() );
+}
+
+void VideoItem::uploadFrame( const void *data, unsigned width, unsigned height, size_t pitch, retro_pixel_format format ) {
+    if( !data || !width || !height ) {
+        return;
     }
 
-    texture = window()->createTextureFromImage( QImage( ( const uchar * )core.getImageData(),
-              core.getBaseWidth(),
-              core.getBaseHeight(),
-              core.getPitch(),
-              frame_format ).mirrored()
-              , QQuickWindow::TextureOwnsGLTexture );
+    int bytes_per_pixel = format == RETRO_PIXEL_FORMAT_XRGB8888 ? 4 : 2;
+
+    // A new texture is only needed when the core changes resolution or pixel format,
+    // every other frame just overwrites the existing one
+    if( !frame_texture || frame_texture->width() != int( width ) || frame_texture->height() != int( height )
+        || frame_texture_format != format ) {
+        delete texture;
+        delete frame_texture;
+
+        frame_texture = new QOpenGLTexture( QOpenGLTexture::Target2D );
+        frame_texture->setSize( width, height );
+        frame_texture->setFormat( format == RETRO_PIXEL_FORMAT_RGB565 ? QOpenGLTexture::RGB8_UNorm
+                                  : QOpenGLTexture::RGBA8_UNorm );
+        frame_texture->setMinMagFilters( QOpenGLTexture::Nearest, QOpenGLTexture::Nearest );
+        frame_texture->setWrapMode( QOpenGLTexture::ClampToEdge );
+        frame_texture->allocateStorage();
+        frame_texture_format = format;
+
+        // Not flagged as having an alpha channel, the X bits of XRGB8888 and 0RGB1555 are ignored
+        texture = window()->createTextureFromId( frame_texture->textureId(), QSize( width, height ) );
+    }
+
+    QOpenGLPixelTransferOptions options;
+    options.setRowLength( int( pitch / bytes_per_pixel ) );
+    options.setAlignment( bytes_per_pixel );
 
+    switch( format ) {
+        case RETRO_PIXEL_FORMAT_XRGB8888:
+            frame_texture->setData( QOpenGLTexture::BGRA, QOpenGLTexture::UInt32_RGBA8_Rev, data, &options );
+            break;
+
+        case RETRO_PIXEL_FORMAT_RGB565:
+            frame_texture->setData( QOpenGLTexture::RGB, QOpenGLTexture::UInt16_R5G6B5, data, &options );
+            break;
+
+        case RETRO_PIXEL_FORMAT_0RGB1555:
+        default:
+            frame_texture->setData( QOpenGLTexture::BGRA, QOpenGLTexture::UInt16_RGB5A1_Rev, data, &options );
+            break;
+    }
 }
 
 inline bool VideoItem::limitFps() {
@@ -277,6 +638,74 @@ inline bool VideoItem::limitFps() {
     return false;
 }
 
+int VideoItem::audioFramesNeeded() {
+    if( !core.audio_buf || core.getFps() <= 0 || core.getSampleRate() <= 0 ) {
+        return limitFps() ? 0 : 1;
+    }
+
+    // Keeps the buffer between the output's target and one frame above it, the last frame written has to fit
+    const size_t frame_bytes = size_t( core.getSampleRate() / core.getFps() ) * sizeof( int16_t ) * 2;
+    const size_t capacity = core.audio_buf->capacity();
+    const size_t target = qMin( audio.inputTarget() + frame_bytes, capacity > frame_bytes ? capacity - frame_bytes : 0 );
+    size_t buffered = core.audio_buf->size();
+
+    // Catches up after a hiccup, without starving the rendering thread
+    const int max_frames = 3;
+    int frames = 0;
+
+    while( buffered < target && frames < max_frames ) {
+        buffered += frame_bytes;
+        frames++;
+    }
+
+    if( frames ) {
+        audio_sync_stall.start();
+    } else if( audio_sync_stall.isValid() && audio_sync_stall.hasExpired( 250 ) ) {
+        // Nobody is playing the audio back, fall back on the display's clock until somebody does.
+        // Writes must not wait for room that never comes meanwhile.
+        setAudioOverflowPolicy( AudioBuffer::DropOldest );
+        return limitFps() ? 0 : 1;
+    }
+
+    // The core is paced by the sound card, it waits for room rather than dropping samples. Not while the
+    // output is being switched, there's nothing to wait for then.
+    setAudioOverflowPolicy( audio.isOutputRunning() ? AudioBuffer::Block : AudioBuffer::DropOldest );
+    return frames;
+}
+
+int VideoItem::framesToRun() {
+    if( m_sync_mode == "audio" ) {
+        return audioFramesNeeded();
+    }
+
+    audio_sync_stall.invalidate();
+    setAudioOverflowPolicy( AudioBuffer::DropOldest );
+    return limitFps() ? 0 : 1;
+}
+
+void VideoItem::setAudioOverflowPolicy( AudioBuffer::OverflowPolicy policy ) {
+    if( core.audio_buf ) {
+        core.audio_buf->setOverflowPolicy( policy );
+    }
+}
+
+void VideoItem::sampleAudioFill() {
+    if( !core.audio_buf || core.getSampleRate() <= 0 ) {
+        return;
+    }
+
+    qreal fill = core.audio_buf->size() * 1000.0 / ( core.getSampleRate() * sizeof( int16_t ) * 2 );
+
+    if( !audio_fill_samples ) {
+        audio_fill_min = audio_fill_max = fill;
+    }
+
+    audio_fill_min = qMin( audio_fill_min, fill );
+    audio_fill_max = qMax( audio_fill_max, fill );
+    audio_fill_sum += fill;
+    audio_fill_samples++;
+}
+
 QSGNode *VideoItem::updatePaintNode( QSGNode *old_node, UpdatePaintNodeData *paint_data ) {
     Q_UNUSED( paint_data )
 
@@ -284,28 +713,82 @@ QSGNode *VideoItem::updatePaintNode( QSGNode *old_node, UpdatePaintNodeData *pai
         setAspectRatio( core.getAspectRatio() );
     }
 
-    if( isRunning() && !limitFps() ) {
+    // The GUI thread is blocked while we're in here, m_video_filter can be read safely
+    if( filter_pipeline.filter() != m_video_filter ) {
+        filter_pipeline.setFilter( m_video_filter );
+    }
+
+    int frames = isRunning() ? framesToRun() : 0;
+
+    for( int i = 0; i < frames; i++ ) {
         core.doFrame();
         fps_count++;
+    }
 
-        // Sets texture from core->getImageData();
+    if( frames ) {
+        // Sets texture from core->getImageData(), only the last frame run gets shown
         setTexture();
+
+        if( core.latency_monitor ) {
+            core.latency_monitor->frameUploaded();
+        }
+
+        if( screenshot.isPending() && !core.isDupeFrame() ) {
+            screenshot.capture( core.getImageData(), core.getBaseWidth(), core.getBaseHeight(),
+                                core.getPitch(), core.getPixelFormat() );
+        }
+    } else if( isRunning() ) {
+        repeated_frames++;
     }
 
-    QSGSimpleTextureNode *tex_node = nullptr;
+    if( isRunning() ) {
+        sampleAudioFill();
+    }
 
-    if( old_node ) {
-        tex_node = static_cast<QSGSimpleTextureNode *>( old_node );
-    } else {
+    if( !shader_chain.isInitialized() ) {
+        initGL();
+    }
+
+    if( loaded_shader_preset != m_shader_preset ) {
+        initShader();
+    }
+
+    // Only recomputed when something that affects it changed, not on every frame
+    if( viewport_dirty || viewport_pixel_ratio != window()->devicePixelRatio()
+        || viewport_base_size != QSize( core.getBaseWidth(), core.getBaseHeight() ) ) {
+        refreshItemGeometry();
+    }
+
+    QSGTexture *node_texture = texture;
+
+    // Only once a real frame was uploaded, the initial placeholder may live in an atlas
+    if( shader_chain.isEnabled() && frame_texture && !viewport_pixel_size.isEmpty() ) {
+        GLuint output = shader_chain.render( frame_texture->textureId(), texture->textureSize(), viewport_pixel_size );
+        window()->resetOpenGLState();
+
+        if( !shader_texture || shader_texture->textureId() != int( output )
+            || shader_texture->textureSize() != viewport_pixel_size ) {
+            delete shader_texture;
+            shader_texture = window()->createTextureFromId( output, viewport_pixel_size );
+        }
+
+        node_texture = shader_texture;
+    }
+
+    QSGSimpleTextureNode *tex_node = static_cast<QSGSimpleTextureNode *>( old_node );
+
+    if( !tex_node ) {
         tex_node = new QSGSimpleTextureNode();
     }
 
-    tex_node->setTexture( texture );
-    tex_node->setTextureCoordinatesTransform( QSGSimpleTextureNode::MirrorVertically );
-    tex_node->setRect( boundingRect() );
+    // setTexture() rebuilds the node's geometry every time, setRect() only when the rect changed
+    if( node_texture && tex_node->texture() != node_texture ) {
+        tex_node->setTexture( node_texture );
+    }
+
+    tex_node->setRect( viewport_rect );
     tex_node->setFiltering( static_cast<QSGTexture::Filtering>( filtering() ) );
 
     return tex_node;
 
 }
-
@@ -0,0 +1,26 @@
+#ifndef AUDIOBENCH_H
+#define AUDIOBENCH_H
+
+#include <QElapsedTimer>
+
+/* Each test prints its own results and returns false if it failed. Benchmarks only fail if something is broken,
+ * their numbers are for comparing builds and machines.
+ */
+
+// AudioBuffer under every OverflowPolicy, with a producer and a consumer thread
+bool bufferStress();
+
+// AudioBuffer copy throughput, single threaded and across two threads
+bool bufferBench();
+
+// The cubic resampler against an analytic sine, mono and stereo, at several ratios
+bool cubicCheck();
+
+// AudioOutputDevice::readData(), from the core's 16 bit samples to the sound card's format, for several resamplers
+bool outputBench();
+
+inline double secondsSince( const QElapsedTimer &timer ) {
+    return timer.nsecsElapsed() / 1000000000.0;
+}
+
+#endif // AUDIOBENCH_H
@@ -0,0 +1,34 @@
+# Stress test and benchmarks for the audio path, built on their own:
+#   qmake tools/audiobench/audiobench.pro && make && ./audiobench [test...]
+# Without arguments every test runs. The exit code is non-zero if any of them failed.
+
+TEMPLATE = app
+TARGET = audiobench
+CONFIG += c++11 console
+CONFIG -= app_bundle
+QT = core multimedia
+
+LIBS += -lsamplerate
+
+INCLUDEPATH += ../../include
+
+macx {
+    INCLUDEPATH += /usr/local/include
+    QMAKE_LFLAGS += -L/usr/local/lib
+}
+
+HEADERS += audiobench.h                      \
+           ../../include/audiobuffer.h       \
+           ../../include/audiooutputdevice.h \
+           ../../include/audioresampler.h    \
+           ../../include/logging.h           \
+
+SOURCES += main.cpp                          \
+           bufferstress.cpp                  \
+           bufferbench.cpp                   \
+           cubiccheck.cpp                    \
+           outputbench.cpp                   \
+           ../../src/audiobuffer.cpp         \
+           ../../src/audiooutputdevice.cpp   \
+           ../../src/audioresampler.cpp      \
+           ../../src/logging.cpp             \
@@ -0,0 +1,80 @@
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "audiobench.h"
+#include "audiobuffer.h"
+
+static const quint64 total_bytes = quint64( 1 ) << 28;
+
+// Writes then reads chunk bytes at a time on one thread, the cost of the copies and the bookkeeping
+static void singleThread( size_t chunk ) {
+    AudioBuffer buffer;
+    std::vector<char> data( chunk, 1 );
+    quint64 rounds = total_bytes / chunk;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for( quint64 i = 0; i < rounds; i++ ) {
+        buffer.write( data.data(), chunk );
+        buffer.read( data.data(), chunk );
+    }
+
+    double seconds = secondsSince( timer );
+    printf( "single thread, %5zu byte chunks: %7.2f GB/s, %6.1f ns per write + read\n",
+            chunk, total_bytes / seconds / 1e9, seconds * 1e9 / rounds );
+}
+
+// A producer and a consumer on their own threads, Block keeps every byte
+static bool twoThreads( size_t chunk ) {
+    AudioBuffer buffer( 4096 * 4, AudioBuffer::Block );
+    quint64 rounds = total_bytes / chunk;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    std::thread producer( [&buffer, chunk, rounds]() {
+        std::vector<char> data( chunk, 1 );
+
+        for( quint64 i = 0; i < rounds; i++ ) {
+            buffer.write( data.data(), chunk );
+        }
+    } );
+
+    std::vector<char> data( chunk );
+    quint64 received = 0;
+
+    while( received < rounds * chunk ) {
+        size_t bytes = buffer.read( data.data(), chunk );
+
+        if( !bytes ) {
+            std::this_thread::yield();
+        }
+
+        received += bytes;
+    }
+
+    producer.join();
+
+    double seconds = secondsSince( timer );
+    printf( "two threads,   %5zu byte chunks: %7.2f GB/s\n", chunk, received / seconds / 1e9 );
+
+    return received == rounds * chunk && !buffer.droppedBytes();
+}
+
+bool bufferBench() {
+    // 4 bytes is a single stereo frame, what audioSampleCallback() used to write
+    for( size_t chunk : { 4, 64, 1024, 4096 } ) {
+        singleThread( chunk );
+    }
+
+    bool passed = true;
+
+    for( size_t chunk : { 64, 1024, 4096 } ) {
+        passed = twoThreads( chunk ) && passed;
+    }
+
+    return passed;
+}
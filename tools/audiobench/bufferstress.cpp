@@ -0,0 +1,128 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "audiobench.h"
+#include "audiobuffer.h"
+
+// Words are numbered, so the consumer can tell which ones were lost and whether any came out of order.
+// Both sides move whole words, so head and tail stay aligned on them under every policy.
+static const quint32 word_count = 1 << 24;
+static const quint32 max_chunk = 1024; // words, a whole buffer's worth
+
+static const char *policyName( AudioBuffer::OverflowPolicy policy ) {
+    switch( policy ) {
+        case AudioBuffer::DropOldest:
+            return "DropOldest";
+
+        case AudioBuffer::DropNewest:
+            return "DropNewest";
+
+        case AudioBuffer::Block:
+            return "Block";
+    }
+
+    return "?";
+}
+
+static bool stressPolicy( AudioBuffer::OverflowPolicy policy ) {
+    AudioBuffer buffer( max_chunk * sizeof( quint32 ), policy );
+    std::atomic<bool> produced( false );
+
+    std::thread producer( [&buffer, &produced]() {
+        std::mt19937 rng( 1 );
+        std::vector<quint32> chunk( max_chunk );
+        quint32 next = 0;
+
+        while( next < word_count ) {
+            quint32 count = qMin<quint32>( rng() % max_chunk + 1, word_count - next );
+
+            for( quint32 i = 0; i < count; i++ ) {
+                chunk[i] = next + i;
+            }
+
+            // Whatever doesn't fit is counted by the buffer
+            buffer.write( reinterpret_cast<const char *>( chunk.data() ), count * sizeof( quint32 ) );
+            next += count;
+
+            // Both sides stall now and then, so the buffer goes through being full and being empty
+            if( rng() % 64 == 0 ) {
+                std::this_thread::sleep_for( std::chrono::microseconds( 200 ) );
+            }
+        }
+
+        produced = true;
+    } );
+
+    std::mt19937 rng( 2 );
+    std::vector<quint32> chunk( max_chunk );
+    quint64 received = 0;
+    qint64 last = -1;
+    bool aligned = true;
+    bool ordered = true;
+    bool contiguous = true;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while( true ) {
+        // Checked before reading, so nothing written before the flag went up can be missed
+        bool finished = produced;
+        size_t bytes = buffer.read( reinterpret_cast<char *>( chunk.data() ), ( rng() % max_chunk + 1 ) * sizeof( quint32 ) );
+
+        aligned = aligned && bytes % sizeof( quint32 ) == 0;
+
+        for( size_t i = 0; i < bytes / sizeof( quint32 ); i++ ) {
+            ordered = ordered && qint64( chunk[i] ) > last;
+            contiguous = contiguous && qint64( chunk[i] ) == last + 1;
+            last = chunk[i];
+        }
+
+        received += bytes / sizeof( quint32 );
+
+        if( !bytes ) {
+            if( finished ) {
+                break;
+            }
+
+            std::this_thread::yield();
+        }
+
+        if( rng() % 64 == 0 ) {
+            std::this_thread::sleep_for( std::chrono::microseconds( 200 ) );
+        }
+    }
+
+    producer.join();
+
+    quint64 dropped = buffer.droppedBytes() / sizeof( quint32 );
+    bool passed = aligned && ordered && received + dropped == word_count;
+
+    if( policy == AudioBuffer::Block ) {
+        // The consumer never stalls anywhere near the timeout, nothing may be lost
+        passed = passed && contiguous && !dropped;
+    } else {
+        // Otherwise the test didn't test much
+        passed = passed && buffer.overflows();
+    }
+
+    printf( "%-10s %.2fs, %llu words received, %llu dropped in %llu overflows%s%s%s %s\n",
+            policyName( policy ), secondsSince( timer ), received, dropped, buffer.overflows(),
+            aligned ? "" : ", misaligned reads", ordered ? "" : ", out of order", contiguous ? "" : ", with gaps",
+            passed ? "ok" : "FAILED" );
+
+    return passed;
+}
+
+bool bufferStress() {
+    bool passed = true;
+
+    for( auto policy : { AudioBuffer::DropOldest, AudioBuffer::DropNewest, AudioBuffer::Block } ) {
+        passed = stressPolicy( policy ) && passed;
+    }
+
+    return passed;
+}
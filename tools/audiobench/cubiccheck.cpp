@@ -0,0 +1,104 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "audiobench.h"
+#include "audioresampler.h"
+
+// The cubic resampler against the sine it's sampling, fed and drained in random chunks the way
+// AudioOutputDevice::resample() does, input that wasn't used is given again.
+// Output frame k is the input at k / ratio - 2: the resampler starts on 3 frames of silence, at position 1.
+
+static const double frequency = 0.02; // cycles per input frame, 960Hz at 48kHz
+static const size_t output_frames = 1 << 18;
+static const size_t max_chunk = 512;
+
+// Catmull-Rom's error on a sine this slow, with room for float rounding
+static const double max_error = 1e-4;
+
+static float sine( double frame, int channel ) {
+    // Channels get different phases, so swapping them would show
+    return float( 0.5 * std::sin( 2 * M_PI * frequency * frame + channel ) );
+}
+
+static bool checkRatio( int channels, double ratio, std::mt19937 &rng ) {
+    AudioResampler resampler;
+    resampler.setQuality( AudioResampler::Cubic, channels );
+
+    std::vector<float> in( max_chunk * 2 * channels );
+    std::vector<float> out( max_chunk * channels );
+    size_t pending = 0; // frames at the front of in
+    size_t next_in = 0;
+    size_t generated = 0;
+    double worst = 0.0;
+    bool stalled = false;
+
+    while( generated < output_frames ) {
+        // Like AudioOutputDevice::resample(), just enough input for the output wanted, give or take
+        size_t wanted = rng() % max_chunk + 1;
+        size_t needed = size_t( wanted / ratio ) + 1 + rng() % 8;
+        size_t add = pending < needed ? needed - pending : 0;
+
+        for( size_t i = 0; i < add; i++ ) {
+            for( int c = 0; c < channels; c++ ) {
+                in[( pending + i ) * channels + c] = sine( double( next_in + i ), c );
+            }
+        }
+
+        pending += add;
+        next_in += add;
+
+        size_t used, frames;
+
+        if( !resampler.process( in.data(), pending, out.data(), wanted, ratio, &used, &frames ) ) {
+            stalled = true;
+            break;
+        }
+
+        pending -= used;
+        memmove( in.data(), in.data() + used * channels, pending * channels * sizeof( float ) );
+
+        for( size_t i = 0; i < frames; i++ ) {
+            double position = double( generated + i ) / ratio - 2.0;
+
+            // The first output frames still interpolate from the silence
+            if( position < 1.0 ) {
+                continue;
+            }
+
+            for( int c = 0; c < channels; c++ ) {
+                worst = qMax( worst, std::fabs( double( out[i * channels + c] ) - sine( position, c ) ) );
+            }
+        }
+
+        generated += frames;
+
+        // There was always enough input for at least one frame
+        if( !frames ) {
+            stalled = true;
+            break;
+        }
+    }
+
+    bool passed = !stalled && worst < max_error;
+    printf( "%-6s ratio %.3f: max error %.2e%s %s\n", channels == 1 ? "mono" : "stereo", ratio, worst,
+            stalled ? ", stalled" : "", passed ? "ok" : "FAILED" );
+
+    return passed;
+}
+
+bool cubicCheck() {
+    std::mt19937 rng( 3 );
+    bool passed = true;
+
+    // Mono goes through the plain loop, stereo through the SSE2 one where it's built
+    for( int channels : { 1, 2 } ) {
+        for( double ratio : { 0.92, 0.995, 1.0, 1.005, 1.0884, 1.5 } ) {
+            passed = checkRatio( channels, ratio, rng ) && passed;
+        }
+    }
+
+    return passed;
+}
@@ -0,0 +1,59 @@
+#include <QCoreApplication>
+#include <QStringList>
+
+#include <cstdio>
+
+#include "audiobench.h"
+
+struct Test {
+    const char *name;
+    bool ( *run )();
+};
+
+static const Test tests[] = {
+    { "stress", bufferStress },
+    { "buffer", bufferBench },
+    { "cubic", cubicCheck },
+    { "output", outputBench },
+};
+
+int main( int argc, char *argv[] ) {
+    QCoreApplication app( argc, argv );
+    QStringList names = app.arguments().mid( 1 );
+    bool passed = true;
+
+    for( const QString &name : names ) {
+        bool known = false;
+
+        for( const Test &test : tests ) {
+            known = known || name == test.name;
+        }
+
+        if( !known ) {
+            fprintf( stderr, "Unknown test %s, the tests are:", qPrintable( name ) );
+
+            for( const Test &test : tests ) {
+                fprintf( stderr, " %s", test.name );
+            }
+
+            fprintf( stderr, "\n" );
+            return 2;
+        }
+    }
+
+    for( const Test &test : tests ) {
+        if( !names.isEmpty() && !names.contains( test.name ) ) {
+            continue;
+        }
+
+        printf( "== %s\n", test.name );
+        fflush( stdout );
+
+        if( !test.run() ) {
+            printf( "%s FAILED\n", test.name );
+            passed = false;
+        }
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+#include <QAudioFormat>
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "audiobench.h"
+#include "audiobuffer.h"
+#include "audiooutputdevice.h"
+
+// The whole path a period of audio takes once the core wrote it: AudioBuffer, shortToFloat(), the resampler
+// (or the passthrough) and floatToShort(), through AudioOutputDevice::readData() like QAudioOutput calls it.
+// The core side is played by the benchmark itself, it writes just as much as gets read, so DRC stays near
+// the target. Passthrough needs the same rates and DRC off.
+
+static const int seconds_of_audio = 60;
+static const int period_frames = 1024; // 21ms at 48kHz, a typical backend period
+
+struct Conversion {
+    int rate_in;
+    int rate_out;
+    bool float_output;
+    bool drc;
+    AudioResampler::Quality quality;
+};
+
+static QAudioFormat pcmFormat( int rate, bool float_samples ) {
+    QAudioFormat format;
+    format.setSampleSize( float_samples ? 32 : 16 );
+    format.setSampleRate( rate );
+    format.setChannelCount( 2 );
+    format.setSampleType( float_samples ? QAudioFormat::Float : QAudioFormat::SignedInt );
+    format.setByteOrder( QAudioFormat::LittleEndian );
+    format.setCodec( "audio/pcm" );
+    return format;
+}
+
+static bool convert( const Conversion &conversion ) {
+    QAudioFormat in = pcmFormat( conversion.rate_in, false );
+    QAudioFormat out = pcmFormat( conversion.rate_out, conversion.float_output );
+
+    AudioBuffer buffer;
+    AudioOutputDevice device( &buffer );
+    device.setResamplerQuality( conversion.quality );
+    device.setDrcEnabled( conversion.drc );
+    device.setFormats( in, out, out.bytesForFrames( period_frames * 4 ) );
+    device.open( QIODevice::ReadOnly );
+
+    // A second of a 440Hz tone, written over and over
+    std::vector<short> tone( conversion.rate_in * 2 );
+
+    for( size_t i = 0; i < tone.size() / 2; i++ ) {
+        tone[i * 2] = tone[i * 2 + 1] = short( 16000 * std::sin( 2 * M_PI * 440 * i / conversion.rate_in ) );
+    }
+
+    size_t tone_position = 0; // frames
+    double frames_due = 0.0;
+
+    auto produce = [&]( size_t frames ) {
+        while( frames ) {
+            size_t count = qMin( frames, tone.size() / 2 - tone_position );
+            buffer.write( reinterpret_cast<const char *>( tone.data() + tone_position * 2 ), in.bytesForFrames( count ) );
+            tone_position = ( tone_position + count ) % ( tone.size() / 2 );
+            frames -= count;
+        }
+    };
+
+    // Start right at the target, so the first period isn't refill silence
+    produce( in.framesForBytes( device.inputTarget() ) );
+
+    std::vector<char> period( out.bytesForFrames( period_frames ) );
+    qint64 periods = qint64( seconds_of_audio ) * conversion.rate_out / period_frames;
+    bool short_read = false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for( qint64 i = 0; i < periods; i++ ) {
+        // What the core produces while the sound card plays a period
+        frames_due += double( period_frames ) * conversion.rate_in / conversion.rate_out;
+        size_t frames = size_t( frames_due );
+        frames_due -= frames;
+        produce( frames );
+
+        short_read = short_read || device.read( period.data(), period.size() ) != qint64( period.size() );
+    }
+
+    double seconds = secondsSince( timer );
+    bool passed = !short_read && !device.underruns();
+
+    bool passthrough = conversion.rate_in == conversion.rate_out && !conversion.drc;
+
+    printf( "%5d -> %5d, %-6s %-11s %6.2f ms per second of audio, %6.0fx realtime, %llu underruns %s\n",
+            conversion.rate_in, conversion.rate_out, conversion.float_output ? "float" : "16 bit",
+            passthrough ? "passthrough" : qPrintable( AudioResampler::qualityNames().at( conversion.quality ) ),
+            seconds * 1000.0 / seconds_of_audio, seconds_of_audio / seconds, device.underruns(), passed ? "ok" : "FAILED" );
+
+    return passed;
+}
+
+bool outputBench() {
+    const Conversion conversions[] = {
+        // Same rate on both sides, passthrough without DRC, a fraction of a percent of correction with it
+        { 48000, 48000, false, false, AudioResampler::Cubic },
+        { 48000, 48000, true, false, AudioResampler::Cubic },
+        { 48000, 48000, false, true, AudioResampler::Cubic },
+        { 48000, 48000, true, true, AudioResampler::Cubic },
+
+        // A typical core rate to a typical sound card rate
+        { 32040, 48000, false, true, AudioResampler::Cubic },
+        { 32040, 48000, true, true, AudioResampler::Cubic },
+        { 32040, 48000, false, true, AudioResampler::Linear },
+        { 32040, 48000, false, true, AudioResampler::SincFastest },
+        { 32040, 48000, false, true, AudioResampler::SincMedium },
+        { 32040, 48000, true, true, AudioResampler::SincMedium },
+        { 44100, 48000, false, true, AudioResampler::SincBest },
+    };
+
+    bool passed = true;
+
+    for( const Conversion &conversion : conversions ) {
+        passed = convert( conversion ) && passed;
+    }
+
+    return passed;
+}